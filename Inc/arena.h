@@ -0,0 +1,47 @@
+#ifndef __ARENA_H
+#define __ARENA_H
+
+#include <stdint.h>
+
+/*
+ * One static RAM region shared by the two modes. USB-attached mode takes
+ * its buffers (bulk packet, CDC ring, text log cache, write-back slots)
+ * on entry; battery mode takes none. Arena_Mode() drops everything at a
+ * change of mode. Above the mode blocks the logging path takes scratch
+ * blocks with Arena_Mark() / Arena_Release() instead of stack: it runs
+ * in both modes. Thread level only, never from an interrupt.
+ *
+ * Each user checks its blocks against its budget below with ARENA_CHECK,
+ * so the mode blocks and the deepest scratch always fit.
+ */
+
+#define ARENA_MODE_BATTERY      0u      /* after reset */
+#define ARENA_MODE_USB          1u
+#define ARENA_MODES             2u
+
+/* Budgets, bytes after ARENA_ROUND */
+#define ARENA_USB_CORE_BYTES    1536u   /* usb.c: MSC bulk packet, CDC stream ring */
+#define ARENA_USB_IMAGE_BYTES   2352u   /* msc_mem.c: text log cache, write-back slots */
+#define ARENA_SCRATCH_BYTES     688u    /* logging path: text line, two FileEntry */
+#define ARENA_SIZE              (ARENA_USB_CORE_BYTES + ARENA_USB_IMAGE_BYTES + ARENA_SCRATCH_BYTES)
+
+#define ARENA_ROUND(n)          (((uint32_t)(n) + 3u) & ~3u)
+
+/* Compile-time check: cond must hold, name is any identifier unique in the file */
+#define ARENA_CHECK(name, cond) typedef char arena_check_##name[(cond) ? 1 : -1]
+
+/* Enter a mode: every block taken before is gone */
+void Arena_Mode(uint8_t mode);
+
+/* size bytes, 4-byte aligned, until Arena_Mode() or a release below it. NULL if full. */
+void *Arena_Alloc(uint32_t size);
+
+/* Scratch: Arena_Release(mark) frees everything taken since Arena_Mark() */
+uint32_t Arena_Mark(void);
+void Arena_Release(uint32_t mark);
+
+/* Bytes in use now, and the most ever used in mode since reset */
+uint32_t Arena_Used(void);
+uint32_t Arena_HighWater(uint8_t mode);
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef __BUTTON_H
+#define __BUTTON_H
+
+#include <stdint.h>
+
+/*
+ * Button on PA15 (WKUP0, high while pressed). Each edge wakes the core
+ * through the PMU NMI, which posts to SCHED_TASK_BUTTON; the pin is then
+ * masked and read again after BUTTON_DEBOUNCE_MS on a scheduler timer,
+ * and the wake polarity flips to the next expected edge. No polling: the
+ * core sleeps between edges and timers.
+ *
+ * A press is reported once it is classified: short on release if no
+ * second press follows within BUTTON_DOUBLE_MS, double on the second
+ * release, long as soon as it is held BUTTON_LONG_MS. Held past
+ * BUTTON_STUCK_MS the button is reported stuck and ignored, with only
+ * the release edge armed, until it reads released again.
+ */
+
+#define BUTTON_DEBOUNCE_MS  20u
+#define BUTTON_LONG_MS      1000u
+#define BUTTON_DOUBLE_MS    350u    /* release to the second press */
+#define BUTTON_STUCK_MS     10000u
+
+/* Reported press */
+#define BUTTON_SHORT        0u
+#define BUTTON_LONG         1u
+#define BUTTON_DOUBLE       2u
+#define BUTTON_STUCK        3u
+
+typedef void (*ButtonHandler)(uint8_t press);
+
+/* Arm the press edge; a button already down is taken as a press. After
+ * Sched_Init() and WKUP_init(). */
+void Button_Init(ButtonHandler handler);
+
+/* SCHED_TASK_BUTTON: edge events and the debounce / press timers */
+void Button_Task(uint8_t arg);
+
+/* Drop the press in progress; a held button is ignored until released.
+ * For changes of the scheduler clock (USB attach and detach). */
+void Button_Reset(void);
+
+/* Pin level, not debounced: 1 while down */
+uint8_t Button_Held(void);
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef __CLOCK_H
+#define __CLOCK_H
+
+#include <stdint.h>
+
+/*
+ * System clock levels and the task policy on top of them. Code declares
+ * what it is about to do (Clock_Request) and gets the level the policy
+ * table maps that to; Clock_Restore returns to the caller's level. Every
+ * RCHF change reloads the NVR trim for the new frequency and retimes what
+ * depends on the clock: systemClock, the SPI flash prescaler, the NST112
+ * bus timing. On the PLL (USB attached) requests are ignored.
+ *
+ * Waits on flash, sensors and the ADC take the same time at any clock, and
+ * the run current grows with it, so I/O runs at 8 MHz. Only a CPU burst
+ * longer than about 7000 cycles pays for the two switches at 24 MHz
+ * (break-even printed by Tools/clockmodel); shorter ones stay at the IO
+ * level.
+ */
+
+#define CLOCK_RCHF_8M       0u
+#define CLOCK_RCHF_16M      1u
+#define CLOCK_RCHF_24M      2u
+#define CLOCK_PLL_64M       3u      /* USBInit() */
+
+#define CLOCK_TASK_IO       0u      /* bus transfers, conversions, flash busy */
+#define CLOCK_TASK_CPU      1u      /* computation with no I/O inside */
+#define CLOCK_TASKS         2u
+
+/* Current level, read back from the RCC */
+uint8_t Clock_Level(void);
+
+/* 1 if running on RCHF at level with undivided buses and systemClock matching */
+uint8_t Clock_IsRchf(uint8_t level);
+
+/* Switch RCHF to level (CLOCK_RCHF_*), select it as the system clock and
+ * retime the peripherals. Not while a transfer is running. */
+void Clock_SetRchf(uint8_t level);
+
+/* Level for task; returns the previous level for Clock_Restore() */
+uint8_t Clock_Request(uint8_t task);
+void Clock_Restore(uint8_t level);
+
+/* Clock-dependent peripheral settings after any change, PLL included */
+void Clock_Retime(void);
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef __CONFIG_STORE_H
+#define __CONFIG_STORE_H
+
+#include <stdint.h>
+#include "spi_flash.h"
+
+/*
+ * Device settings in external SPI flash (one sector at CONFIG_ADDRESS).
+ * Each save appends a 32-byte slot; the last slot with a valid CRC wins,
+ * and the sector is erased only when it is full. Edited by the host through
+ * CONFIG.TXT on the MSC volume (msc_mem.c).
+ */
+
+#define CONFIG_MAGIC            0x31474643u   /* "CFG1" little-endian */
+#define CONFIG_SLOT_SIZE        32u
+#define CONFIG_SLOTS            (FLASH_SECTOR_SIZE / CONFIG_SLOT_SIZE)
+
+#define CONFIG_ALARM_OFF_LO     ((int16_t)-32768)   /* alarm_low disabled */
+#define CONFIG_ALARM_OFF_HI     ((int16_t)32767)    /* alarm_high disabled */
+
+#define CONFIG_INTERVAL_MIN_S   2u
+#define CONFIG_INTERVAL_DEF_S   10u
+
+typedef struct {
+    uint32_t magic;         /* CONFIG_MAGIC */
+    uint16_t interval_s;    /* sampling period while attached */
+    int16_t  alarm_lo_q4;   /* log LOG_REC_ALARM below this (degC * 16) */
+    int16_t  alarm_hi_q4;   /* ... and above this */
+    uint8_t  sensor_rate;   /* NST112_RATE_*; 0xFF (older slots) = one-shot */
+    uint8_t  sensor_ext;    /* 1: NST112 13-bit extended mode */
+    uint8_t  alert_wake;    /* 1: on battery, sleep until the NST112 ALERT fires */
+    uint8_t  acq_burst;     /* conversions per sample, median taken (temp_acq.c) */
+    uint8_t  acq_iir_shift; /* IIR weight 1/2^n on new samples, 0 = off */
+    uint8_t  reserved[15];  /* 0xFF, room for later settings */
+    uint16_t crc;           /* CRC-16/CCITT over the first 30 bytes */
+} DevConfig;
+
+/* Load the newest valid slot, or defaults. Cheap after the first call. */
+void Config_Mount(void);
+
+/* Current settings (defaults until Config_Mount() found a slot) */
+const DevConfig *Config_Get(void);
+
+/* Store settings if they differ from the current ones. Returns 1 if written. */
+uint8_t Config_Save(const DevConfig *cfg);
+
+/*
+ * CONFIG.TXT text, snprintf-style: buf may be NULL to get the length.
+ * Must stay within one 512-byte sector (msc_mem.c serves and captures
+ * only the first sector of the file).
+ */
+int Config_Format(char *buf, uint32_t size);
+
+/*
+ * Parse CONFIG.TXT text ("key=value" lines, '#' comments), save the
+ * settings and set the RTC (LogStore_SetClock) if an uncommented time=
+ * line is present.
+ * Unknown keys and bad values are ignored. Returns 1 if anything changed.
+ */
+uint8_t Config_ApplyText(const char *text, uint32_t len);
+
+#endif
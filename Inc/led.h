@@ -0,0 +1,52 @@
+#ifndef __LED_H
+#define __LED_H
+
+#include <stdint.h>
+
+/*
+ * LED patterns played from the LPTIM interrupt, so the core can sleep
+ * (Sleep_Deep() or Sleep_Ms()) while a blink is on. A pattern is a list
+ * of steps {LEDs on, duration}; up to LED_QUEUE_LEN patterns wait their
+ * turn. Between patterns the LEDs show the idle state (USB attached).
+ * Sleep_Ms() borrows LPTIM: it tells the engine the time that passed
+ * and the step then goes on with what is left of it.
+ */
+
+#define LED_GREEN           0x01u   /* LED0 */
+#define LED_RED             0x02u   /* LED1 */
+
+#define LED_PAT_OK          0u      /* sample stored: green 0.5 s */
+#define LED_PAT_ERROR       1u      /* sensor or flash failed: red twice */
+#define LED_PATTERNS        2u
+
+#define LED_QUEUE_LEN       4u
+
+typedef struct {
+    uint8_t  leds;      /* LED_GREEN | LED_RED */
+    uint16_t ms;
+} LedStep;
+
+/* Queue a pattern; dropped if the queue is full */
+void Led_Play(uint8_t pattern);
+
+/* LEDs shown while no pattern plays */
+void Led_SetIdle(uint8_t leds);
+
+/* 1 while a pattern plays or waits */
+uint8_t Led_Busy(void);
+
+#define LED_NO_STEP         0xFFFFFFFFu
+
+/*
+ * LPTIM owner hooks (wkup.c). Suspend stops the step timer and returns the
+ * LPTIM ticks left of the step (LED_NO_STEP: nothing plays). While
+ * suspended, Elapse charges ticks that passed, advancing the steps that
+ * fell due, and returns what is left of the current one. Resume hands
+ * LPTIM back with that remainder.
+ */
+void Led_TimerEvent(void);
+uint32_t Led_Suspend(void);
+uint32_t Led_Elapse(uint32_t ticks);
+void Led_Resume(void);
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef __LOG_INDEX_H
+#define __LOG_INDEX_H
+
+#include <stdint.h>
+#include "log_store.h"
+
+/*
+ * Per-day index over the record log (RAM only, rebuilt on first use after
+ * power-up and then caught up incrementally). Feeds the virtual FAT volume:
+ * one CSV per day and the SUMMARY.CSV aggregates.
+ * Days are RTC local days; a record whose day is earlier than the last
+ * indexed day (clock set back) is kept in the last day. The day aggregates
+ * follow one sensor, the primary: the lowest channel with sensor records
+ * that day (NST112_Primary() is the lowest present). Probes on other
+ * channels are only in the day CSVs.
+ */
+
+#define LOG_INDEX_MAX_DAYS    96u   /* oldest days fall out of the index (not the log) */
+
+typedef struct {
+    uint16_t day;        /* days since 2000-01-01 */
+    int16_t  tmin;       /* Q4 */
+    int16_t  tmax;       /* Q4 */
+    uint16_t nerr;       /* LOG_REC_SENSOR_ERR records of chan */
+    uint8_t  chan;       /* channel aggregated, LOG_CHANNELS: none yet */
+    uint32_t first_seq;
+    uint32_t count;      /* seq span of the day = lines in its CSV */
+    uint32_t ntemp;      /* valid LOG_REC_TEMP records of chan */
+    int32_t  tsum;       /* Q4 */
+} LogDay;
+
+/* Supply records over the indexed part of the log */
+typedef struct {
+    uint32_t count;         /* LOG_REC_SUPPLY records */
+    uint32_t first_time;
+    uint32_t last_time;
+    uint16_t first_mv;
+    uint16_t last_mv;
+    int16_t  last_mcu_q4;
+    uint16_t nbrownout;     /* LOG_REC_BROWNOUT records */
+} LogSupply;
+
+/* Catch up with records appended / dropped since the last call. Returns 1 if usable. */
+uint8_t LogIndex_Update(void);
+
+/* LogIndex_Update() reading at most max_records, for callers that must not
+ * stall (the first scan after power-up reads the whole log). Returns 1 once
+ * caught up, or if the log is unusable. */
+uint8_t LogIndex_UpdateSome(uint32_t max_records);
+
+uint16_t LogIndex_Days(void);
+const LogDay *LogIndex_Day(uint16_t i);
+
+/* Channels (bit mask) seen in the indexed sensor records */
+uint8_t LogIndex_Channels(void);
+
+const LogSupply *LogIndex_Supply(void);
+
+#endif
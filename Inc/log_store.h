@@ -0,0 +1,86 @@
+#ifndef __LOG_STORE_H
+#define __LOG_STORE_H
+
+#include <stdint.h>
+#include "spi_flash.h"
+
+/*
+ * Binary record log in external SPI flash (LOG_STORE_ADDRESS..end).
+ * Fixed 16-byte little-endian records, appended in sequence order and
+ * wrapped sector by sector: when the write position enters a sector, the
+ * oldest 256 records in it are erased. Erased slots read as seq 0xFFFFFFFF.
+ */
+
+#define LOG_REC_SIZE          16u
+#define LOG_REC_PER_SECTOR    (FLASH_SECTOR_SIZE / LOG_REC_SIZE)
+#define LOG_SECTORS           (LOG_STORE_SIZE / FLASH_SECTOR_SIZE)
+#define LOG_SLOTS             (LOG_SECTORS * LOG_REC_PER_SECTOR)
+
+#define LOG_SEQ_NONE          0xFFFFFFFFu
+
+/* Record types */
+#define LOG_REC_TEMP          0x01u   /* value = temperature Q4 (degC * 16), aux = four more
+                                         fraction bits: Q8 = value * 16 + aux (temp_acq.c) */
+#define LOG_REC_SENSOR_ERR    0x02u   /* aux = driver return code */
+#define LOG_REC_ALARM         0x03u   /* value = temperature Q4, aux = LOG_ALARM_xxx */
+#define LOG_REC_TIME_SET      0x04u   /* clock set; correction s = (value << 16) | aux, signed */
+#define LOG_REC_EXCURSION     0x05u   /* ALERT wake: value = temperature Q4,
+                                         aux = LOG_ALARM_xxx [| LOG_EXCURSION_END] */
+#define LOG_REC_SUPPLY        0x06u   /* value = VDD mV, aux = MCU temperature Q4 (supply.c) */
+#define LOG_REC_BROWNOUT      0x07u   /* SVD warned of a falling supply; value = last VDD mV */
+
+#define LOG_CHANNELS          4u      /* chan = NST112 channel, 0..3 */
+
+#define LOG_ALARM_HIGH        1u
+#define LOG_ALARM_LOW         2u
+#define LOG_EXCURSION_END     0x80u
+
+typedef struct {
+    uint32_t seq;       /* increments by one per record, never reused */
+    uint32_t time;      /* RTC, seconds since 2000-01-01 */
+    uint8_t  type;      /* LOG_REC_xxx */
+    uint8_t  chan;      /* sensor channel */
+    int16_t  value;
+    uint16_t aux;
+    uint16_t crc;       /* CRC-16/CCITT over the first 14 bytes */
+} LogRecord;
+
+/*
+ * Scan flash for the newest record. Cheap after the first call; the result
+ * lives in RAM which is retained across DeepSleep. Returns 1 if usable.
+ */
+uint8_t LogStore_Mount(void);
+
+/* Append one record stamped with the next seq and the current RTC time. */
+uint8_t LogStore_Append(uint8_t type, uint8_t chan, int16_t value, uint16_t aux);
+
+/* Oldest stored seq and the seq the next record will get (equal = empty). */
+uint32_t LogStore_FirstSeq(void);
+uint32_t LogStore_NextSeq(void);
+
+/* Read record by seq. Returns 1 if present and its CRC matches. */
+uint8_t LogStore_ReadSeq(uint32_t seq, LogRecord *rec);
+
+/*
+ * Read up to n consecutive records starting at seq in one flash burst (stops
+ * at the ring end, so may return fewer). Check each with LogStore_RecordOk().
+ */
+uint32_t LogStore_ReadRun(uint32_t seq, LogRecord *recs, uint32_t n);
+uint8_t  LogStore_RecordOk(const LogRecord *rec, uint32_t seq);
+
+/* First seq whose time is >= t (NextSeq if none); assumes time is monotonic. */
+uint32_t LogStore_FindTime(uint32_t t);
+
+/*
+ * Set the RTC to t (seconds since 2000, UTC when set by a host) and log a
+ * LOG_REC_TIME_SET record stamped with the new time, so later records can
+ * be placed on one timeline. old_time (may be NULL) gets the clock before.
+ * Returns 1 if the RTC took the new time.
+ */
+uint8_t LogStore_SetClock(uint32_t t, uint32_t *old_time);
+
+/* CRC-16/CCITT (0x1021, init 0xFFFF) over the records; the config,
+ * profile and RTC calibration stores use it too */
+uint16_t Crc16_Ccitt(const uint8_t *p, uint32_t n);
+
+#endif
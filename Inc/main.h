@@ -43,6 +43,7 @@ extern "C" {
 #include "fm33lc0xx_ll_pmu.h"
 #include "fm33lc0xx_ll_flash.h"
 #include "fm33lc0xx_ll_svd.h"
+#include "fm33lc0xx_ll_adc.h"
 #include "fm33lc0xx_ll_aes.h"
 #include "fm33lc0xx_ll_rmu.h"
 #include "fm33lc0xx_ll_rng.h"
@@ -62,8 +63,21 @@ extern "C" {
 
 #include "mf_config.h"
 #include "user_init.h"
+#include "clock.h"
 #include "usb.h"
 #include "spi_flash.h"
+#include "log_store.h"
+#include "log_index.h"
+#include "config_store.h"
+#include "rtc_cal.h"
+#include "temp_acq.h"
+#include "supply.h"
+#include "profile.h"
+#include "led.h"
+#include "sched.h"
+#include "button.h"
+#include "sampler.h"
+#include "arena.h"
 #include "wkup.h"
 #include "msc_mem.h"
 #include "nst112.h"
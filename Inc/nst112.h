@@ -12,16 +12,134 @@
 /*
  * Default 7-bit I2C address for NST112 depends on ADD0 strap.
  * Common default is 0x48. If your board uses another address, change it here.
+ * Up to NST112_MAX_SENSORS sensors share the bus, one per strap address:
+ * channel n answers at NST112_I2C_ADDR + n (0x48..0x4B), and n is the
+ * channel number in the log records.
  */
-#define NST112_I2C_ADDR   0x48u
+#define NST112_I2C_ADDR     0x48u
+#define NST112_MAX_SENSORS  4u
 
+/* ALERT output (open drain, active low) on a PMU wakeup pin, see wkup.c */
+#define NST112_ALERT_PORT     GPIOB
+#define NST112_ALERT_PIN      LL_GPIO_PIN_11
+#define NST112_ALERT_WKUP     LL_GPIO_WKUP_1
+#define NST112_ALERT_PMU_WKUP LL_PMU_WKUP1PIN
+
+/*
+ * 1: talk to the sensor through the I2C peripheral (PA11/PA12 digital
+ * function, fast mode, interrupt driven, core sleeps while it waits).
+ * If the peripheral times out the driver drops to the bit-banged bus
+ * until reset. 0: bit-banged bus only.
+ */
+#ifndef NST112_USE_HW_I2C
+#define NST112_USE_HW_I2C 1
+#endif
+
+#define NST112_I2C_BAUD    400000u   /* peripheral SCL rate */
+#define NST112_BB_HALF_US  5u        /* bit-bang SCL half period (~100 kHz) */
+
+/* Registers (pointer byte) and configuration bits, TMP112 compatible */
+#define NST112_REG_TEMP     0x00u
+#define NST112_REG_CONFIG   0x01u
+#define NST112_REG_TLOW     0x02u
+#define NST112_REG_THIGH    0x03u
+
+#define NST112_CFG_OS       0x8000u   /* write 1 in shutdown: one conversion */
+#define NST112_CFG_F_2      0x0800u   /* ALERT after 2 consecutive faults */
+#define NST112_CFG_POL      0x0400u   /* ALERT active high */
+#define NST112_CFG_TM       0x0200u   /* interrupt (1) / comparator (0) mode */
+#define NST112_CFG_SD       0x0100u   /* shutdown */
+#define NST112_CFG_CR_Pos   6u
+#define NST112_CFG_CR_4HZ   (2u << NST112_CFG_CR_Pos)   /* power-on rate */
+#define NST112_CFG_EM       0x0010u   /* 13-bit extended range */
+
+#define NST112_CONV_TYP_MS  27u
+#define NST112_CONV_MAX_MS  35u
+
+/* Sampling mode (DevConfig.sensor_rate) */
+#define NST112_RATE_ONESHOT 0u   /* shut down, one conversion per read */
+#define NST112_RATE_0_25HZ  1u   /* continuous conversion, CR=00 */
+#define NST112_RATE_1HZ     2u
+#define NST112_RATE_4HZ     3u
+#define NST112_RATE_8HZ     4u
+
+/* ALERT comparator side (NST112_SetAlert) */
+#define NST112_ALERT_OFF     0u
+#define NST112_ALERT_HIGH    1u   /* THIGH = limit, TLOW = limit - hysteresis */
+#define NST112_ALERT_LOW     2u   /* TLOW = limit, THIGH = limit + hysteresis */
+#define NST112_ALERT_HYST_Q4 8    /* 0.5 degC */
+
+/* Set up the bus (peripheral or bit-bang pins). Only the first call does
+ * anything: the setup survives DeepSleep and NST112_Retime() follows the clock. */
 void NST112_GPIO_Init(void);
 
+/* Bus timing for the current clock, bus already set up (clock.c) */
+void NST112_Retime(void);
+
+/*
+ * Probe every channel address and cache which sensors answered (RAM,
+ * retained across DeepSleep). The bus must be set up. Returns the channel
+ * bit mask. Called at boot, when USB connects and on a double press.
+ * The primary only moves if it stopped answering.
+ */
+uint8_t NST112_Scan(void);
+
+/* Cached channel mask; scans again while it is empty */
+uint8_t NST112_Present(void);
+
+/* Lowest present channel (0 if none): the one with ALERT and NST112_ReadTempQ4 */
+uint8_t NST112_Primary(void);
+
 /*
- * Read temperature.
+ * Read temperature of the primary sensor (one-shot mode: trigger a conversion first, ~30 ms).
  * out_q4: temperature in Q4 format (degC * 16). Example: 25.0625C => 25*16 + 1 = 401.
  * Returns 0 on success, non-zero on error.
  */
 int NST112_ReadTempQ4(int16_t *out_q4);
 
+/*
+ * Read the channels in mask in one bus session: start all conversions,
+ * share one wait, then read them all. out_q4[chan] and rc[chan] (0 or the
+ * NST112_ReadTempQ4 error) are written for each channel in mask.
+ * Returns the mask of channels read.
+ */
+uint8_t NST112_ReadQ4(uint8_t mask, int16_t *out_q4, int *rc);
+
+/*
+ * NST112_ReadQ4() in steps, for callers with other work during the
+ * conversion. Start returns the ms to wait; after it Pending returns 0 or
+ * more ms once (a late one-shot), then Collect reads and returns the mask
+ * read. rc[chan] as above. Nothing else may use the bus in between.
+ */
+uint32_t NST112_Start(uint8_t mask, int *rc);
+uint32_t NST112_Pending(int *rc);
+uint8_t NST112_Collect(int16_t *out_q4, int *rc);
+
+/*
+ * Select the sampling mode (NST112_RATE_*, anything else is one-shot) and
+ * 13-bit extended mode (extended == 1). Applied on the next read. One-shot
+ * keeps the sensor shut down and sleeps on LPTIM (Sleep_Ms) while the
+ * conversion runs.
+ */
+void NST112_Configure(uint8_t rate, uint8_t extended);
+
+/*
+ * Arm the ALERT comparator of the primary sensor on one limit, or disarm
+ * (NST112_ALERT_OFF). One comparator watches one limit: ALERT is active (low) while the
+ * temperature is at or above THIGH, until it falls below TLOW. While armed
+ * the sensor converts continuously (at 0.25 Hz if the rate is one-shot).
+ * Writes the sensor only when the side or limit changed; the bus must be
+ * set up. Returns 0 or the NST112_ReadTempQ4 error codes.
+ */
+int NST112_SetAlert(uint8_t side, int16_t limit_q4);
+
+/* Conversion period of sensors in continuous mode, 0 if all are one-shot (every read converts) */
+uint32_t NST112_PeriodMs(void);
+
+/* Total ms waited for conversions, for energy accounting */
+uint32_t NST112_WaitMs(void);
+
+/* ALERT pin level: 1 = active (low). The pin is set up by WKUP_ALERT_init(). */
+uint8_t NST112_AlertActive(void);
+
 #endif
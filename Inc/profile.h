@@ -0,0 +1,74 @@
+#ifndef __PROFILE_H
+#define __PROFILE_H
+
+#include <stdint.h>
+#include "spi_flash.h"
+
+/*
+ * Wake-window profiler. The M0+ has no DWT cycle counter and SysTick is
+ * reloaded by DelayUs(), so a window runs BSTIM free on LSCLK (32768 Hz,
+ * 30.5 us per tick), which keeps counting through Sleep_Ms(). Each lap
+ * charges the time since the previous lap to one phase: count, min, max,
+ * sum and a log2 histogram in RAM (retained across DeepSleep). Every
+ * PROFILE_SAVE_EVERY windows a snapshot is appended to the sector at
+ * PROFILE_ADDRESS and the newest one is reloaded after a reset.
+ * USB owns BSTIM (1 ms tick) while attached: no window runs then.
+ */
+
+#define PROFILE_TICK_HZ         32768u
+#define PROFILE_BINS            16u     /* 0 ticks, [2^(k-1), 2^k) ticks for k = 1..14, >= 2^14 */
+#define PROFILE_SAVE_EVERY      32u     /* windows per flash snapshot */
+#define PROFILE_SLOT_SIZE       512u
+#define PROFILE_SLOTS           (FLASH_SECTOR_SIZE / PROFILE_SLOT_SIZE)
+
+/* Phases of the button / sample wake, in the order they run */
+#define PROFILE_WAKE            0u      /* Profile_Start() to Profile_Stop() */
+#define PROFILE_RESUME          1u      /* DeepSleep exit: clocks, RTC */
+#define PROFILE_FLASH_INIT      2u      /* SPI flash pins and peripheral */
+#define PROFILE_SENSOR_INIT     3u      /* bus pins, config, sensor setup and scan */
+#define PROFILE_SENSOR_READ     4u      /* conversions and filtering */
+#define PROFILE_RTC             5u      /* RTC check and read */
+#define PROFILE_LOG_WRITE       6u      /* record log appends */
+#define PROFILE_SUPPLY          7u      /* ADC supply measurement and record */
+#define PROFILE_RING_WRITE      8u      /* 5-line text log rewrite */
+#define PROFILE_LED             9u      /* result blink */
+#define PROFILE_PHASES          10u
+
+typedef struct {
+    uint32_t count;
+    uint32_t min;                   /* ticks */
+    uint32_t max;
+    uint32_t sum;
+    uint16_t hist[PROFILE_BINS];    /* saturating */
+} ProfilePhase;
+
+typedef struct {
+    uint32_t     seq;               /* snapshot number, 0xFFFFFFFF = erased */
+    uint32_t     windows;           /* Profile_Stop() calls */
+    ProfilePhase phase[PROFILE_PHASES];
+    uint16_t     reserved;          /* 0xFFFF */
+    uint16_t     crc;               /* CRC-16/CCITT over the rest */
+} ProfileSnapshot;
+
+/* Reload the newest snapshot. Flash must be set up; cheap after the first call. */
+void Profile_Mount(void);
+
+/* Open a window (no-op while USB holds BSTIM) */
+void Profile_Start(void);
+
+/* Charge the time since the previous lap (or Profile_Start) to phase */
+void Profile_Lap(uint8_t phase);
+
+/* Close the window: record PROFILE_WAKE, stop BSTIM, save when due. Flash must be set up. */
+void Profile_Stop(void);
+
+/* Close the window without recording it (woke for something else) */
+void Profile_Cancel(void);
+
+const ProfileSnapshot *Profile_Get(void);
+const char *Profile_Name(uint8_t phase);
+
+/* Ticks to microseconds */
+uint32_t Profile_Us(uint32_t ticks);
+
+#endif
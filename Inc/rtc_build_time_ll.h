@@ -19,6 +19,7 @@ extern "C" {
 #define RTC_BCDWEEK        RTC_REG32(0x1C)
 #define RTC_BCDMONTH       RTC_REG32(0x20)
 #define RTC_BCDYEAR        RTC_REG32(0x24)
+#define RTC_SBSCNT         RTC_REG32(0x3C)
 #define RTC_BKR0           RTC_REG32(0x70)
 
 #define RTC_WER_UNLOCK_KEY (0xACACACACUL)
@@ -97,12 +98,18 @@ static unsigned int RTC_BuildSignature(void)
 {
     /* 32-bit signature derived from build date/time strings.
      * Changes on each build, so RTC gets re-initialized after reflashing.
+     * Hashed once per reset; RAM keeps it through DeepSleep.
      */
-    unsigned int h = 2166136261u;
-    h = fnv1a32_step(h, __DATE__);
-    h = fnv1a32_step(h, " ");
-    h = fnv1a32_step(h, __TIME__);
-    return (0x52544300u ^ h);
+    static unsigned int sig;
+
+    if (sig == 0u) {
+        unsigned int h = 2166136261u;
+        h = fnv1a32_step(h, __DATE__);
+        h = fnv1a32_step(h, " ");
+        h = fnv1a32_step(h, __TIME__);
+        sig = (0x52544300u ^ h) | 1u;   /* never 0 */
+    }
+    return sig;
 }
 
 static unsigned char bcd2bin(unsigned char v)
@@ -162,6 +169,107 @@ static void RTC_ReadTimeHMS(unsigned char *hh, unsigned char *mm, unsigned char
     if (mm) *mm = bcd2bin((unsigned char)(m1 & 0xFFu));
     if (hh) *hh = bcd2bin((unsigned char)(h1 & 0xFFu));
 }
+
+/* Days before each month (non-leap year) */
+static const unsigned short rtc_days_before_month[12] = {
+    0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334
+};
+
+/* Seconds since 2000-01-01 00:00:00 for a calendar date (year 2000..2099). */
+static unsigned int RTC_DateToEpoch2000(unsigned int yy, unsigned char mon, unsigned char day,
+                                        unsigned char hh, unsigned char mm, unsigned char ss)
+{
+    unsigned int days;
+
+    if (mon < 1u || mon > 12u) mon = 1u;
+    if (day < 1u) day = 1u;
+
+    /* 2000 is a leap year, so the leap days before Jan 1 of yy are (yy + 3) / 4 */
+    days = yy * 365u + (yy + 3u) / 4u + rtc_days_before_month[mon - 1u] + (day - 1u);
+    if (mon > 2u && (yy % 4u) == 0u) days++;
+
+    return ((days * 24u + hh) * 60u + mm) * 60u + ss;
+}
+
+/* Inverse of the date part: days since 2000-01-01 -> yy (0..99), month, day. */
+static void RTC_DaysToDate(unsigned int days, unsigned int *yy, unsigned char *mon, unsigned char *day)
+{
+    unsigned int y = 0u, m = 0u, len;
+
+    for (;;) {
+        len = ((y % 4u) == 0u) ? 366u : 365u;
+        if (days < len) break;
+        days -= len;
+        y++;
+    }
+    for (m = 1u; m < 12u; m++) {
+        len = rtc_days_before_month[m] + (((y % 4u) == 0u && m >= 2u) ? 1u : 0u);
+        if (days < len) break;
+    }
+    len = rtc_days_before_month[m - 1u] + (((y % 4u) == 0u && m > 2u) ? 1u : 0u);
+
+    if (yy) *yy = y;
+    if (mon) *mon = (unsigned char)m;
+    if (day) *day = (unsigned char)(days - len + 1u);
+}
+
+/* Full RTC date/time as seconds since 2000-01-01 (used for log timestamps). */
+static unsigned int RTC_ReadEpoch2000(void)
+{
+    unsigned int s1, m1, h1, d1, mo1, y1;
+    unsigned int s2;
+
+    /* Reading seconds last and again guards against a carry between registers. */
+    do {
+        s1  = RTC_BCDSEC;
+        m1  = RTC_BCDMIN;
+        h1  = RTC_BCDHOUR;
+        d1  = RTC_BCDDAY;
+        mo1 = RTC_BCDMONTH;
+        y1  = RTC_BCDYEAR;
+        s2  = RTC_BCDSEC;
+    } while (s1 != s2);
+
+    return RTC_DateToEpoch2000(bcd2bin((unsigned char)(y1 & 0xFFu)),
+                               bcd2bin((unsigned char)(mo1 & 0xFFu)),
+                               bcd2bin((unsigned char)(d1 & 0xFFu)),
+                               bcd2bin((unsigned char)(h1 & 0xFFu)),
+                               bcd2bin((unsigned char)(m1 & 0xFFu)),
+                               bcd2bin((unsigned char)(s1 & 0xFFu)));
+}
+
+/*
+ * Set the calendar from seconds since 2000-01-01 (host time sync).
+ * Clearing the sub-second counter first restarts the current second, so no
+ * carry can land between the BCD register writes; the result is read back
+ * and the write repeated if one still did. Returns 1 once the RTC reads t.
+ */
+static unsigned char RTC_SetEpoch2000(unsigned int t)
+{
+    unsigned int days = t / 86400u;
+    unsigned int sod = t % 86400u;
+    unsigned int yy, now;
+    unsigned char mon, day, tries;
+
+    RTC_DaysToDate(days, &yy, &mon, &day);
+
+    for (tries = 0u; tries < 3u; tries++) {
+        RTC_WER = RTC_WER_UNLOCK_KEY;
+        RTC_SBSCNT   = 0u;
+        RTC_BCDSEC   = bin2bcd((unsigned char)(sod % 60u));
+        RTC_BCDMIN   = bin2bcd((unsigned char)((sod / 60u) % 60u));
+        RTC_BCDHOUR  = bin2bcd((unsigned char)(sod / 3600u));
+        RTC_BCDDAY   = bin2bcd(day);
+        RTC_BCDWEEK  = bin2bcd(weekday_iso_1_7(2000u + yy, mon, day));
+        RTC_BCDMONTH = bin2bcd(mon);
+        RTC_BCDYEAR  = bin2bcd((unsigned char)yy);
+        RTC_WER = 0;
+
+        now = RTC_ReadEpoch2000();
+        if (now == t || now == t + 1u) return 1;
+    }
+    return 0;
+}
 																	
 #ifdef __cplusplus
 }
@@ -0,0 +1,56 @@
+#ifndef __RTC_CAL_H
+#define __RTC_CAL_H
+
+#include <stdint.h>
+#include "spi_flash.h"
+
+/*
+ * RTC drift calibration. Every host clock sync over USB (vendor TIME_SET)
+ * measures how far the RTC ran off; once the error since the reference
+ * sync covers at least RTC_CAL_MIN_SPAN_S, the residual drift, weighted by
+ * the span, is folded into the trim programmed into the RTC ADJUST
+ * register and the reference moves up. Each sync appends a 32-byte entry
+ * to the history sector at RTC_CAL_ADDRESS; the newest entry is reloaded
+ * after a reset (MF_Clock_Init() clears ADJUST).
+ */
+
+#define RTC_CAL_ENTRY_SIZE      32u
+#define RTC_CAL_ENTRIES         (FLASH_SECTOR_SIZE / RTC_CAL_ENTRY_SIZE)
+
+#define RTC_CAL_PPB_PER_LSB     238     /* ADJUST step: 1 / (32768 * 128) */
+#define RTC_CAL_MAX_PPB         (511 * RTC_CAL_PPB_PER_LSB)
+#define RTC_CAL_MIN_SPAN_S      (2u * 86400u)    /* shorter spans only move the reference */
+#define RTC_CAL_FULL_SPAN_S     (30u * 86400u)   /* spans this long take the full residual */
+#define RTC_CAL_MAX_RESID_PPB   200000           /* larger = clock was reset, not drift */
+
+/* RtcCalEntry.flags */
+#define RTC_CAL_REF             0x01u   /* ref_time/acc_error_s valid */
+#define RTC_CAL_LEARNED         0x02u   /* this sync updated the trim */
+
+typedef struct {
+    uint32_t time;          /* host time of the sync, seconds since 2000 */
+    int32_t  error_s;       /* RTC minus host time just before the sync */
+    uint32_t ref_time;      /* last precise sync that started a span */
+    int32_t  acc_error_s;   /* error corrected since ref_time, this sync included */
+    int32_t  ppb;           /* trim after this sync, + = RTC slowed down */
+    uint8_t  flags;         /* RTC_CAL_xxx */
+    uint8_t  learned;       /* syncs that updated the trim so far (saturates) */
+    uint8_t  reserved[8];   /* 0xFF */
+    uint16_t crc;           /* CRC-16/CCITT over the first 30 bytes */
+} RtcCalEntry;
+
+/* Load the newest entry and program the trim. Cheap after the first call. */
+void RtcCal_Mount(void);
+
+/*
+ * The clock was just moved from old_time to new_time. precise = set by a
+ * host on a second boundary (learns from it); otherwise the reference is
+ * dropped, e.g. for a time typed into CONFIG.TXT.
+ */
+void RtcCal_ClockSet(uint32_t old_time, uint32_t new_time, uint8_t precise);
+
+/* Programmed trim in ppb (+ = slowed down) and number of learning syncs */
+int32_t RtcCal_TrimPpb(void);
+uint8_t RtcCal_Learned(void);
+
+#endif
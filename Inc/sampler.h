@@ -0,0 +1,38 @@
+#ifndef __SAMPLER_H
+#define __SAMPLER_H
+
+#include <stdint.h>
+
+/*
+ * One sample (sensor burst, record log, 5-line text log, LED) as a chain
+ * of short steps on SCHED_TASK_SAMPLER. Nothing waits in place: the flash
+ * release from power-down and the sensor conversions are started together,
+ * the RTC is read while they settle, the text log sector erase runs under
+ * the last conversion of the burst (the old lines are only in RAM until
+ * the commit), and each wait (conversion, burst gap, erase) is a scheduler timer the
+ * idle hook sleeps through. Then the results are committed.
+ *
+ * The sensor bus and the text log sector belong to the sample until it is
+ * done: code that needs either calls Sampler_Finish() first, or skips its
+ * turn while Sampler_Busy().
+ */
+
+/* stored: the 5-line text log took the new line */
+typedef void (*SamplerDone)(uint8_t stored);
+
+/* Start a sample; done runs from its last step. 0 if one is running. */
+uint8_t Sampler_Start(SamplerDone done);
+
+/* SCHED_TASK_SAMPLER: the next steps */
+void Sampler_Task(uint8_t arg);
+
+uint8_t Sampler_Busy(void);
+
+/* Complete the sample in progress here, waiting with DelayMs() */
+void Sampler_Finish(void);
+
+/* Drop the sample in progress: nothing is logged, the 5-line text log
+ * gets its old lines back, done does not run */
+void Sampler_Abort(void);
+
+#endif
@@ -0,0 +1,78 @@
+#ifndef __SCHED_H
+#define __SCHED_H
+
+#include <stdint.h>
+
+/*
+ * Run-to-completion scheduler for the main loop. Interrupt handlers post
+ * events (task, arg) into a ring owned by their priority level: NMI (the
+ * PMU wake pins), IRQ (every NVIC priority in use is 2, so IRQs never
+ * preempt each other) and thread (tasks posting to tasks). Each ring has
+ * one writer and one reader, so head and tail need no lock and no IRQ
+ * masking. Sched_Signal() is the coalescing form for sources that fire
+ * faster than the task runs (the USB interrupt). Each task has one
+ * one-shot timer on the clock given to Sched_Init().
+ *
+ * Sched_Dispatch() runs ready work, highest level first, then signals,
+ * then due timers, and returns the time to the next timer; the caller's
+ * idle hook picks the sleep. No hardware access here: Tools/schedtrace
+ * replays event traces through this file on the host.
+ */
+
+#define SCHED_TASKS         8u
+#define SCHED_QUEUE_LEN     8u      /* per level, power of two */
+
+/* Posting levels */
+#define SCHED_LEVEL_NMI     0u
+#define SCHED_LEVEL_IRQ     1u
+#define SCHED_LEVEL_THREAD  2u
+#define SCHED_LEVELS        3u
+
+/* Tasks (main.c) */
+#define SCHED_TASK_USB      0u      /* attach, detach, deferred SCSI work */
+#define SCHED_TASK_BUTTON   1u      /* WKUP0 edges, debounce (button.c) */
+#define SCHED_TASK_ALERT    2u      /* NST112 ALERT edge */
+#define SCHED_TASK_SUPPLY   3u      /* SVD power fall */
+#define SCHED_TASK_SAMPLE   4u      /* interval_s while attached */
+#define SCHED_TASK_STREAM   5u      /* CDC live stream */
+#define SCHED_TASK_SAMPLER  6u      /* sample pipeline steps (sampler.c) */
+
+/* arg passed to a handler run by its signal or its timer */
+#define SCHED_ARG_SIGNAL    0xFEu
+#define SCHED_ARG_TIMER     0xFFu
+
+#define SCHED_FOREVER       0xFFFFFFFFu
+
+typedef void (*SchedHandler)(uint8_t arg);
+
+/* Per level counters are written by that level's producer only */
+typedef struct {
+    uint32_t posted[SCHED_LEVELS];
+    uint32_t dropped[SCHED_LEVELS];     /* ring full */
+    uint8_t  high_water[SCHED_LEVELS];
+    uint32_t dispatched;
+} SchedStats;
+
+/* clock: free-running ms count, wraps; read at arm and dispatch time */
+void Sched_Init(uint32_t (*clock)(void));
+void Sched_SetTask(uint8_t task, SchedHandler handler);
+
+/* From the level given; 0 when the ring is full (counted as dropped) */
+uint8_t Sched_Post(uint8_t level, uint8_t task, uint8_t arg);
+
+/* Any level; several signals before the task runs make one call */
+void Sched_Signal(uint8_t task);
+
+/* One-shot timer, replaces the task's armed one */
+void Sched_After(uint8_t task, uint32_t ms);
+void Sched_Cancel(uint8_t task);
+
+/* 1 while an event or signal waits (timers not counted) */
+uint8_t Sched_Pending(void);
+
+/* Run until nothing is ready; ms to the next timer or SCHED_FOREVER */
+uint32_t Sched_Dispatch(void);
+
+const SchedStats *Sched_Stats(void);
+
+#endif
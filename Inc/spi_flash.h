@@ -23,12 +23,27 @@ typedef struct {
 #define FLASH_MOSI_PIN    LL_GPIO_PIN_10
 #define FLASH_SCLK_PIN    LL_GPIO_PIN_8
 
+/* SCK ceiling: what the board has always run on the PLL (32 MHz APB / 8) */
+#define FLASH_SPI_MAX_HZ  4000000u
+
 // config Flash
 #define FILE_ADDRESS      0x000000
 #define FILE_NAME         "file.txt"
 #define FILE_CONTENT      "Hello world!"
 #define FILE_SIZE         (strlen(FILE_CONTENT) + 1)
 
+// Flash map (P25Q16SH: 2 MB, 4 KB sectors)
+#define FLASH_SECTOR_SIZE 0x1000u
+#define FLASH_TOTAL_SIZE  0x200000u
+#define CONFIG_ADDRESS    0x001000u                             // device settings (config_store.c)
+#define RTC_CAL_ADDRESS   0x002000u                             // RTC drift history (rtc_cal.c)
+#define PROFILE_ADDRESS   0x003000u                             // wake profile snapshots (profile.c)
+#define LOG_STORE_ADDRESS 0x010000u                             // binary record log
+#define LOG_STORE_SIZE    (FLASH_TOTAL_SIZE - LOG_STORE_ADDRESS)
+
+#define FLASH_ERASE_POLL_MS 4u                                  // busy poll period during a sector erase
+#define FLASH_RES_US      20u                                   // release from deep power-down (tRES1) with margin
+
 // comands P25Q16SH
 #define CMD_WRITE_ENABLE  0x06
 #define CMD_WRITE_DISABLE 0x04
@@ -44,6 +59,8 @@ typedef struct {
 
 #define STATUS_BUSY       0x01
 
+#define FLASH_LINE_MAX    96u   /* one text log line */
+
 //struct for file
 typedef struct {
     char filename[32];
@@ -66,6 +83,10 @@ void Flash_CS_Low(void);
 void Flash_CS_High(void);
 
 void FlashSpi_init(void);
+/* Prescaler for the current APB1 clock, SCK <= FLASH_SPI_MAX_HZ (clock.c) */
+void FlashSpi_Retime(void);
+/* FlashGpio_init(), FlashSpi_init() and CS high, the first time only */
+void Flash_Init(void);
 
 uint8_t SPI_TransmitReceive(uint8_t data);
 //alternative function for bigsize data
@@ -81,6 +102,15 @@ uint8_t Flash_ReadStatus(void);
 void Flash_WaitForReady(void);
 void Flash_WriteEnable(void);
 void Flash_SectorErase(uint32_t address);
+/* Start a sector erase and return; the next command waits for it, or poll Flash_Busy() */
+void Flash_SectorEraseStart(uint32_t address);
+/* 1 while an erase or program runs */
+uint8_t Flash_Busy(void);
+/* Deep power-down between wakes. Any command wakes the chip again (FLASH_RES_US
+ * busy-wait); Flash_Wake() only sends the release, for callers with other work
+ * to do for FLASH_RES_US before the next command. */
+void Flash_PowerDown(void);
+void Flash_Wake(void);
 void Flash_PageProgram(uint32_t address, uint8_t *data, uint16_t size);
 void Flash_ReadData(uint32_t address, uint8_t *buffer, uint32_t size);
 uint32_t Flash_ReadID(void);
@@ -97,7 +127,16 @@ uint8_t Flash_WriteTemperatureFile_Q4(int16_t temp_q4);
 uint8_t Flash_WriteTemperatureWithTimeFile_Q4(int16_t temp_q4, uint8_t hh, uint8_t mm, uint8_t ss);
 /* Log ring: keep last 5 lines in the same file */
 uint8_t Flash_LogLine_Ring5(const char *line, uint32_t size);
+/* The same in two steps around other work: Prepare reads the old lines (into
+ * the arena, held until Commit) and starts the sector erase, Commit writes
+ * line in front of them */
+uint8_t Flash_Ring5_Prepare(void);
+uint8_t Flash_Ring5_Commit(const char *line, uint32_t size);
 uint8_t Flash_LogTemperatureWithTime_Ring5_Q4(int16_t temp_q4, uint8_t hh, uint8_t mm, uint8_t ss);
+/* Same with the full date, t = RTC seconds since 2000 (RTC_ReadEpoch2000) */
+uint8_t Flash_LogTemperatureWithDate_Ring5_Q4(int16_t temp_q4, uint32_t t);
+/* Its line into buf (FLASH_LINE_MAX bytes), returns the length */
+uint32_t Flash_FormatTemperatureWithDate_Q4(char *buf, int16_t temp_q4, uint32_t t);
 static void Flash_WriteBytes(uint32_t addr, const uint8_t *data, uint32_t size);
 
 #endif
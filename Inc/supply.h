@@ -0,0 +1,51 @@
+#ifndef __SUPPLY_H
+#define __SUPPLY_H
+
+#include <stdint.h>
+
+/*
+ * Supply telemetry. Every SUPPLY_EVERY_N samples the ADC measures VDD
+ * (internal 1.2 V reference against the factory calibration) and the MCU
+ * temperature sensor, and a LOG_REC_SUPPLY record is appended. The supply
+ * voltage detector (SVD) runs intermittently and interrupts when VDD falls
+ * through SUPPLY_SVD_LEVEL; the main loop then completes pending flash
+ * writes and logs LOG_REC_BROWNOUT.
+ */
+
+#define SUPPLY_EVERY_N        16u     /* samples per supply record (first sample after reset too) */
+#define SUPPLY_SVD_LEVEL      LL_SVD_WARNING_THRESHOLD_LEVEL_STANDARD_GTOUP2   /* ~2.2 V falling */
+#define SUPPLY_CUTOFF_MV      2200u   /* empty for the life estimate: the SVD warning level */
+
+/* NVR factory calibration, both taken at VDD = 3.000 V */
+#define SUPPLY_VREF_CAL       (*(const uint16_t *)0x1FFFFD08u)   /* VREF reading */
+#define SUPPLY_TS_CAL         (*(const uint16_t *)0x1FFFFA92u)   /* temperature sensor reading at 30 degC */
+#define SUPPLY_TS_CAL_C       30
+#define SUPPLY_TS_UV_PER_C    1700    /* temperature sensor slope, typical */
+
+/* Set up the SVD warning interrupt (also wakes DeepSleep). Call once at boot. */
+void Supply_Init(void);
+
+/*
+ * Measure VDD (mV) and the MCU temperature (Q4). Clocks the ADC only for
+ * the two conversions. Returns 0, or 1 if the ADC did not finish.
+ */
+int Supply_Measure(uint16_t *vdd_mv, int16_t *mcu_q4);
+
+/* Count one sample; every SUPPLY_EVERY_N measure and log. Flash must be set up. */
+void Supply_Sample(void);
+
+/* VDD of the last measurement, 0 if none since reset */
+uint16_t Supply_LastMv(void);
+
+/* 1 once per SVD falling-supply event */
+uint8_t Supply_Warning(void);
+
+/*
+ * Days until VDD reaches SUPPLY_CUTOFF_MV, extrapolated linearly from the
+ * oldest and newest supply records in LogIndex_Supply(); -1 until the log spans a day
+ * with a measurable drop. Lithium cells stay flat and then fall off, so
+ * the figure is an upper bound early in the battery's life.
+ */
+int32_t Supply_LifeDays(void);
+
+#endif
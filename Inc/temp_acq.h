@@ -0,0 +1,52 @@
+#ifndef __TEMP_ACQ_H
+#define __TEMP_ACQ_H
+
+#include <stdint.h>
+
+/*
+ * Temperature acquisition: a burst of NST112 conversions on every channel,
+ * the median of each channel's burst, then an optional first-order IIR
+ * y += (x - y) / 2^shift per channel whose state lives in RAM (retained
+ * across DeepSleep). Integer only: the M0+
+ * has no FPU and no divider. The result is degC * 256 (Q8).
+ */
+
+#define TEMP_ACQ_BURST_MAX      9u
+#define TEMP_ACQ_IIR_SHIFT_MAX  6u
+
+typedef struct {
+    uint8_t  chans;         /* channels read by the last sample */
+    uint8_t  burst;         /* conversions taken by the last sample */
+    uint8_t  iir_shift;     /* 0 = IIR off */
+    uint16_t wait_ms;       /* waited for those conversions */
+    uint32_t filter_cycles; /* CPU cycles of median + IIR (SysTick) */
+} TempAcqStats;
+
+/*
+ * One filtered sample from each channel in chans: burst
+ * (1..TEMP_ACQ_BURST_MAX) conversions, iir_shift (0..TEMP_ACQ_IIR_SHIFT_MAX).
+ * The caller runs the conversions, so it can do other work while they
+ * convert (sampler.c):
+ *
+ *   TempAcq_Begin(chans, burst, iir_shift);
+ *   while ((mask = TempAcq_Next(&gap_ms)) != 0)
+ *       wait gap_ms, TempAcq_Add(NST112_ReadQ4(mask, t, rc), t);
+ *   got = TempAcq_End(out_q8);
+ *
+ * A channel whose read fails (rc[chan] from NST112) drops out and its IIR
+ * restarts. End writes out_q8[chan] for the channels in the returned mask.
+ */
+void TempAcq_Begin(uint8_t chans, uint8_t burst, uint8_t iir_shift);
+/* Channels for the next conversion after waiting gap_ms; 0 once the burst is done */
+uint8_t TempAcq_Next(uint32_t *gap_ms);
+/* The round Next just gave is the last of the burst (if no channel fails) */
+uint8_t TempAcq_Last(void);
+void TempAcq_Add(uint8_t got, const int16_t *t_q4);
+uint8_t TempAcq_End(int32_t *out_q8);
+
+/* Forget the IIR history; the next sample seeds it. */
+void TempAcq_Reset(void);
+
+const TempAcqStats *TempAcq_Stats(void);
+
+#endif
@@ -3,6 +3,37 @@
 
 #include "main.h"
 
+/* CDC live stream: port closed or a sample running, look again after this */
+#define USB_STREAM_POLL_MS          100u
+
+/* Enumeration timing, in ms since USBInit() (VBUS seen). 0xFFFFFFFF = not yet. */
+#define USB_ENUM_NOT_SEEN       0xFFFFFFFFu
+
+#define USB_ENUM_EVT_SETUP      0u  /* first SETUP packet from host */
+#define USB_ENUM_EVT_CONFIGURED 1u  /* SET_CONFIGURATION accepted */
+#define USB_ENUM_EVT_MOUNT      2u  /* first READ(10) on the volume */
+
+typedef struct {
+    uint32_t first_setup_ms;
+    uint32_t configured_ms;
+    uint32_t mount_ms;
+} USB_EnumStats;
+
+extern volatile uint32_t usb_ms_ticks;
+extern volatile USB_EnumStats usb_enum_stats;
+
+/* USB_IRQHandler() duration, in us (BSTIM based) */
+extern volatile uint16_t usb_isr_last_us;
+extern volatile uint16_t usb_isr_max_us;
+
 void USBInit(void);
+void USBStop(void);
+void USB_Process(void);
+void USB_EnumStats_Mark(uint8_t evt);
+
+/* CDC-ACM live stream (no-ops when built MSC only) */
+uint8_t  USB_Stream_Write(const char *line, uint16_t len);
+uint8_t  USB_Stream_IsOpen(void);
+uint32_t USB_Stream_Dropped(void);
 
 #endif
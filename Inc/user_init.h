@@ -25,12 +25,28 @@
 extern uint32_t systemClock;
 
 void UserInit(void);
+/* After Sleep_Deep(): only what DeepSleep does not keep (clock level, SysTick) */
+void UserResume(void);
+/* Build-time default clock level (CLOCK_RCHF_*) */
+uint8_t ClockBaseLevel(void);
 
 void blink_green(void);
 void blink_red(void);
 void blink_both(void);
 
+/*
+ * DelayUs() always busy-waits on SysTick. DelayMs() callers say what they
+ * need: DELAY_PRECISE busy-waits the same way (exact, full run current);
+ * DELAY_COARSE sleeps instead once the delay is DELAY_SLEEP_MIN_MS or
+ * longer: on the PLL (USB attached) in WFI between BSTIM 1 ms ticks, up to
+ * 1 ms late; otherwise in Sleep_Ms() on LPTIM, up to 1/1024 s late.
+ * Inside an interrupt handler both busy-wait.
+ */
+#define DELAY_PRECISE       0u
+#define DELAY_COARSE        1u
+#define DELAY_SLEEP_MIN_MS  2u   /* shorter: the wake-up costs more than it saves */
+
 void DelayUs(uint32_t count);
-void DelayMs(uint32_t count);
+void DelayMs(uint32_t count, uint8_t mode);
 
 #endif
@@ -33,8 +33,20 @@ extern "C" {
 
 
 void WKUP_init(void);// 外部引脚中断初始化
+void WKUP_Button_SetEdge(uint8_t rising);   /* PA15 (WKUP0) edge, see button.c */
+void WKUP_Button_Disable(void);
 void WKUP_USB_init(void);
-void Sleep_Deep(void);
+void WKUP_ALERT_init(void);             /* NST112 ALERT pin as a wakeup source */
+void WKUP_ALERT_SetEdge(uint8_t rising);
+void WKUP_ALERT_Disable(void);
+void Sleep_Deep(void);        /* returns with the PMU back in the Active mode */
+void Sleep_Ms(uint32_t ms);   /* LPTIM timed sleep, see wkup.c */
+void Sleep_Idle(uint32_t ms); /* Sleep_Ms() that also ends on scheduler work */
+uint32_t Sleep_Clock(void);   /* ms spent in Sleep_Ms()/Sleep_Idle() since reset, wraps */
+uint32_t Lptim_Ticks(uint32_t ms);     /* ms to LPTIM ticks (1/1024 s), 1..0xFFFF */
+void Lptim_OneShot(uint32_t ticks);    /* LPTIM overflow interrupt after ticks, for the LED engine */
+uint32_t Lptim_Remaining(void);        /* ticks to that overflow, 0 once due */
+void Lptim_Stop(void);
 
 #ifdef __cplusplus
 }
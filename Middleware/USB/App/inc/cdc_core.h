@@ -0,0 +1,31 @@
+#ifndef __CDC_CORE_H__
+#define __CDC_CORE_H__
+
+#include  "usbd_ioreq.h"
+
+/* CDC-ACM class requests */
+#define CDC_SEND_ENCAPSULATED_COMMAND   0x00
+#define CDC_GET_ENCAPSULATED_RESPONSE   0x01
+#define CDC_SET_LINE_CODING             0x20
+#define CDC_GET_LINE_CODING             0x21
+#define CDC_SET_CONTROL_LINE_STATE      0x22
+#define CDC_SEND_BREAK                  0x23
+
+#define CDC_LINE_CODING_LEN             7
+
+/* Stream ring buffer (power of two), in the arena: set by USBInit() */
+#define CDC_STREAM_BUF_SIZE             1024
+
+extern USBD_Class_cb_TypeDef  USBD_CDC_cb;
+
+extern uint8_t          *CDC_Stream_Buf;
+
+/* Host opened the port (DTR set) */
+extern volatile uint8_t  CDC_Stream_Open;
+/* Records rejected because the ring was full (host not reading fast enough) */
+extern volatile uint32_t CDC_Stream_Dropped;
+
+uint8_t CDC_Stream_Write(const uint8_t *data, uint16_t len);
+void    CDC_Stream_Kick(void *pdev);
+
+#endif
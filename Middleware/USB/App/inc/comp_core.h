@@ -0,0 +1,15 @@
+#ifndef __COMP_CORE_H__
+#define __COMP_CORE_H__
+
+#include  "usbd_ioreq.h"
+
+/* MSC (itf 0) + IAD + CDC comm (itf 1) + CDC data (itf 2) */
+#define USB_COMP_CONFIG_DESC_SIZ     98
+
+#define COMP_MSC_ITF_NBR             0x00
+#define COMP_CDC_CMD_ITF_NBR         0x01
+#define COMP_CDC_DATA_ITF_NBR        0x02
+
+extern USBD_Class_cb_TypeDef  USBD_COMP_cb;
+
+#endif
@@ -10,6 +10,14 @@
 #define BOT_LAST_DATA_IN              3       /* Last Data In Last */
 #define BOT_SEND_DATA                 4       /* Send Immediate data */
 
+/* Deferred BOT events (queued by the USB ISR, run by MSC_BOT_Process) */
+#define BOT_EVT_DATA_IN               0
+#define BOT_EVT_DATA_OUT              1
+#define BOT_EVT_RESET                 2
+#define BOT_EVT_CLR_FEATURE           3
+
+#define BOT_EVT_QUEUE_LEN             4
+
 /* BOT Status */
 #define BOT_STATE_NORMAL              0
 #define BOT_STATE_RECOVERY            1
@@ -52,7 +60,7 @@ typedef struct _MSC_BOT_CSW
 } MSC_BOT_CSW_TypeDef;
 
 
-extern uint8_t              MSC_BOT_Data[];
+extern uint8_t             *MSC_BOT_Data;
 extern uint16_t             MSC_BOT_DataLen;
 extern uint8_t              MSC_BOT_State;
 extern uint8_t              MSC_BOT_BurstMode;
@@ -70,5 +78,10 @@ void MSC_BOT_DataOut(void *pdev, uint8_t epnum);
 void MSC_BOT_SendCSW(void *pdev, uint8_t CSW_Status);
 void  MSC_BOT_CplClrFeature(void *pdev, uint8_t epnum);
 
+void MSC_BOT_QueueEvent(uint8_t evt, uint8_t epnum);
+void MSC_BOT_Process(void *pdev);
+
+extern volatile uint8_t MSC_BOT_EvtOverflow;
+
 #endif
 
@@ -15,10 +15,16 @@ typedef struct _USBD_STORAGE
     int8_t (* Read) (uint8_t lun, uint8_t *buf, uint32_t blk_addr, uint16_t blk_len);
     int8_t (* Write)(uint8_t lun, uint8_t *buf, uint32_t blk_addr, uint16_t blk_len);
     int8_t (* GetMaxLun)(void);
+    int8_t (* IsMediaChanged)(uint8_t lun);   /* 1 once after the image changed */
     int8_t *pInquiry;
 }USBD_STORAGE_cb_TypeDef;
 
 extern USBD_STORAGE_cb_TypeDef *USBD_STORAGE_fops;
 
+void MSC_EnableRawLun(uint8_t on);
+void MSC_InvalidateImage(void);
 void MSC_PrepareImage(void);
+void MSC_RefreshImage(void);
+void MSC_Poll(void);
+void MSC_Flush(void);   /* apply the host's pending writes now (supply failing) */
 #endif 
@@ -43,6 +43,19 @@
 
 #define SCSI_REPORT_LUNS                            0xA0    // ȡ豸LUNLUN嵥
 
+/* Vendor commands: binary log export (see log_store.h). CDB fields big-endian,
+ * returned data little-endian. */
+#define SCSI_VENDOR_LOG_INFO                        0xC0    // 32-byte log summary
+#define SCSI_VENDOR_LOG_READ                        0xC1    // records in a seq/time range
+#define SCSI_VENDOR_TIME_SET                        0xC2    // set RTC, returns old/new time, trim
+
+#define VENDOR_LOG_MAGIC                            0x474C5454u  // "TTLG"
+#define VENDOR_LOG_VERSION                          2       // 2: SCSI_VENDOR_TIME_SET
+#define VENDOR_LOG_INFO_LEN                         32
+#define VENDOR_LOG_BY_SEQ                           0       // CDB[1]: range is seq
+#define VENDOR_LOG_BY_TIME                          1       // CDB[1]: range is seconds since 2000
+#define VENDOR_TIME_LEN                             12      // old time, new time, RTC trim ppb
+
 #define NO_SENSE                                    0
 #define RECOVERED_ERROR                             1
 #define NOT_READY                                   2
@@ -4,7 +4,16 @@
 #include "usb_conf.h"
 
 #define USBD_CFG_MAX_NUM           1	//Ŀ֧1
+/* MSC + CDC-ACM composite (live temperature stream); 0 = MSC only */
+#ifndef USBD_COMPOSITE_CDC
+#define USBD_COMPOSITE_CDC         1
+#endif
+
+#if USBD_COMPOSITE_CDC
+#define USBD_ITF_MAX_NUM           3
+#else
 #define USBD_ITF_MAX_NUM           1	//ӿĿ֧1ӿ
+#endif
 
 #define USB_MAX_STR_DESC_SIZ       64 	//ַ
 
@@ -15,6 +24,18 @@
 
 #define MSC_MAX_PACKET               64
 
+/* LUN 1: raw SPI flash, read-only, LBA n = flash bytes n*512 (0 = LUN 0 only) */
+#ifndef MSC_RAW_FLASH_LUN
+#define MSC_RAW_FLASH_LUN            1
+#endif
+
+#define CDC_CMD_EP                   0x81
+#define CDC_IN_EP                    0x83
+#define CDC_OUT_EP                   0x03
+
+#define CDC_CMD_PACKET_SIZE          8
+#define CDC_DATA_MAX_PACKET          64
+
 //4096
 #define MSC_MEDIA_PACKET             512
 
@@ -0,0 +1,315 @@
+/**
+  ******************************************************************************
+  *          ===================================================================
+  *                                CDC Class  Description
+  *          ===================================================================
+  *           Minimal CDC-ACM function used next to MSC in the composite device:
+  *             - line coding / control line state requests (DTR opens stream)
+  *             - one bulk IN pipe fed from a ring buffer (live samples)
+  *             - bulk OUT data from the host is accepted and discarded
+  *           Only DCD_EP_xxx / USBD_Ctlxxx calls touch the core, so the class
+  *           can be driven by a host-side stub DCD.
+  ******************************************************************************
+  */
+
+#include "cdc_core.h"
+#include "usbd_req.h"
+
+
+uint8_t  USBD_CDC_Init(void *pdev, uint8_t cfgidx);
+
+uint8_t  USBD_CDC_DeInit(void *pdev, uint8_t cfgidx);
+
+uint8_t  USBD_CDC_Setup(void *pdev, USB_SETUP_REQ *req);
+
+uint8_t  USBD_CDC_EP0_RxReady(void *pdev);
+
+uint8_t  USBD_CDC_DataIn(void *pdev, uint8_t epnum);
+
+uint8_t  USBD_CDC_DataOut(void *pdev, uint8_t epnum);
+
+
+USBD_Class_cb_TypeDef  USBD_CDC_cb = 
+{
+    USBD_CDC_Init,
+    USBD_CDC_DeInit,
+    USBD_CDC_Setup,
+    NULL, /*EP0_TxSent*/  
+    USBD_CDC_EP0_RxReady,
+    USBD_CDC_DataIn,
+    USBD_CDC_DataOut,
+    NULL, /*SOF */ 
+    NULL,  
+    NULL,     
+    NULL, /* only used inside the composite configuration */
+};
+
+volatile uint8_t  CDC_Stream_Open;
+volatile uint32_t CDC_Stream_Dropped;
+
+/*
+ * Ring: main loop writes at Head, the IN pipe drains from Tail.
+ * Bytes [Tail, Tail + InFlight) are owned by the endpoint until DataIn.
+ */
+uint8_t                 *CDC_Stream_Buf;
+static volatile uint16_t CDC_Stream_Head;
+static volatile uint16_t CDC_Stream_Tail;
+static volatile uint16_t CDC_Stream_InFlight;
+static volatile uint8_t  CDC_Stream_ZLP;
+static volatile uint8_t  CDC_Stream_Busy;
+
+#ifdef USB_DATA_STRUCT_ALIGNED
+    #if defined ( __ICCARM__ ) /*!< IAR Compiler */
+        #pragma data_alignment=4   
+    #endif
+#endif /* USB_DATA_STRUCT_ALIGNED */
+/* 115200 8N1 by default; the value is ignored, the pipe runs at bulk speed */
+__ALIGN_BEGIN static uint8_t CDC_LineCoding[CDC_LINE_CODING_LEN] __ALIGN_END =
+{
+    0x00, 0xC2, 0x01, 0x00, 0x00, 0x00, 0x08
+};
+
+#ifdef USB_DATA_STRUCT_ALIGNED
+    #if defined ( __ICCARM__ ) /*!< IAR Compiler */
+        #pragma data_alignment=4   
+    #endif
+#endif /* USB_DATA_STRUCT_ALIGNED */
+__ALIGN_BEGIN static uint8_t CDC_RxBuf[CDC_DATA_MAX_PACKET] __ALIGN_END;
+
+static uint8_t CDC_AltSet = 0;
+
+/**
+* @brief  CDC_Stream_StartTx
+*         Start the next IN transfer if the pipe is idle; IRQ-safe callers only
+* @param  pdev: device instance
+* @retval None
+*/
+static void CDC_Stream_StartTx(void *pdev)
+{
+    uint16_t len;
+
+    if (CDC_Stream_Busy || !CDC_Stream_Open)
+    {
+        return;
+    }
+
+    len = (uint16_t)((CDC_Stream_Head - CDC_Stream_Tail) & (CDC_STREAM_BUF_SIZE - 1));
+    if (len == 0)
+    {
+        if (CDC_Stream_ZLP)
+        {
+            /* Last packet was full: terminate the transfer for the host */
+            CDC_Stream_ZLP = 0;
+            CDC_Stream_Busy = 1;
+            DCD_EP_Tx(pdev, CDC_IN_EP, CDC_Stream_Buf, 0);
+        }
+        return;
+    }
+
+    /* Contiguous run only, one packet at a time */
+    if (len > (CDC_STREAM_BUF_SIZE - CDC_Stream_Tail))
+    {
+        len = (uint16_t)(CDC_STREAM_BUF_SIZE - CDC_Stream_Tail);
+    }
+    if (len > CDC_DATA_MAX_PACKET)
+    {
+        len = CDC_DATA_MAX_PACKET;
+    }
+
+    CDC_Stream_Busy = 1;
+    CDC_Stream_InFlight = len;
+    CDC_Stream_ZLP = (len == CDC_DATA_MAX_PACKET);
+    DCD_EP_Tx(pdev, CDC_IN_EP, &CDC_Stream_Buf[CDC_Stream_Tail], len);
+}
+
+/**
+* @brief  CDC_Stream_Write
+*         Queue one record for the host. Records are never split: when the
+*         ring cannot take the whole record it is dropped and counted.
+* @param  data: record bytes
+* @param  len: record length
+* @retval 1 if queued, 0 if dropped or port closed
+*/
+uint8_t CDC_Stream_Write(const uint8_t *data, uint16_t len)
+{
+    uint16_t used, head, i;
+
+    if (!CDC_Stream_Open)
+    {
+        return 0;
+    }
+
+    head = CDC_Stream_Head;
+    used = (uint16_t)((head - CDC_Stream_Tail) & (CDC_STREAM_BUF_SIZE - 1));
+    if ((uint32_t)used + len >= CDC_STREAM_BUF_SIZE)
+    {
+        CDC_Stream_Dropped++;
+        return 0;
+    }
+
+    for (i = 0; i < len; i++)
+    {
+        CDC_Stream_Buf[head] = data[i];
+        head = (uint16_t)((head + 1) & (CDC_STREAM_BUF_SIZE - 1));
+    }
+    CDC_Stream_Head = head;
+    return 1;
+}
+
+/**
+* @brief  CDC_Stream_Kick
+*         Start transmitting queued data; call from the main loop after writes
+* @param  pdev: device instance
+* @retval None
+*/
+void CDC_Stream_Kick(void *pdev)
+{
+    NVIC_DisableIRQ(USB_IRQn);
+    CDC_Stream_StartTx(pdev);
+    NVIC_EnableIRQ(USB_IRQn);
+}
+
+/**
+* @brief  USBD_CDC_Init
+*         Open the notification and data endpoints
+* @param  pdev: device instance
+* @param  cfgidx: configuration index
+* @retval status
+*/
+uint8_t USBD_CDC_Init(void *pdev, uint8_t cfgidx)
+{
+    USBD_CDC_DeInit(pdev, cfgidx);
+
+    DCD_EP_Open(pdev, CDC_CMD_EP, CDC_CMD_PACKET_SIZE, USB_OTG_EP_INT);
+    DCD_EP_Open(pdev, CDC_IN_EP, CDC_DATA_MAX_PACKET, USB_OTG_EP_BULK);
+    DCD_EP_Open(pdev, CDC_OUT_EP, CDC_DATA_MAX_PACKET, USB_OTG_EP_BULK);
+
+    DCD_EP_PrepareRx(pdev, CDC_OUT_EP, CDC_RxBuf, CDC_DATA_MAX_PACKET);
+    return USBD_OK;
+}
+
+/**
+* @brief  USBD_CDC_DeInit
+*         Close the endpoints and drop anything still queued
+* @param  pdev: device instance
+* @param  cfgidx: configuration index
+* @retval status
+*/
+uint8_t USBD_CDC_DeInit(void *pdev, uint8_t cfgidx)
+{
+    DCD_EP_Close(pdev, CDC_CMD_EP);
+    DCD_EP_Close(pdev, CDC_IN_EP);
+    DCD_EP_Close(pdev, CDC_OUT_EP);
+
+    CDC_Stream_Open = 0;
+    CDC_Stream_Busy = 0;
+    CDC_Stream_InFlight = 0;
+    CDC_Stream_ZLP = 0;
+    CDC_Stream_Tail = CDC_Stream_Head;
+    return USBD_OK;
+}
+
+/**
+* @brief  USBD_CDC_Setup
+*         Handle the CDC-ACM class requests
+* @param  pdev: device instance
+* @param  req: USB request
+* @retval status
+*/
+uint8_t USBD_CDC_Setup(void *pdev, USB_SETUP_REQ *req)
+{
+    if ((req->bmRequest & USB_REQ_TYPE_MASK) != USB_REQ_TYPE_CLASS)
+    {
+        /* No alternate settings on either CDC interface */
+        if (req->bRequest == USB_REQ_GET_INTERFACE)
+        {
+            USBD_CtlSendData(pdev, &CDC_AltSet, 1);
+        }
+        return USBD_OK;
+    }
+
+    switch (req->bRequest)
+    {
+    case CDC_SET_LINE_CODING:
+        USBD_CtlPrepareRx(pdev, CDC_LineCoding, 
+            MIN(req->wLength, CDC_LINE_CODING_LEN));
+        break;
+
+    case CDC_GET_LINE_CODING:
+        USBD_CtlSendData(pdev, CDC_LineCoding, 
+            MIN(req->wLength, CDC_LINE_CODING_LEN));
+        break;
+
+    case CDC_SET_CONTROL_LINE_STATE:
+        /* DTR: terminal opened/closed. Start each session with an empty ring:
+         * drop what the last one left queued, only a packet the endpoint
+         * still owns goes out. Writes stop while closed, so Head is free. */
+        if (req->wValue & 0x0001)
+        {
+            if (!CDC_Stream_Open)
+            {
+                CDC_Stream_Head = (uint16_t)((CDC_Stream_Tail + CDC_Stream_InFlight) & (CDC_STREAM_BUF_SIZE - 1));
+            }
+            CDC_Stream_Open = 1;
+        }
+        else
+        {
+            CDC_Stream_Open = 0;
+        }
+        break;
+
+    case CDC_SEND_BREAK:
+        break;
+
+    default:
+        USBD_CtlError(pdev, req);
+        return USBD_FAIL;
+    }
+    return USBD_OK;
+}
+
+/**
+* @brief  USBD_CDC_EP0_RxReady
+*         Data stage of SET_LINE_CODING received
+* @param  pdev: device instance
+* @retval status
+*/
+uint8_t USBD_CDC_EP0_RxReady(void *pdev)
+{
+    /* Line coding stored in place; nothing to reconfigure */
+    return USBD_OK;
+}
+
+/**
+* @brief  USBD_CDC_DataIn
+*         Previous packet delivered: release it and send the next one
+* @param  pdev: device instance
+* @param  epnum: endpoint index
+* @retval status
+*/
+uint8_t USBD_CDC_DataIn(void *pdev, uint8_t epnum)
+{
+    if (epnum != (CDC_IN_EP & 0x7F))
+    {
+        return USBD_OK;
+    }
+
+    CDC_Stream_Tail = (uint16_t)((CDC_Stream_Tail + CDC_Stream_InFlight) & (CDC_STREAM_BUF_SIZE - 1));
+    CDC_Stream_InFlight = 0;
+    CDC_Stream_Busy = 0;
+    CDC_Stream_StartTx(pdev);
+    return USBD_OK;
+}
+
+/**
+* @brief  USBD_CDC_DataOut
+*         Host data is not used; re-arm the endpoint
+* @param  pdev: device instance
+* @param  epnum: endpoint index
+* @retval status
+*/
+uint8_t USBD_CDC_DataOut(void *pdev, uint8_t epnum)
+{
+    DCD_EP_PrepareRx(pdev, CDC_OUT_EP, CDC_RxBuf, CDC_DATA_MAX_PACKET);
+    return USBD_OK;
+}
@@ -0,0 +1,241 @@
+/**
+  ******************************************************************************
+  *          ===================================================================
+  *                             Composite Class  Description
+  *          ===================================================================
+  *           MSC + CDC-ACM in one configuration. Requests and endpoint events
+  *           are routed to the owning class by interface number / endpoint.
+  ******************************************************************************
+  */
+
+#include "comp_core.h"
+#include "msc_core.h"
+#include "cdc_core.h"
+#include "usbd_req.h"
+
+
+uint8_t  USBD_COMP_Init(void *pdev, uint8_t cfgidx);
+
+uint8_t  USBD_COMP_DeInit(void *pdev, uint8_t cfgidx);
+
+uint8_t  USBD_COMP_Setup(void *pdev, USB_SETUP_REQ *req);
+
+uint8_t  USBD_COMP_EP0_RxReady(void *pdev);
+
+uint8_t  USBD_COMP_DataIn(void *pdev, uint8_t epnum);
+
+uint8_t  USBD_COMP_DataOut(void *pdev, uint8_t epnum);
+
+uint8_t  *USBD_COMP_GetCfgDesc(uint8_t speed, uint16_t *length);
+
+
+USBD_Class_cb_TypeDef  USBD_COMP_cb = 
+{
+    USBD_COMP_Init,
+    USBD_COMP_DeInit,
+    USBD_COMP_Setup,
+    NULL, /*EP0_TxSent*/  
+    USBD_COMP_EP0_RxReady,
+    USBD_COMP_DataIn,
+    USBD_COMP_DataOut,
+    NULL, /*SOF */ 
+    NULL,  
+    NULL,     
+    USBD_COMP_GetCfgDesc,
+};
+
+#ifdef USB_DATA_STRUCT_ALIGNED
+    #if defined ( __ICCARM__ ) /*!< IAR Compiler */
+        #pragma data_alignment=4   
+    #endif
+#endif /* USB_DATA_STRUCT_ALIGNED */
+__ALIGN_BEGIN static uint8_t USBD_COMP_CfgDesc[USB_COMP_CONFIG_DESC_SIZ] __ALIGN_END =
+{
+    0x09,   /* bLength: Configuation Descriptor size */
+    USB_DESC_TYPE_CONFIGURATION,   /* bDescriptorType: Configuration */
+    USB_COMP_CONFIG_DESC_SIZ,
+
+    0x00,
+    0x03,   /* bNumInterfaces: 3 interfaces */
+    0x01,   /* bConfigurationValue: */
+    0x04,   /* iConfiguration: */
+    0xC0,   /* bmAttributes: */
+    0x32,   /* MaxPower 100 mA */
+
+    /********************  Mass Storage interface ********************/
+    0x09,   /* bLength: Interface Descriptor size */
+    0x04,   /* bDescriptorType: */
+    COMP_MSC_ITF_NBR,   /* bInterfaceNumber: Number of Interface */
+    0x00,   /* bAlternateSetting: Alternate setting */
+    0x02,   /* bNumEndpoints*/
+    0x08,   /* bInterfaceClass: MSC Class */
+    0x06,   /* bInterfaceSubClass : SCSI transparent*/
+    0x50,   /* nInterfaceProtocol : Bulk-Only(BBB) Transport(BOT) */
+    0x05,   /* iInterface: */
+    /********************  Mass Storage Endpoints ********************/
+    0x07,   /*Endpoint descriptor length = 7*/
+    0x05,   /*Endpoint descriptor type */
+    MSC_IN_EP,   /*Endpoint address */
+    0x02,   /*Bulk endpoint type */
+    LOBYTE(MSC_MAX_PACKET),
+    HIBYTE(MSC_MAX_PACKET),
+    0x00,   /*Polling interval in milliseconds */
+
+    0x07,   /*Endpoint descriptor length = 7 */
+    0x05,   /*Endpoint descriptor type */
+    MSC_OUT_EP,   /*Endpoint address */
+    0x02,   /*Bulk endpoint type */
+    LOBYTE(MSC_MAX_PACKET),
+    HIBYTE(MSC_MAX_PACKET),
+    0x00,   /*Polling interval in milliseconds*/
+
+    /********************  CDC interface association ********************/
+    0x08,   /* bLength: IAD size */
+    0x0B,   /* bDescriptorType: Interface Association */
+    COMP_CDC_CMD_ITF_NBR,   /* bFirstInterface */
+    0x02,   /* bInterfaceCount */
+    0x02,   /* bFunctionClass: CDC */
+    0x02,   /* bFunctionSubClass: ACM */
+    0x01,   /* bFunctionProtocol: AT commands */
+    0x00,   /* iFunction */
+
+    /********************  CDC communication interface ********************/
+    0x09,   /* bLength: Interface Descriptor size */
+    0x04,   /* bDescriptorType: */
+    COMP_CDC_CMD_ITF_NBR,   /* bInterfaceNumber */
+    0x00,   /* bAlternateSetting */
+    0x01,   /* bNumEndpoints */
+    0x02,   /* bInterfaceClass: CDC */
+    0x02,   /* bInterfaceSubClass: ACM */
+    0x01,   /* bInterfaceProtocol: AT commands */
+    0x00,   /* iInterface */
+
+    0x05,   /* bLength: Header Functional Descriptor */
+    0x24,   /* bDescriptorType: CS_INTERFACE */
+    0x00,   /* bDescriptorSubtype: Header */
+    0x10,   /* bcdCDC: 1.10 */
+    0x01,
+
+    0x05,   /* bLength: Call Management Functional Descriptor */
+    0x24,   /* bDescriptorType: CS_INTERFACE */
+    0x01,   /* bDescriptorSubtype: Call Management */
+    0x00,   /* bmCapabilities: D0+D1 */
+    COMP_CDC_DATA_ITF_NBR,   /* bDataInterface */
+
+    0x04,   /* bLength: ACM Functional Descriptor */
+    0x24,   /* bDescriptorType: CS_INTERFACE */
+    0x02,   /* bDescriptorSubtype: Abstract Control Management */
+    0x02,   /* bmCapabilities: line coding + control line state */
+
+    0x05,   /* bLength: Union Functional Descriptor */
+    0x24,   /* bDescriptorType: CS_INTERFACE */
+    0x06,   /* bDescriptorSubtype: Union */
+    COMP_CDC_CMD_ITF_NBR,   /* bMasterInterface */
+    COMP_CDC_DATA_ITF_NBR,  /* bSlaveInterface0 */
+
+    0x07,   /*Endpoint descriptor length = 7 */
+    0x05,   /*Endpoint descriptor type */
+    CDC_CMD_EP,   /*Endpoint address */
+    0x03,   /*Interrupt endpoint type */
+    LOBYTE(CDC_CMD_PACKET_SIZE),
+    HIBYTE(CDC_CMD_PACKET_SIZE),
+    0xFF,   /*Polling interval in milliseconds */
+
+    /********************  CDC data interface ********************/
+    0x09,   /* bLength: Interface Descriptor size */
+    0x04,   /* bDescriptorType: */
+    COMP_CDC_DATA_ITF_NBR,   /* bInterfaceNumber */
+    0x00,   /* bAlternateSetting */
+    0x02,   /* bNumEndpoints */
+    0x0A,   /* bInterfaceClass: CDC Data */
+    0x00,   /* bInterfaceSubClass */
+    0x00,   /* bInterfaceProtocol */
+    0x00,   /* iInterface */
+
+    0x07,   /*Endpoint descriptor length = 7 */
+    0x05,   /*Endpoint descriptor type */
+    CDC_OUT_EP,   /*Endpoint address */
+    0x02,   /*Bulk endpoint type */
+    LOBYTE(CDC_DATA_MAX_PACKET),
+    HIBYTE(CDC_DATA_MAX_PACKET),
+    0x00,   /*Polling interval in milliseconds */
+
+    0x07,   /*Endpoint descriptor length = 7 */
+    0x05,   /*Endpoint descriptor type */
+    CDC_IN_EP,   /*Endpoint address */
+    0x02,   /*Bulk endpoint type */
+    LOBYTE(CDC_DATA_MAX_PACKET),
+    HIBYTE(CDC_DATA_MAX_PACKET),
+    0x00    /*Polling interval in milliseconds */
+};
+
+
+/**
+* @brief  USBD_COMP_IsMscReq
+*         Decide which function a control request belongs to
+* @param  req: USB request
+* @retval 1 for MSC, 0 for CDC
+*/
+static uint8_t USBD_COMP_IsMscReq(USB_SETUP_REQ *req)
+{
+    uint8_t idx = LOBYTE(req->wIndex);
+
+    if ((req->bmRequest & 0x1F) == USB_REQ_RECIPIENT_ENDPOINT)
+    {
+        return ((idx & 0x7F) == (MSC_IN_EP & 0x7F)) || ((idx & 0x7F) == (MSC_OUT_EP & 0x7F));
+    }
+    return (idx == COMP_MSC_ITF_NBR);
+}
+
+uint8_t USBD_COMP_Init(void *pdev, uint8_t cfgidx)
+{
+    USBD_MSC_cb.Init(pdev, cfgidx);
+    USBD_CDC_cb.Init(pdev, cfgidx);
+    return USBD_OK;
+}
+
+uint8_t USBD_COMP_DeInit(void *pdev, uint8_t cfgidx)
+{
+    USBD_MSC_cb.DeInit(pdev, cfgidx);
+    USBD_CDC_cb.DeInit(pdev, cfgidx);
+    return USBD_OK;
+}
+
+uint8_t USBD_COMP_Setup(void *pdev, USB_SETUP_REQ *req)
+{
+    if (USBD_COMP_IsMscReq(req))
+    {
+        return USBD_MSC_cb.Setup(pdev, req);
+    }
+    return USBD_CDC_cb.Setup(pdev, req);
+}
+
+/* Only CDC uses a control OUT data stage */
+uint8_t USBD_COMP_EP0_RxReady(void *pdev)
+{
+    return USBD_CDC_cb.EP0_RxReady(pdev);
+}
+
+uint8_t USBD_COMP_DataIn(void *pdev, uint8_t epnum)
+{
+    if (epnum == (MSC_IN_EP & 0x7F))
+    {
+        return USBD_MSC_cb.DataIn(pdev, epnum);
+    }
+    return USBD_CDC_cb.DataIn(pdev, epnum);
+}
+
+uint8_t USBD_COMP_DataOut(void *pdev, uint8_t epnum)
+{
+    if (epnum == (MSC_OUT_EP & 0x7F))
+    {
+        return USBD_MSC_cb.DataOut(pdev, epnum);
+    }
+    return USBD_CDC_cb.DataOut(pdev, epnum);
+}
+
+uint8_t *USBD_COMP_GetCfgDesc(uint8_t speed, uint16_t *length)
+{
+    *length = (uint16_t)sizeof(USBD_COMP_CfgDesc);
+    return USBD_COMP_CfgDesc;
+}
@@ -11,12 +11,26 @@ uint16_t MSC_BOT_DataLen;
 uint8_t MSC_BOT_State;
 uint8_t MSC_BOT_Status;
 
-#ifdef USB_DATA_STRUCT_ALIGNED
-  #if defined ( __ICCARM__ ) /*!< IAR Compiler */
-    #pragma data_alignment=4   
-  #endif
-#endif /* USB_DATA_STRUCT_ALIGNED */
-__ALIGN_BEGIN uint8_t MSC_BOT_Data[MSC_MEDIA_PACKET] __ALIGN_END ; 
+/*
+ * BOT event queue. The USB ISR only records endpoint completions here;
+ * SCSI/storage work runs from the main loop in MSC_BOT_Process(), so a
+ * slow storage read no longer holds off RTC, WKUP or BSTIM interrupts.
+ * The endpoints stay un-armed (host gets NAK) until the event is handled.
+ * Single producer (ISR) / single consumer (main loop).
+ */
+typedef struct _MSC_BOT_EVT
+{
+    uint8_t evt;
+    uint8_t epnum;
+} MSC_BOT_EVT_TypeDef;
+
+static MSC_BOT_EVT_TypeDef MSC_BOT_EvtQueue[BOT_EVT_QUEUE_LEN];
+static volatile uint8_t MSC_BOT_EvtHead;
+static volatile uint8_t MSC_BOT_EvtTail;
+volatile uint8_t MSC_BOT_EvtOverflow;
+
+/* MSC_MEDIA_PACKET bytes, 4-byte aligned in the arena: set by USBInit() */
+uint8_t *MSC_BOT_Data;
 
 #ifdef USB_DATA_STRUCT_ALIGNED
   #if defined ( __ICCARM__ ) /*!< IAR Compiler */
@@ -44,6 +58,8 @@ static void MSC_BOT_Abort(void *pdev);
 */
 void MSC_BOT_Init(void *pdev)
 {
+    MSC_BOT_EvtHead = 0;
+    MSC_BOT_EvtTail = 0;
     MSC_BOT_State = BOT_IDLE;
     MSC_BOT_Status = BOT_STATE_NORMAL;
     USBD_STORAGE_fops->Init(0);
@@ -135,6 +151,77 @@ void MSC_BOT_DataOut(void *pdev, uint8_t epnum)
     }
 }
 
+/**
+* @brief  MSC_BOT_QueueEvent
+*         Record a BOT event from interrupt context
+* @param  evt: BOT_EVT_xxx
+* @param  epnum: endpoint index
+* @retval None
+*/
+void MSC_BOT_QueueEvent(uint8_t evt, uint8_t epnum)
+{
+    uint8_t next = (uint8_t)((MSC_BOT_EvtTail + 1) % BOT_EVT_QUEUE_LEN);
+
+    if (next == MSC_BOT_EvtHead)
+    {
+        /* Cannot happen with one outstanding transfer per direction */
+        MSC_BOT_EvtOverflow++;
+        return;
+    }
+    MSC_BOT_EvtQueue[MSC_BOT_EvtTail].evt = evt;
+    MSC_BOT_EvtQueue[MSC_BOT_EvtTail].epnum = epnum;
+    MSC_BOT_EvtTail = next;
+}
+
+/**
+* @brief  MSC_BOT_Process
+*         Run queued BOT events; call from the main loop while attached.
+*         Each event runs with the USB IRQ masked because the BOT state
+*         machine and endpoint registers are shared with the ISR.
+* @param  pdev: device instance
+* @retval None
+*/
+void MSC_BOT_Process(void *pdev)
+{
+    MSC_BOT_EVT_TypeDef e;
+
+    while (MSC_BOT_EvtHead != MSC_BOT_EvtTail)
+    {
+        NVIC_DisableIRQ(USB_IRQn);
+        if (MSC_BOT_EvtHead == MSC_BOT_EvtTail)
+        {
+            /* Flushed by MSC_BOT_Init() in the meantime */
+            NVIC_EnableIRQ(USB_IRQn);
+            break;
+        }
+        e = MSC_BOT_EvtQueue[MSC_BOT_EvtHead];
+        MSC_BOT_EvtHead = (uint8_t)((MSC_BOT_EvtHead + 1) % BOT_EVT_QUEUE_LEN);
+
+        switch (e.evt)
+        {
+        case BOT_EVT_DATA_IN:
+            MSC_BOT_DataIn(pdev, e.epnum);
+            break;
+
+        case BOT_EVT_DATA_OUT:
+            MSC_BOT_DataOut(pdev, e.epnum);
+            break;
+
+        case BOT_EVT_RESET:
+            MSC_BOT_Reset(pdev);
+            break;
+
+        case BOT_EVT_CLR_FEATURE:
+            MSC_BOT_CplClrFeature(pdev, e.epnum);
+            break;
+
+        default:
+            break;
+        }
+        NVIC_EnableIRQ(USB_IRQn);
+    }
+}
+
 /**
 * @brief  MSC_BOT_CBW_Decode
 *         Decode the CBW command and set the BOT state machine accordingtly  
@@ -195,7 +195,7 @@ uint8_t USBD_MSC_Setup(void *pdev, USB_SETUP_REQ *req)
                 (req->wLength == 0) &&
                 ((req->bmRequest & 0x80) != 0x80))
             {      
-                MSC_BOT_Reset(pdev);
+                MSC_BOT_QueueEvent(BOT_EVT_RESET, 0);
             }
             else
             {
@@ -238,7 +238,7 @@ uint8_t USBD_MSC_Setup(void *pdev, USB_SETUP_REQ *req)
             }
 
             /* Handle BOT error */
-            MSC_BOT_CplClrFeature(pdev, (uint8_t)req->wIndex);
+            MSC_BOT_QueueEvent(BOT_EVT_CLR_FEATURE, (uint8_t)req->wIndex);
             break;
         }  
         break;
@@ -259,7 +259,7 @@ uint8_t USBD_MSC_Setup(void *pdev, USB_SETUP_REQ *req)
 */
 uint8_t USBD_MSC_DataIn(void  *pdev, uint8_t epnum)
 {
-    MSC_BOT_DataIn(pdev, epnum);
+    MSC_BOT_QueueEvent(BOT_EVT_DATA_IN, epnum);
     return USBD_OK;
 }
 
@@ -272,7 +272,7 @@ uint8_t USBD_MSC_DataIn(void  *pdev, uint8_t epnum)
 */
 uint8_t USBD_MSC_DataOut(void *pdev, uint8_t epnum)
 {
-    MSC_BOT_DataOut(pdev, epnum);
+    MSC_BOT_QueueEvent(BOT_EVT_DATA_OUT, epnum);
     return USBD_OK;
 }
 
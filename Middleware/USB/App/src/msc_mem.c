@@ -6,43 +6,111 @@
 #include <stdio.h>
 
 /*
- * MSC: read-only FAT12 volume in RAM.
- * File content is cached from external SPI flash (FileEntry at FILE_ADDRESS)
- * by calling MSC_PrepareImage() BEFORE USBInit().
+ * MSC LUN 0: FAT16 volume, every sector built on demand.
+ * Nothing is stored as an image: directory entries, FAT chains and file
+ * contents are computed from the day index over the record log
+ * (log_index.c) and from the 5-line log file (FileEntry at FILE_ADDRESS).
  *
- * Exposes exactly 1 file (name from flash if valid, else FILE_NAME),
- * with content "Hello World!" (enforced for now).
+ *   <file.txt>     5-line text log, cached in RAM by MSC_PrepareImage()
+ *   CONFIG.TXT     device settings (config_store.c), the only writable file
+ *   STATUS.TXT     clock, log range, USB statistics, RAM arena use
+ *   SUMMARY.CSV    one line per indexed day: primary sensor samples, errors, min/max/mean
+ *   PROFILE.CSV    wake-window timing per phase (profile.c): count,
+ *                  min/mean/max and a log2 histogram
+ *   YYYYMMDD.CSV   one file per day; moved into YYYY-MM\ subdirectories
+ *                  once there are more than VFS_FLAT_MAX_DAYS days. One
+ *                  line per record, one column per sensor channel in the
+ *                  log: a record fills its channel's column only
+ *
+ * CSV lines are fixed width so file sizes follow from record counts and
+ * any sector can be rendered from a handful of records.
+ * The unit reports NOT READY until MSC_PrepareImage() has run and the day
+ * index caught up with the record log (MSC_Poll(), MSC_INDEX_RUN records a
+ * pass: the first attach after power-up reads the whole log).
+ *
+ * MSC LUN 1 (MSC_RAW_FLASH_LUN): the whole P25Q16SH, read-only, LBAs mapped
+ * 1:1 onto flash bytes, for full-chip dumps (dd) and offline analysis.
+ * Reported only after MSC_EnableRawLun(1), so normal users don't get an
+ * unformatted second drive.
  */
 
-#define STORAGE_LUN_NBR          1
+#define STORAGE_LUN_NBR          (1 + MSC_RAW_FLASH_LUN)
+#define LUN_RAW_FLASH            1u
 
-/* FAT12 tiny layout */
+/* FAT16 layout: 4 KB clusters, 16384 clusters (64 MB, mostly free) */
 #define SECTOR_SIZE             512u
-#define VOL_SECTORS             64u   /* 32KB virtual disk */
+#define BPB_SEC_PER_CLUS        8u
+#define CLUSTER_SIZE            (SECTOR_SIZE * BPB_SEC_PER_CLUS)
+#define DATA_CLUSTERS           16384u
 
-#define BPB_SEC_PER_CLUS        1u
 #define BPB_RSVD_SEC_CNT        1u
 #define BPB_NUM_FATS            2u
-#define BPB_ROOT_ENT_CNT        16u   /* 16 entries => 1 sector */
-#define BPB_FATSZ16             1u
+#define BPB_ROOT_ENT_CNT        128u  /* 128 entries => 8 sectors */
+#define BPB_FATSZ16             (((DATA_CLUSTERS + 2u) * 2u + SECTOR_SIZE - 1u) / SECTOR_SIZE)   /* 65 */
 
-#define ROOT_DIR_SECTORS        1u
+#define ROOT_DIR_SECTORS        ((BPB_ROOT_ENT_CNT * 32u) / SECTOR_SIZE)
 
 #define LBA_BOOT                0u
 #define LBA_FAT1                (LBA_BOOT + BPB_RSVD_SEC_CNT)                 /* 1 */
-#define LBA_FAT2                (LBA_FAT1 + BPB_FATSZ16)                      /* 2 */
-#define LBA_ROOT                (LBA_FAT2 + BPB_FATSZ16)                      /* 3 */
-#define LBA_DATA                (LBA_ROOT + ROOT_DIR_SECTORS)                 /* 4 */
-#define CLUSTER2_LBA            (LBA_DATA)                                    /* cluster #2 => first data sector */
+#define LBA_FAT2                (LBA_FAT1 + BPB_FATSZ16)                      /* 66 */
+#define LBA_ROOT                (LBA_FAT2 + BPB_FATSZ16)                      /* 131 */
+#define LBA_DATA                (LBA_ROOT + ROOT_DIR_SECTORS)                 /* 139 */
+#define VOL_SECTORS             (LBA_DATA + DATA_CLUSTERS * BPB_SEC_PER_CLUS)
+
+#define RAW_SECTORS             (FLASH_TOTAL_SIZE / SECTOR_SIZE)              /* 4096 */
+
+/* Virtual files */
+#define VFS_FLAT_MAX_DAYS       31u   /* more days => one subdirectory per month */
+
+#define VFS_LOG                 0u
+#define VFS_CONFIG              1u
+#define VFS_STATUS              2u
+#define VFS_SUMMARY             3u
+#define VFS_PROFILE             4u
+#define VFS_MONTH               5u
+#define VFS_DAY                 6u
+
+#define DAY_HDR                 "time,temp_C\r\n"   /* channel 0 only */
+#define DAY_LINE_LEN(cols)      (10u + 10u * (cols))   /* "HH:MM:SS" + ",+TTT.TTTT" per column + "\r\n" */
+#define SUM_HDR                 "date,chan,samples,errors,min_C,max_C,mean_C\r\n"   /* primary only, see log_index.h */
+#define SUM_HDR_LEN             (sizeof(SUM_HDR) - 1u)
+#define SUM_LINE_LEN            57u   /* "YYYY-MM-DD,C,NNNNNN,NNNNN,+TTT.TTTT,+TTT.TTTT,+TTT.TTTT\r\n" */
+/* STATUS.TXT is rendered into one sector: 425 bytes at the set field
+ * widths, room for the USB stamps that are not seen yet (10 digits) */
+#define STATUS_LEN_MAX          480u
+typedef char status_fits_sector[(STATUS_LEN_MAX < SECTOR_SIZE) ? 1 : -1];
+#define PROF_HDR                "phase,count,min_us,mean_us,max_us,<31us,<61us,<122us,<244us,<488us,<977us," \
+                                "<2ms,<4ms,<8ms,<16ms,<31ms,<62ms,<125ms,<250ms,<500ms,>=500ms\r\n"
+#define PROF_HDR_LEN            (sizeof(PROF_HDR) - 1u)
+#define PROF_LINE_LEN           (48u + 6u * PROFILE_BINS)   /* name padded to 11, 4 counters, one ",NNNNN" per bin, CRLF */
+
+typedef struct {
+    uint8_t  kind;      /* VFS_xxx */
+    uint8_t  day;       /* index into the day index (VFS_MONTH / VFS_DAY) */
+    uint16_t clus;      /* first cluster, files are contiguous */
+    uint16_t nclus;
+    uint32_t size;      /* bytes, 0 for directories */
+} vfs_obj_t;
+
+typedef struct {
+    uint8_t  step;
+    uint8_t  day;
+    uint8_t  month_open;
+    uint16_t clus;
+} vfs_iter_t;
 
 /* "Hello World!" source-of-truth for now */
 #define MSC_FILE_CONTENT        "Hello 2 World!"
 
 static volatile uint8_t g_storage_ready = 0u;
-static uint8_t g_prepared = 0u;
+static volatile uint8_t g_prepared = 0u;
+static uint8_t g_indexing = 0u;    /* prepared but for the log index */
+static volatile uint8_t g_media_changed[STORAGE_LUN_NBR];   /* raised by MSC_RefreshImage() */
+static uint8_t g_raw_lun_on = 0u;
 
-/* Cached file (served to host) */
-static uint8_t  g_file_buf[256];
+/* Cached file (served to host), MSC_FILE_BUF_SIZE bytes in the arena */
+#define MSC_FILE_BUF_SIZE       256u
+static uint8_t *g_file_buf;
 static uint32_t g_file_len = 0u;
 static char     g_file_name[32];   /* from flash if valid */
 
@@ -52,7 +120,16 @@ static int8_t STORAGE_Inquirydata[] = {
     0x00, 0x00, 0x00,
     'F','M','3','3',' ',' ',' ',' ',
     'S','P','I',' ','F','l','a','s','h',' ','M','S','C',' ',' ',' ',
+    '1','.','0','0',
+#if MSC_RAW_FLASH_LUN
+    /* LUN 1 */
+    0x00, 0x80, 0x02, 0x02,
+    (USBD_STD_INQUIRY_LENGTH - 5),
+    0x00, 0x00, 0x00,
+    'F','M','3','3',' ',' ',' ',' ',
+    'P','2','5','Q','1','6','S','H',' ','R','a','w',' ',' ',' ',' ',
     '1','.','0','0'
+#endif
 };
 
 static void le16(uint8_t *p, uint16_t v) { p[0] = (uint8_t)(v & 0xFF); p[1] = (uint8_t)((v >> 8) & 0xFF); }
@@ -82,7 +159,322 @@ static void make_83_name(const char *in, char out83[11])
     }
 }
 
-/* ---------------- FAT12 sector builders ---------------- */
+/* ---------------- Virtual file layout ---------------- */
+
+static uint16_t g_status_len;      /* STATUS.TXT size, fixed-width fields */
+static uint16_t g_config_len;      /* CONFIG.TXT size */
+static uint16_t g_config_clus;     /* CONFIG.TXT first cluster */
+static uint8_t  g_month_dirs;      /* day files live in YYYY-MM subdirectories */
+static uint16_t g_end_clus = 2u;   /* first cluster after the last object */
+static uint8_t  g_day_cols = 1u;   /* day CSV columns: highest channel in the log + 1 */
+static char     g_day_hdr[48] = DAY_HDR;
+static uint8_t  g_day_hdr_len = sizeof(DAY_HDR) - 1u;
+
+static uint16_t month_key(uint16_t day)
+{
+    unsigned int y;
+    unsigned char m;
+    RTC_DaysToDate(day, &y, &m, NULL);
+    return (uint16_t)(y * 12u + (m - 1u));
+}
+
+static uint16_t fat_date(uint16_t day)
+{
+    unsigned int y;
+    unsigned char m, d;
+    RTC_DaysToDate(day, &y, &m, &d);
+    return (uint16_t)(((y + 20u) << 9) | ((uint16_t)m << 5) | d);   /* FAT years from 1980 */
+}
+
+static uint32_t vfs_size(uint8_t kind, uint8_t day)
+{
+    switch (kind) {
+    case VFS_LOG:     return g_file_len;
+    case VFS_CONFIG:  return g_config_len;
+    case VFS_STATUS:  return g_status_len;
+    case VFS_SUMMARY: return SUM_HDR_LEN + (uint32_t)LogIndex_Days() * SUM_LINE_LEN;
+    case VFS_PROFILE: return PROF_HDR_LEN + PROFILE_PHASES * PROF_LINE_LEN;
+    case VFS_DAY:     return g_day_hdr_len + LogIndex_Day(day)->count * DAY_LINE_LEN(g_day_cols);
+    default:          return 0u;
+    }
+}
+
+static void vfs_begin(vfs_iter_t *it)
+{
+    memset(it, 0, sizeof(*it));
+    it->clus = 2u;
+}
+
+/* Objects in cluster order: LOG, CONFIG, STATUS, SUMMARY, PROFILE, then [month dir,] day files */
+static uint8_t vfs_next(vfs_iter_t *it, vfs_obj_t *o)
+{
+    uint32_t nclus;
+
+    if (it->step < VFS_MONTH) {
+        o->kind = it->step++;
+        o->day = 0u;
+    } else {
+        if (it->day >= LogIndex_Days()) return 0;
+
+        if (g_month_dirs && !it->month_open &&
+            (it->day == 0u || month_key(LogIndex_Day(it->day)->day) != month_key(LogIndex_Day(it->day - 1u)->day))) {
+            o->kind = VFS_MONTH;
+            it->month_open = 1u;
+        } else {
+            o->kind = VFS_DAY;
+            it->month_open = 0u;
+        }
+        o->day = it->day;
+        if (o->kind == VFS_DAY) it->day++;
+    }
+
+    o->size = vfs_size(o->kind, o->day);
+    nclus = (o->kind == VFS_MONTH) ? 1u : (o->size + CLUSTER_SIZE - 1u) / CLUSTER_SIZE;
+    if (nclus == 0u) nclus = 1u;
+    if (it->clus + nclus > DATA_CLUSTERS + 2u) return 0;   /* volume full: stop listing */
+
+    o->clus  = it->clus;
+    o->nclus = (uint16_t)nclus;
+    it->clus = (uint16_t)(it->clus + nclus);
+    return 1;
+}
+
+static uint8_t vfs_find_cluster(uint16_t clus, vfs_obj_t *o)
+{
+    vfs_iter_t it;
+    vfs_begin(&it);
+    while (vfs_next(&it, o)) {
+        if (clus >= o->clus && clus < o->clus + o->nclus) return 1;
+    }
+    return 0;
+}
+
+/* ---------------- Text renderers (fixed width) ---------------- */
+
+static void fmt_q4(char *out, int32_t q4)
+{
+    /* 9 chars: sign, 3 digits, '.', 4 decimals (1/16 = 0.0625) */
+    char sign = (q4 < 0) ? '-' : '+';
+    uint32_t a = (uint32_t)((q4 < 0) ? -q4 : q4);
+    (void)sprintf(out, "%c%03lu.%04lu", sign, (unsigned long)(a >> 4), (unsigned long)((a & 0x0Fu) * 625u));
+}
+
+static void fmt_q8(char *out, int32_t q8)
+{
+    /* Same 9 chars as fmt_q4; 1/256 rounded to 4 decimals */
+    char sign = (q8 < 0) ? '-' : '+';
+    uint32_t a = (uint32_t)((q8 < 0) ? -q8 : q8);
+    (void)sprintf(out, "%c%03lu.%04lu", sign, (unsigned long)(a >> 8), (unsigned long)(((a & 0xFFu) * 625u + 8u) >> 4));
+}
+
+static int render_status(char *buf, uint32_t size)
+{
+    unsigned int y;
+    unsigned char mo, d, hh, mm, ss;
+    uint32_t now = RTC_ReadEpoch2000();
+    int32_t trim = RtcCal_TrimPpb();
+    uint32_t trim_a = (uint32_t)((trim < 0) ? -trim : trim);
+    const TempAcqStats *acq = TempAcq_Stats();
+    const LogSupply *sup = LogIndex_Supply();
+    int32_t life = Supply_LifeDays();
+    char mcu[10], life_s[8];
+    char chans[5u * NST112_MAX_SENSORS + 1u];
+
+    for (uint8_t ch = 0u; ch < NST112_MAX_SENSORS; ch++) {
+        if (acq->chans & (1u << ch)) {
+            (void)sprintf(&chans[ch * 5u], " 0x%02X", (unsigned int)(NST112_I2C_ADDR + ch));
+        } else {
+            memcpy(&chans[ch * 5u], "   --", 6);
+        }
+    }
+
+    fmt_q4(mcu, sup->last_mcu_q4);
+    if (life < 0) {
+        memcpy(life_s, "unknown", 8);
+    } else {
+        (void)sprintf(life_s, "%7ld", (long)life);
+    }
+
+    RTC_DaysToDate(now / 86400u, &y, &mo, &d);
+    hh = (unsigned char)((now / 3600u) % 24u);
+    mm = (unsigned char)((now / 60u) % 60u);
+    ss = (unsigned char)(now % 60u);
+
+    return snprintf(buf, size,
+        "TempTrack status\r\n"
+        "RTC 20%02u-%02u-%02u %02u:%02u:%02u trim %c%03lu.%03lu ppm %3u syncs\r\n"
+        "Log seq %10lu..%10lu of %10lu, days %3u/%3u\r\n"
+        "USB enum ms %6lu %6lu %6lu, ISR max %5u us, CDC dropped %10lu\r\n"
+        "Burst %u IIR 1/2^%u wait %5u ms %8lu cycles\r\n"
+        "Sensors%s\r\n"
+        "Supply %5u mV, MCU %s C, SVD warnings %5u\r\n"
+        "Battery days %s to %4u mV\r\n"
+        "Arena used %4lu, high USB %4lu battery %4lu of %4lu\r\n",
+        y, mo, d, hh, mm, ss,
+        (trim < 0) ? '-' : '+', (unsigned long)(trim_a / 1000u), (unsigned long)(trim_a % 1000u), RtcCal_Learned(),
+        (unsigned long)LogStore_FirstSeq(), (unsigned long)LogStore_NextSeq(), (unsigned long)LOG_SLOTS,
+        LogIndex_Days(), LOG_INDEX_MAX_DAYS,
+        (unsigned long)usb_enum_stats.first_setup_ms, (unsigned long)usb_enum_stats.configured_ms,
+        (unsigned long)usb_enum_stats.mount_ms,
+        usb_isr_max_us, (unsigned long)USB_Stream_Dropped(),
+        acq->burst, acq->iir_shift, acq->wait_ms, (unsigned long)acq->filter_cycles,
+        chans,
+        sup->last_mv, mcu, sup->nbrownout,
+        life_s, SUPPLY_CUTOFF_MV,
+        (unsigned long)Arena_Used(), (unsigned long)Arena_HighWater(ARENA_MODE_USB),
+        (unsigned long)Arena_HighWater(ARENA_MODE_BATTERY), (unsigned long)ARENA_SIZE);
+}
+
+static void render_day_value(const LogRecord *rec, char *v)
+{
+    if (rec->type == LOG_REC_TEMP) {
+        fmt_q8(v, (int32_t)rec->value * 16 + (rec->aux & 0x0Fu));
+    } else if (rec->type == LOG_REC_SENSOR_ERR) {
+        (void)sprintf(v, "ERR %5d", (int)(int16_t)rec->aux);
+    } else if (rec->type == LOG_REC_ALARM) {
+        (void)sprintf(v, "ALARM %s", (rec->aux == LOG_ALARM_HIGH) ? " HI" : " LO");
+    } else if (rec->type == LOG_REC_EXCURSION) {
+        (void)sprintf(v, "%s%s", ((rec->aux & ~LOG_EXCURSION_END) == LOG_ALARM_HIGH) ? "HI" : "LO",
+            (rec->aux & LOG_EXCURSION_END) ? "    END" : "  START");
+    } else if (rec->type == LOG_REC_SUPPLY) {
+        (void)sprintf(v, "%3u.%03u V", (unsigned int)((uint16_t)rec->value / 1000u),
+            (unsigned int)((uint16_t)rec->value % 1000u));
+    } else if (rec->type == LOG_REC_BROWNOUT) {
+        memcpy(v, "SUPPLY LO", 10);
+    } else if (rec->type == LOG_REC_TIME_SET) {
+        int32_t delta = (int32_t)(((uint32_t)(uint16_t)rec->value << 16) | rec->aux);
+        if (delta >= -99999 && delta <= 99999) {
+            (void)sprintf(v, "CLK%+6ld", (long)delta);
+        } else {
+            memcpy(v, "CLK   SET", 10);
+        }
+    } else {
+        (void)sprintf(v, "   evt%3u", rec->type);
+    }
+}
+
+static void render_day_line(uint32_t seq, char *line)
+{
+    LogRecord rec;
+    char v[10];
+    char *p;
+    uint8_t col = 0u;
+    uint32_t t;
+
+    if (!LogStore_ReadSeq(seq, &rec)) {
+        memcpy(line, "--:--:--", 8);
+        memcpy(v, "      n/a", 10);
+    } else {
+        render_day_value(&rec, v);
+        if (rec.chan < g_day_cols) col = rec.chan;
+        t = rec.time % 86400u;
+        (void)sprintf(line, "%02lu:%02lu:%02lu",
+            (unsigned long)(t / 3600u), (unsigned long)((t / 60u) % 60u), (unsigned long)(t % 60u));
+    }
+
+    /* Value in its channel's column, the other columns empty, padded to width */
+    p = line + 8;
+    for (uint8_t c = 0u; c < g_day_cols; c++) {
+        *p++ = ',';
+        if (c == col) {
+            memcpy(p, v, 9);
+            p += 9;
+        }
+    }
+    while (p < line + DAY_LINE_LEN(g_day_cols) - 2u) *p++ = ' ';
+    memcpy(p, "\r\n", 2);
+}
+
+static void render_summary_line(uint16_t i, char *line)
+{
+    const LogDay *dd = LogIndex_Day(i);
+    unsigned int y;
+    unsigned char m, d;
+    char tmin[10], tmax[10], tmean[10];
+
+    RTC_DaysToDate(dd->day, &y, &m, &d);
+    if (dd->ntemp) {
+        int32_t mean = (dd->tsum >= 0) ? (dd->tsum + (int32_t)(dd->ntemp / 2u)) / (int32_t)dd->ntemp
+                                       : (dd->tsum - (int32_t)(dd->ntemp / 2u)) / (int32_t)dd->ntemp;
+        fmt_q4(tmin, dd->tmin);
+        fmt_q4(tmax, dd->tmax);
+        fmt_q4(tmean, mean);
+    } else {
+        strcpy(tmin, "      n/a");
+        strcpy(tmax, "      n/a");
+        strcpy(tmean, "      n/a");
+    }
+    (void)sprintf(line, "20%02u-%02u-%02u,%c,%6lu,%5u,%s,%s,%s\r\n", y, m, d,
+        (dd->chan < LOG_CHANNELS) ? (char)('0' + dd->chan) : '-',
+        (unsigned long)dd->ntemp, dd->nerr, tmin, tmax, tmean);
+}
+
+static void render_profile_line(uint8_t i, char *line)
+{
+    const ProfilePhase *p = &Profile_Get()->phase[i];
+    uint32_t mean = p->count ? (p->sum + p->count / 2u) / p->count : 0u;
+    int n;
+
+    n = sprintf(line, "%-11s,%7lu,%8lu,%8lu,%8lu", Profile_Name(i), (unsigned long)p->count,
+        (unsigned long)Profile_Us(p->count ? p->min : 0u), (unsigned long)Profile_Us(mean),
+        (unsigned long)Profile_Us(p->max));
+    for (uint8_t b = 0u; b < PROFILE_BINS; b++) {
+        n += sprintf(&line[n], ",%5u", p->hist[b]);
+    }
+    memcpy(&line[n], "\r\n", 2);
+}
+
+/*
+ * Fill one sector of a fixed-line-width text file: header, then nlines
+ * lines of line_len bytes each, produced by line_fn(first_arg + i).
+ */
+static void render_lines(uint8_t *sec, uint32_t off, const char *hdr, uint32_t hdr_len,
+                         uint32_t line_len, uint32_t nlines, uint32_t first_arg,
+                         void (*line_fn)(uint32_t arg, char *line))
+{
+    char line[160];
+    uint32_t pos = 0u;
+
+    while (pos < SECTOR_SIZE) {
+        uint32_t at = off + pos;
+        const char *src;
+        uint32_t src_off, src_len, n;
+
+        if (at < hdr_len) {
+            src = hdr;
+            src_off = at;
+            src_len = hdr_len;
+        } else {
+            uint32_t li = (at - hdr_len) / line_len;
+            if (li >= nlines) break;
+            line_fn(first_arg + li, line);
+            src = line;
+            src_off = (at - hdr_len) % line_len;
+            src_len = line_len;
+        }
+        n = src_len - src_off;
+        if (n > SECTOR_SIZE - pos) n = SECTOR_SIZE - pos;
+        memcpy(&sec[pos], &src[src_off], n);
+        pos += n;
+    }
+}
+
+static void day_line_fn(uint32_t seq, char *line)
+{
+    render_day_line(seq, line);
+}
+
+static void summary_line_fn(uint32_t i, char *line)
+{
+    render_summary_line((uint16_t)i, line);
+}
+
+static void profile_line_fn(uint32_t i, char *line)
+{
+    render_profile_line((uint8_t)i, line);
+}
+
+/* ---------------- FAT16 sector builders ---------------- */
 
 static void build_boot_sector(uint8_t *sec)
 {
@@ -96,66 +488,212 @@ static void build_boot_sector(uint8_t *sec)
     le16(&sec[14], BPB_RSVD_SEC_CNT);                             /* RsvdSecCnt */
     sec[16] = (uint8_t)BPB_NUM_FATS;                              /* NumFATs */
     le16(&sec[17], BPB_ROOT_ENT_CNT);                             /* RootEntCnt */
-    le16(&sec[19], (uint16_t)VOL_SECTORS);                        /* TotSec16 */
+    le16(&sec[19], 0);                                            /* TotSec16: use TotSec32 */
     sec[21] = 0xF8;                                               /* Media */
     le16(&sec[22], BPB_FATSZ16);                                  /* FATSz16 */
 
     le16(&sec[24], 63);                                           /* SecPerTrk */
     le16(&sec[26], 255);                                          /* NumHeads */
     le32(&sec[28], 0);                                            /* HiddSec */
-    le32(&sec[32], 0);                                            /* TotSec32 */
+    le32(&sec[32], VOL_SECTORS);                                  /* TotSec32 */
 
     sec[36] = 0x80;                                               /* DrvNum */
     sec[38] = 0x29;                                               /* BootSig */
     le32(&sec[39], 0x20251217u);                                  /* VolID (change if needed) */
     memcpy(&sec[43], "FM33FLASH   ", 11);                         /* VolLab */
-    memcpy(&sec[54], "FAT12   ", 8);                              /* FilSysType */
+    memcpy(&sec[54], "FAT16   ", 8);                              /* FilSysType */
 
     sec[510] = 0x55; sec[511] = 0xAA;
 }
 
-static void build_fat_sector(uint8_t *sec)
+static void build_fat_sector(uint32_t fat_sec, uint8_t *sec)
 {
+    uint32_t c0 = fat_sec * (SECTOR_SIZE / 2u);
+    uint32_t c1 = c0 + (SECTOR_SIZE / 2u);
+    vfs_iter_t it;
+    vfs_obj_t o;
+
     memset(sec, 0, SECTOR_SIZE);
 
-    /* FAT12: cluster0/1 reserved */
-    sec[0] = 0xF8;
-    sec[1] = 0xFF;
-    sec[2] = 0xFF;
+    if (fat_sec == 0u) {
+        le16(&sec[0], 0xFFF8);   /* cluster 0: media */
+        le16(&sec[2], 0xFFFF);   /* cluster 1: reserved */
+    }
 
-    /* Mark cluster #2 as EOC (0xFFF).
-       FAT12 offset = (clus * 3) / 2 = 3 for clus=2 (even). */
-    sec[3] = 0xFF;        /* low 8 bits */
-    sec[4] = 0x0F;        /* high 4 bits = 0xF, upper nibble belongs to cluster3 low nibble (keep 0) */
-    sec[5] = 0x00;
+    if (c0 >= g_end_clus) return;   /* free space: all zero */
+
+    /* Contiguous chains: each cluster points to the next, last one is EOC */
+    vfs_begin(&it);
+    while (vfs_next(&it, &o)) {
+        uint32_t last = (uint32_t)o.clus + o.nclus - 1u;
+        if (last < c0) continue;
+        if (o.clus >= c1) break;
+        for (uint32_t c = (o.clus > c0) ? o.clus : c0; c <= last && c < c1; c++) {
+            le16(&sec[(c - c0) * 2u], (c == last) ? 0xFFFF : (uint16_t)(c + 1u));
+        }
+    }
 }
 
-static void build_root_dir_sector(uint8_t *sec)
+static void dir_entry(uint8_t *e, const char n83[11], uint8_t attr, uint16_t clus, uint32_t size, uint16_t date)
 {
-    memset(sec, 0, SECTOR_SIZE);
+    memcpy(&e[0], n83, 11);
+    e[11] = attr;
+    le16(&e[16], date);                   /* CrtDate */
+    le16(&e[18], date);                   /* LstAccDate */
+    le16(&e[24], date);                   /* WrtDate */
+    le16(&e[26], clus);                   /* First cluster */
+    le32(&e[28], size);                   /* File size */
+}
+
+static void obj_dir_entry(uint8_t *e, const vfs_obj_t *o)
+{
+    char n83[11];
+    unsigned int y;
+    unsigned char m, d;
+    uint16_t date = LogIndex_Days() ? fat_date(LogIndex_Day(LogIndex_Days() - 1u)->day) : fat_date(0u);
+    char name[13];
 
-    /* Entry 0: Volume label */
-    memcpy(&sec[0], "FM33FLASH   ", 11);
-    sec[11] = 0x08;
+    switch (o->kind) {
+    case VFS_LOG:
+        make_83_name((g_file_name[0] != '\0') ? g_file_name : FILE_NAME, n83);
+        break;
+    case VFS_CONFIG:
+        make_83_name("CONFIG.TXT", n83);
+        dir_entry(e, n83, 0x20, o->clus, o->size, date);   /* ATTR_ARCHIVE: writable */
+        return;
+    case VFS_STATUS:
+        make_83_name("STATUS.TXT", n83);
+        break;
+    case VFS_SUMMARY:
+        make_83_name("SUMMARY.CSV", n83);
+        break;
+    case VFS_PROFILE:
+        make_83_name("PROFILE.CSV", n83);
+        break;
+    case VFS_MONTH:
+        RTC_DaysToDate(LogIndex_Day(o->day)->day, &y, &m, &d);
+        (void)sprintf(name, "20%02u-%02u", y, m);
+        make_83_name(name, n83);
+        date = fat_date(LogIndex_Day(o->day)->day);
+        dir_entry(e, n83, 0x10, o->clus, 0u, date);   /* ATTR_DIRECTORY */
+        return;
+    default:
+        RTC_DaysToDate(LogIndex_Day(o->day)->day, &y, &m, &d);
+        (void)sprintf(name, "20%02u%02u%02u.CSV", y, m, d);
+        make_83_name(name, n83);
+        date = fat_date(LogIndex_Day(o->day)->day);
+        break;
+    }
+    dir_entry(e, n83, 0x21, o->clus, o->size, date);   /* ATTR_READ_ONLY | ATTR_ARCHIVE */
+}
 
-    /* Entry 1: file */
+/*
+ * One directory sector. month < 0: root (volume label + top-level objects);
+ * otherwise the subdirectory that starts at day index `month`.
+ */
+static void build_dir_sector(int16_t month, uint16_t dir_clus, uint32_t first_entry, uint8_t *sec)
+{
     char n83[11];
-    const char *name_src = (g_file_name[0] != '\0') ? g_file_name : FILE_NAME;
-    make_83_name(name_src, n83);
-    memcpy(&sec[32], n83, 11);
-    sec[32 + 11] = 0x20; /* ATTR_ARCHIVE */
+    uint32_t n = 0u;
+    uint16_t key = 0u;
+    vfs_iter_t it;
+    vfs_obj_t o;
+
+    memset(sec, 0, SECTOR_SIZE);
+
+#define DIR_SLOT(n) (((n) >= first_entry && (n) < first_entry + SECTOR_SIZE / 32u) ? &sec[((n) - first_entry) * 32u] : NULL)
 
-    le16(&sec[32 + 26], 2);               /* First cluster */
-    le32(&sec[32 + 28], g_file_len);      /* File size */
+    if (month < 0) {
+        uint8_t *e = DIR_SLOT(n);
+        if (e) {
+            memcpy(&e[0], "FM33FLASH   ", 11);   /* Volume label */
+            e[11] = 0x08;
+        }
+        n++;
+    } else {
+        uint8_t *e;
+        key = month_key(LogIndex_Day((uint16_t)month)->day);
+        memset(n83, ' ', 11);
+        n83[0] = '.';
+        if ((e = DIR_SLOT(n)) != NULL) dir_entry(e, n83, 0x10, dir_clus, 0u, fat_date(LogIndex_Day((uint16_t)month)->day));
+        n++;
+        n83[1] = '.';
+        if ((e = DIR_SLOT(n)) != NULL) dir_entry(e, n83, 0x10, 0u, 0u, fat_date(LogIndex_Day((uint16_t)month)->day));
+        n++;
+    }
+
+    vfs_begin(&it);
+    while (vfs_next(&it, &o)) {
+        uint8_t in_dir;
+        uint8_t *e;
+
+        if (month < 0) {
+            in_dir = (o.kind != VFS_DAY) || !g_month_dirs;
+        } else {
+            in_dir = (o.kind == VFS_DAY) && (month_key(LogIndex_Day(o.day)->day) == key);
+        }
+        if (!in_dir) continue;
+
+        e = DIR_SLOT(n);
+        if (e) obj_dir_entry(e, &o);
+        n++;
+        if (n >= first_entry + SECTOR_SIZE / 32u) break;
+    }
+#undef DIR_SLOT
 }
 
-static void build_data_sector_cluster2(uint8_t *sec)
+static void build_data_sector(uint32_t lba, uint8_t *sec)
 {
+    uint16_t clus = (uint16_t)(2u + (lba - LBA_DATA) / BPB_SEC_PER_CLUS);
+    vfs_obj_t o;
+    uint32_t off;
+
     memset(sec, 0, SECTOR_SIZE);
+    if (!vfs_find_cluster(clus, &o)) return;
+
+    off = (uint32_t)(clus - o.clus) * CLUSTER_SIZE + ((lba - LBA_DATA) % BPB_SEC_PER_CLUS) * SECTOR_SIZE;
 
-    if (g_file_len > 0u) {
-        uint32_t n = (g_file_len > SECTOR_SIZE) ? SECTOR_SIZE : g_file_len;
-        memcpy(sec, g_file_buf, n);
+    switch (o.kind) {
+    case VFS_LOG:
+        if (off < g_file_len) {
+            uint32_t n = g_file_len - off;
+            memcpy(sec, &g_file_buf[off], (n > SECTOR_SIZE) ? SECTOR_SIZE : n);
+        }
+        break;
+
+    case VFS_CONFIG:
+        if (off == 0u) {
+            int n = Config_Format((char*)sec, SECTOR_SIZE);
+            if (n > (int)g_config_len) n = g_config_len;
+            if (n >= 0 && n < (int)SECTOR_SIZE) memset(&sec[n], 0, SECTOR_SIZE - (uint32_t)n);
+        }
+        break;
+
+    case VFS_STATUS:
+        if (off == 0u) {
+            int n = render_status((char*)sec, SECTOR_SIZE);
+            /* Never exceed the size announced in the directory */
+            if (n > (int)g_status_len) n = g_status_len;
+            if (n >= 0 && n < (int)SECTOR_SIZE) memset(&sec[n], 0, SECTOR_SIZE - (uint32_t)n);
+        }
+        break;
+
+    case VFS_SUMMARY:
+        render_lines(sec, off, SUM_HDR, SUM_HDR_LEN, SUM_LINE_LEN, LogIndex_Days(), 0u, summary_line_fn);
+        break;
+
+    case VFS_PROFILE:
+        render_lines(sec, off, PROF_HDR, PROF_HDR_LEN, PROF_LINE_LEN, PROFILE_PHASES, 0u, profile_line_fn);
+        break;
+
+    case VFS_MONTH:
+        build_dir_sector((int16_t)o.day, o.clus, off / 32u, sec);
+        break;
+
+    default:
+        render_lines(sec, off, g_day_hdr, g_day_hdr_len, DAY_LINE_LEN(g_day_cols),
+            LogIndex_Day(o.day)->count, LogIndex_Day(o.day)->first_seq, day_line_fn);
+        break;
     }
 }
 
@@ -163,22 +701,177 @@ static void build_sector(uint32_t lba, uint8_t *sec)
 {
     if (lba == LBA_BOOT) {
         build_boot_sector(sec);
-    } else if (lba == LBA_FAT1 || lba == LBA_FAT2) {
-        build_fat_sector(sec);
-    } else if (lba == LBA_ROOT) {
-        build_root_dir_sector(sec);
-    } else if (lba == CLUSTER2_LBA) {
-        build_data_sector_cluster2(sec);
+    } else if (lba >= LBA_FAT1 && lba < LBA_ROOT) {
+        build_fat_sector((lba - LBA_FAT1) % BPB_FATSZ16, sec);
+    } else if (lba >= LBA_ROOT && lba < LBA_DATA) {
+        build_dir_sector(-1, 0u, (lba - LBA_ROOT) * (SECTOR_SIZE / 32u), sec);
+    } else if (lba < VOL_SECTORS) {
+        build_data_sector(lba, sec);
     } else {
         memset(sec, 0, SECTOR_SIZE);
     }
 }
 
+/* Day CSV columns and header for the channels in the log */
+static void vfs_day_columns(void)
+{
+    uint8_t chans = LogIndex_Channels();
+    int n;
+
+    g_day_cols = 1u;
+    while (g_day_cols < LOG_CHANNELS && (chans >> g_day_cols) != 0u) g_day_cols++;
+
+    if (g_day_cols == 1u) {
+        n = sprintf(g_day_hdr, "%s", DAY_HDR);
+    } else {
+        n = sprintf(g_day_hdr, "time");
+        for (uint8_t c = 0u; c < g_day_cols; c++) {
+            n += sprintf(&g_day_hdr[n], ",temp%u_C", c);
+        }
+        n += sprintf(&g_day_hdr[n], "\r\n");
+    }
+    g_day_hdr_len = (uint8_t)n;
+}
+
+/* Recompute the layout inputs after the log or the 5-line file changed */
+static void vfs_layout(void)
+{
+    vfs_iter_t it;
+    vfs_obj_t o;
+
+    (void)LogIndex_Update();
+    g_month_dirs = (LogIndex_Days() > VFS_FLAT_MAX_DAYS) ? 1u : 0u;
+    vfs_day_columns();
+    g_status_len = (uint16_t)render_status(NULL, 0u);
+    assert_param(g_status_len <= STATUS_LEN_MAX);   /* a new line or wider field: see STATUS_LEN_MAX */
+    g_config_len = (uint16_t)Config_Format(NULL, 0u);
+
+    vfs_begin(&it);
+    while (vfs_next(&it, &o)) {
+        if (o.kind == VFS_CONFIG) g_config_clus = o.clus;
+    }
+    g_end_clus = it.clus;
+}
+
+/* ---------------- Host writes (CONFIG.TXT) ---------------- */
+
+/*
+ * Writes to the root directory and to the first sector of each data cluster
+ * are kept in a small write-back cache and served back on reads, so the
+ * host sees its own writes; everything else (FAT updates, other sectors of
+ * larger files) is accepted and dropped. Once the host has been quiet for
+ * WB_SETTLE_MS, MSC_Poll() finds CONFIG.TXT in the cached root directory,
+ * hands its first sector to Config_ApplyText() and drops the cache: the
+ * volume snaps back to the generated image and the host is told the
+ * medium changed. The root sector holding the CONFIG.TXT entry and the
+ * sector it points at are never evicted; other data sectors go first.
+ * If the host moved or resized CONFIG.TXT but its sector has not come
+ * yet, the cache stays pending for up to WB_MISSING_MS.
+ */
+#define WB_SLOTS                4u
+#define WB_SETTLE_MS            1000u
+#define WB_MISSING_MS           10000u
+
+typedef struct {
+    uint32_t lba;
+    uint32_t age;       /* larger = written more recently */
+    uint8_t  used;
+    uint8_t  data[SECTOR_SIZE];
+} wb_slot_t;
+
+static wb_slot_t *g_wb;        /* WB_SLOTS, arena */
+static uint32_t  g_wb_age;
+static uint32_t  g_wb_last_ms;
+static uint8_t   g_wb_pending;
+
+ARENA_CHECK(msc_image, ARENA_ROUND(MSC_FILE_BUF_SIZE) + ARENA_ROUND(WB_SLOTS * sizeof(wb_slot_t)) <= ARENA_USB_IMAGE_BYTES);
+
+static wb_slot_t *wb_find(uint32_t lba)
+{
+    for (uint8_t i = 0u; i < WB_SLOTS; i++) {
+        if (g_wb[i].used && g_wb[i].lba == lba) return &g_wb[i];
+    }
+    return NULL;
+}
+
+static uint8_t wb_wanted(uint32_t lba)
+{
+    if (lba >= LBA_ROOT && lba < LBA_DATA) return 1;
+    return (lba >= LBA_DATA && lba < VOL_SECTORS && ((lba - LBA_DATA) % BPB_SEC_PER_CLUS) == 0u);
+}
+
+/* CONFIG.TXT as the host left it: entry from a cached root sector (returned), else ours (NULL) */
+static const wb_slot_t *wb_config_entry(uint16_t *clus, uint32_t *size)
+{
+    *clus = g_config_clus;
+    *size = SECTOR_SIZE;
+
+    for (uint8_t i = 0u; i < WB_SLOTS; i++) {
+        if (!g_wb[i].used || g_wb[i].lba < LBA_ROOT || g_wb[i].lba >= LBA_DATA) continue;
+
+        for (uint32_t off = 0u; off < SECTOR_SIZE; off += 32u) {
+            const uint8_t *e = &g_wb[i].data[off];
+            if (e[0] == 0x00u || e[0] == 0xE5u || (e[11] & 0x18u) != 0u) continue;   /* free, deleted, dir, label, LFN */
+            if (memcmp(e, "CONFIG  TXT", 11) != 0) continue;
+            *clus = (uint16_t)(e[26] | (e[27] << 8));
+            *size = (uint32_t)e[28] | ((uint32_t)e[29] << 8) | ((uint32_t)e[30] << 16) | ((uint32_t)e[31] << 24);
+            return &g_wb[i];
+        }
+    }
+    return NULL;
+}
+
+/* First sector of a data cluster, 0 if clus is not one */
+static uint32_t wb_clus_lba(uint16_t clus)
+{
+    if (clus < 2u || clus >= DATA_CLUSTERS + 2u) return 0u;
+    return LBA_DATA + (uint32_t)(clus - 2u) * BPB_SEC_PER_CLUS;
+}
+
+/*
+ * Same LBA again, else a free slot, else the oldest data sector, else the
+ * oldest root sector; never the CONFIG.TXT entry or its sector.
+ */
+static void wb_store(uint32_t lba, const uint8_t *data)
+{
+    wb_slot_t *s = wb_find(lba);
+
+    if (s == NULL) {
+        uint16_t clus;
+        uint32_t size;
+        const wb_slot_t *keep = wb_config_entry(&clus, &size);
+        uint32_t keep_lba = wb_clus_lba(clus);
+        uint8_t best = 0u;
+
+        for (uint8_t i = 0u; i < WB_SLOTS; i++) {
+            uint8_t rank;
+
+            if (!g_wb[i].used) { s = &g_wb[i]; break; }
+            if (&g_wb[i] == keep || g_wb[i].lba == keep_lba) continue;
+            rank = (g_wb[i].lba >= LBA_DATA) ? 0u : 1u;
+            if (s == NULL || rank < best || (rank == best && g_wb[i].age < s->age)) {
+                s = &g_wb[i];
+                best = rank;
+            }
+        }
+    }
+    s->lba  = lba;
+    s->age  = ++g_wb_age;
+    s->used = 1u;
+    memcpy(s->data, data, SECTOR_SIZE);
+}
+
+static void wb_drop(void)
+{
+    for (uint8_t i = 0u; i < WB_SLOTS; i++) g_wb[i].used = 0u;
+    g_wb_pending = 0u;
+}
+
 /* ---------------- External flash helpers (ONLY in MSC_PrepareImage) ---------------- */
 
 static void set_default_file_to_ram(void)
 {
-    memset(g_file_buf, 0, sizeof(g_file_buf));
+    memset(g_file_buf, 0, MSC_FILE_BUF_SIZE);
     memcpy(g_file_buf, MSC_FILE_CONTENT, sizeof(MSC_FILE_CONTENT) - 1u);
     g_file_len = (uint32_t)(sizeof(MSC_FILE_CONTENT) - 1u);
 
@@ -203,7 +896,7 @@ static void load_file_from_flash_to_ram(void)
     uint32_t id = Flash_ReadID();   // <-- ?????? ??????
 
     if (id == 0x000000u || id == 0xFFFFFFu) {
-        memset(g_file_buf, 0, sizeof(g_file_buf));
+        memset(g_file_buf, 0, MSC_FILE_BUF_SIZE);
         g_file_len = (uint32_t)sprintf((char*)g_file_buf, "SPI NO RESP, JEDEC=0x%06lX\r\n", id);
 
         memset(g_file_name, 0, sizeof(g_file_name));
@@ -213,7 +906,7 @@ static void load_file_from_flash_to_ram(void)
 
     // ?????? ???????? -> ??????? ID, ???? CheckID ?? ??????????
     if (!Flash_CheckID()) {
-        memset(g_file_buf, 0, sizeof(g_file_buf));
+        memset(g_file_buf, 0, MSC_FILE_BUF_SIZE);
         g_file_len = (uint32_t)sprintf((char*)g_file_buf, "JEDEC=0x%06lX (update Flash_CheckID)\r\n", id);
 
         memset(g_file_name, 0, sizeof(g_file_name));
@@ -221,11 +914,13 @@ static void load_file_from_flash_to_ram(void)
         return;
     }//end
 		
-    FileEntry fe;
+    uint32_t mark = Arena_Mark();
+    FileEntry *fe = (FileEntry*)Arena_Alloc(sizeof(FileEntry));
+    if (!fe) return;   /* the default file stays */
 
     // 1) ???????? flash
     /*if (!Flash_CheckID()) {
-        memset(g_file_buf, 0, sizeof(g_file_buf));
+        memset(g_file_buf, 0, MSC_FILE_BUF_SIZE);
         memcpy(g_file_buf, "ERR: Flash_CheckID failed", 25);
         g_file_len = 25;
         memset(g_file_name, 0, sizeof(g_file_name));
@@ -234,25 +929,27 @@ static void load_file_from_flash_to_ram(void)
     }*/
 
     // 2) ?????? ????????? ?????
-    Flash_ReadData(FILE_ADDRESS, (uint8_t*)&fe, (uint32_t)sizeof(fe));
+    Flash_ReadData(FILE_ADDRESS, (uint8_t*)fe, (uint32_t)sizeof(*fe));
 
-    if (!fileentry_valid(&fe)) {
-        memset(g_file_buf, 0, sizeof(g_file_buf));
+    if (!fileentry_valid(fe)) {
+        memset(g_file_buf, 0, MSC_FILE_BUF_SIZE);
         memcpy(g_file_buf, "ERR: Bad FileEntry", 18);
         g_file_len = 18;
         memset(g_file_name, 0, sizeof(g_file_name));
         strncpy(g_file_name, "BADFILE.TXT", sizeof(g_file_name) - 1);
+        Arena_Release(mark);
         return;
     }
 
     // 3) ??????????? ? RAM
-    uint32_t n = fe.size;
-    if (n > sizeof(g_file_buf)) n = sizeof(g_file_buf);
-    memcpy(g_file_buf, fe.data, n);
+    uint32_t n = fe->size;
+    if (n > MSC_FILE_BUF_SIZE) n = MSC_FILE_BUF_SIZE;
+    memcpy(g_file_buf, fe->data, n);
     g_file_len = n;
 
     memset(g_file_name, 0, sizeof(g_file_name));
-    strncpy(g_file_name, fe.filename, sizeof(g_file_name) - 1);
+    strncpy(g_file_name, fe->filename, sizeof(g_file_name) - 1);
+    Arena_Release(mark);
 }
 
 /* ---------------- USBD STORAGE callbacks ---------------- */
@@ -264,6 +961,7 @@ static int8_t STORAGE_IsWriteProtected(uint8_t lun);
 static int8_t STORAGE_Read(uint8_t lun, uint8_t *buf, uint32_t blk_addr, uint16_t blk_len);
 static int8_t STORAGE_Write(uint8_t lun, uint8_t *buf, uint32_t blk_addr, uint16_t blk_len);
 static int8_t STORAGE_GetMaxLun(void);
+static int8_t STORAGE_IsMediaChanged(uint8_t lun);
 
 static USBD_STORAGE_cb_TypeDef USBD_SPI_FLASH_fops = {
     STORAGE_Init,
@@ -273,6 +971,7 @@ static USBD_STORAGE_cb_TypeDef USBD_SPI_FLASH_fops = {
     STORAGE_Read,
     STORAGE_Write,
     STORAGE_GetMaxLun,
+    STORAGE_IsMediaChanged,
     (int8_t*)STORAGE_Inquirydata
 };
 
@@ -288,58 +987,202 @@ static int8_t STORAGE_Init(uint8_t lun)
 
 static int8_t STORAGE_GetCapacity(uint8_t lun, uint32_t *block_num, uint32_t *block_size)
 {
-    (void)lun;
     if (!block_num || !block_size) return -1;
 
     *block_size = SECTOR_SIZE;
-    *block_num  = VOL_SECTORS;
+    *block_num  = (lun == LUN_RAW_FLASH) ? RAW_SECTORS : VOL_SECTORS;
     return 0;
 }
 
 static int8_t STORAGE_IsReady(uint8_t lun)
 {
-    (void)lun;
-    return g_storage_ready ? 0 : -1;
+    if (lun == LUN_RAW_FLASH && !g_raw_lun_on) return -1;
+    return (g_storage_ready && g_prepared) ? 0 : -1;
 }
 
 static int8_t STORAGE_IsWriteProtected(uint8_t lun)
 {
-    (void)lun;
-    return 1; /* READ ONLY: Windows won't try to create system files */
+    /* Raw flash stays read-only; LUN 0 takes writes for CONFIG.TXT */
+    return (lun == LUN_RAW_FLASH) ? 1 : 0;
 }
 
 static int8_t STORAGE_Read(uint8_t lun, uint8_t *buf, uint32_t blk_addr, uint16_t blk_len)
 {
-    (void)lun;
-    if (!g_storage_ready || (buf == NULL)) return -1;
+    if (!g_storage_ready || !g_prepared || (buf == NULL)) return -1;
+
+    if (lun == LUN_RAW_FLASH) {
+        if ((blk_addr + blk_len) > RAW_SECTORS) return -1;
+        /* One READ DATA command streams the whole request */
+        Flash_ReadData(blk_addr * SECTOR_SIZE, buf, (uint32_t)blk_len * SECTOR_SIZE);
+        return 0;
+    }
+
     if ((blk_addr + blk_len) > VOL_SECTORS) return -1;
 
+    USB_EnumStats_Mark(USB_ENUM_EVT_MOUNT);
+
     for (uint16_t i = 0; i < blk_len; i++) {
-        build_sector(blk_addr + i, buf + ((uint32_t)i * SECTOR_SIZE));
+        const wb_slot_t *s = g_wb_pending ? wb_find(blk_addr + i) : NULL;
+        if (s) {
+            memcpy(buf + ((uint32_t)i * SECTOR_SIZE), s->data, SECTOR_SIZE);
+        } else {
+            build_sector(blk_addr + i, buf + ((uint32_t)i * SECTOR_SIZE));
+        }
     }
     return 0;
 }
 
 static int8_t STORAGE_Write(uint8_t lun, uint8_t *buf, uint32_t blk_addr, uint16_t blk_len)
 {
-    (void)lun; (void)buf; (void)blk_addr; (void)blk_len;
-    return -1; /* should not be called when write-protected */
+    if (!g_storage_ready || !g_prepared || (buf == NULL)) return -1;
+    if (lun == LUN_RAW_FLASH || (blk_addr + blk_len) > VOL_SECTORS) return -1;
+
+    for (uint16_t i = 0; i < blk_len; i++) {
+        if (wb_wanted(blk_addr + i)) {
+            wb_store(blk_addr + i, buf + ((uint32_t)i * SECTOR_SIZE));
+        }
+    }
+    g_wb_pending = 1u;
+    g_wb_last_ms = usb_ms_ticks;
+    return 0;
 }
 
 static int8_t STORAGE_GetMaxLun(void)
 {
-    return (STORAGE_LUN_NBR - 1);
+    return g_raw_lun_on ? (STORAGE_LUN_NBR - 1) : 0;
+}
+
+static int8_t STORAGE_IsMediaChanged(uint8_t lun)
+{
+    if (lun >= STORAGE_LUN_NBR || !g_media_changed[lun]) return 0;
+    g_media_changed[lun] = 0u;
+    return 1;
+}
+
+static void set_media_changed(uint8_t v)
+{
+    for (uint8_t i = 0u; i < STORAGE_LUN_NBR; i++) g_media_changed[i] = v;
 }
 
-/* Call this from main() BEFORE USBInit() */
+/* Call before USBInit(): expose the raw flash LUN for this session */
+void MSC_EnableRawLun(uint8_t on)
+{
+    g_raw_lun_on = (MSC_RAW_FLASH_LUN && on) ? 1u : 0u;
+}
+
+/* Call this from main() BEFORE USBInit(), in ARENA_MODE_USB: drops the image
+ * of the last session and takes the buffers for this one */
+void MSC_InvalidateImage(void)
+{
+    g_prepared = 0u;
+    g_indexing = 0u;
+    g_file_buf = (uint8_t*)Arena_Alloc(MSC_FILE_BUF_SIZE);
+    g_wb = (wb_slot_t*)Arena_Alloc(WB_SLOTS * sizeof(wb_slot_t));
+    g_wb_pending = 0u;
+}
+
+/* Records indexed per pass while the unit is NOT READY, ~8 ms of SPI:
+ * the SCSI work deferred to the main loop keeps running in between */
+#define MSC_INDEX_RUN           256u
+
+/* One bounded catch-up step; the unit turns ready once it is done.
+ * changed: the host saw NOT READY, report the medium change too. */
+static void msc_index_step(uint8_t changed)
+{
+    if (!LogIndex_UpdateSome(MSC_INDEX_RUN)) return;
+    g_indexing = 0u;
+    vfs_layout();
+    set_media_changed(changed);
+    g_prepared = 1u;
+}
+
+/* Call this from main() right AFTER USBInit() */
 void MSC_PrepareImage(void)
 {
     /*
      * IMPORTANT:
      * Do NOT cache forever.
-     * We must reload the file from SPI flash each time BEFORE USBInit(),
+     * We must reload the file from SPI flash on every insertion,
      * otherwise the host will always see the first cached content.
      */
     load_file_from_flash_to_ram();
-    g_prepared = 1u;
+    Config_Mount();
+    wb_drop();
+    g_indexing = 1u;
+    msc_index_step(0u);   /* caught up already unless the index is new */
+}
+
+/*
+ * Call from main() after a new sample was written to flash while attached.
+ * Reloads the 5-line file and catches the day index up with the record log;
+ * every sector is rebuilt from those on the next read. Runs in the main loop
+ * like the SCSI handlers, so no sector is ever built from half-updated state.
+ * The next TEST UNIT READY then reports UNIT ATTENTION / MEDIUM MAY HAVE
+ * CHANGED and the host drops its cache.
+ */
+void MSC_RefreshImage(void)
+{
+    uint32_t mark = Arena_Mark();
+    FileEntry *fe;
+
+    if (!g_prepared || g_wb_pending) return;   /* MSC_Poll() refreshes after the host's writes */
+
+    fe = (FileEntry*)Arena_Alloc(sizeof(FileEntry));
+    if (fe) {
+        Flash_ReadData(FILE_ADDRESS, (uint8_t*)fe, (uint32_t)sizeof(*fe));
+    }
+    if (fe && fileentry_valid(fe)) {
+        uint32_t n = fe->size;
+        if (n > MSC_FILE_BUF_SIZE) n = MSC_FILE_BUF_SIZE;
+
+        memset(g_file_buf, 0, MSC_FILE_BUF_SIZE);
+        memcpy(g_file_buf, fe->data, n);
+        g_file_len = n;
+        memset(g_file_name, 0, sizeof(g_file_name));
+        strncpy(g_file_name, fe->filename, sizeof(g_file_name) - 1);
+    }
+    Arena_Release(mark);
+
+    vfs_layout();
+    set_media_changed(1u);   /* raw flash LUN changed too */
+}
+
+/*
+ * Call from the main loop after USB_Process(). Indexes the next run of the
+ * record log until the unit is ready; then, once the host's writes have
+ * settled, applies CONFIG.TXT and drops everything else the host wrote.
+ */
+void MSC_Poll(void)
+{
+    const wb_slot_t *s = NULL;
+    const wb_slot_t *entry;
+    uint16_t clus;
+    uint32_t size, lba;
+
+    if (g_indexing) {
+        msc_index_step(1u);
+        return;
+    }
+    if (!g_wb_pending || (usb_ms_ticks - g_wb_last_ms) < WB_SETTLE_MS) return;
+
+    entry = wb_config_entry(&clus, &size);
+    lba = wb_clus_lba(clus);
+    if (lba != 0u) s = wb_find(lba);
+    if (s != NULL) {
+        (void)Config_ApplyText((const char*)s->data, (size > SECTOR_SIZE) ? SECTOR_SIZE : size);
+    } else if (entry != NULL && (clus != g_config_clus || size != g_config_len) &&
+               (usb_ms_ticks - g_wb_last_ms) < WB_MISSING_MS) {
+        return;   /* the new CONFIG.TXT sector is still to come: keep what the host wrote */
+    }
+
+    wb_drop();
+    MSC_RefreshImage();
+}
+
+/* Skip the settle time: CONFIG.TXT is applied from what the host wrote so far */
+void MSC_Flush(void)
+{
+    if (!g_wb_pending) return;
+    g_wb_last_ms = usb_ms_ticks - WB_SETTLE_MS;
+    MSC_Poll();
 }
@@ -4,6 +4,8 @@
 #include "msc_scsi.h"
 #include "msc_mem.h"
 #include "msc_data.h"
+#include "log_store.h"
+#include <string.h>
 
 SCSI_Sense_TypeDef SCSI_Sense [SENSE_LIST_DEEPTH];
 uint8_t SCSI_Sense_Head;
@@ -13,6 +15,12 @@ uint32_t SCSI_blk_nbr;
 uint32_t SCSI_blk_addr;
 uint32_t SCSI_blk_len;
 
+/* Vendor log export cursor (one command at a time, like SCSI_blk_xxx) */
+static uint32_t SCSI_log_seq;
+static uint32_t SCSI_log_end;
+static uint32_t SCSI_log_tend;
+static uint8_t  SCSI_log_done;
+
 USB_OTG_CORE_HANDLE  *cdev;
 
 static int8_t SCSI_TestUnitReady(uint8_t lun, uint8_t *params);
@@ -29,6 +37,9 @@ static int8_t SCSI_Verify10(uint8_t lun, uint8_t *params);
 static int8_t SCSI_CheckAddressRange(uint8_t lun, uint32_t blk_offset, uint16_t blk_nbr);
 static int8_t SCSI_ProcessRead(uint8_t lun);
 static int8_t SCSI_ProcessWrite(uint8_t lun);
+static int8_t SCSI_VendorLogInfo(uint8_t lun, uint8_t *params);
+static int8_t SCSI_VendorLogRead(uint8_t lun, uint8_t *params);
+static int8_t SCSI_VendorTimeSet(uint8_t lun, uint8_t *params);
 
 /**
 * @brief  SCSI_ProcessCmd
@@ -80,6 +91,15 @@ int8_t SCSI_ProcessCmd(void *pdev, uint8_t lun, uint8_t *params)
     case SCSI_VERIFY10:
         return SCSI_Verify10(lun, params);
 
+    case SCSI_VENDOR_LOG_INFO:
+        return SCSI_VendorLogInfo(lun, params);
+
+    case SCSI_VENDOR_LOG_READ:
+        return SCSI_VendorLogRead(lun, params);
+
+    case SCSI_VENDOR_TIME_SET:
+        return SCSI_VendorTimeSet(lun, params);
+
     default:
         SCSI_SenseCode(lun, ILLEGAL_REQUEST, INVALID_CDB);
         return -1;
@@ -108,6 +128,13 @@ static int8_t SCSI_TestUnitReady(uint8_t lun, uint8_t *params)
         SCSI_SenseCode(lun, NOT_READY, MEDIUM_NOT_PRESENT);
         return -1;
     }
+
+    /* Image was regenerated: make the host re-read the directory */
+    if (USBD_STORAGE_fops->IsMediaChanged(lun) != 0)
+    {
+        SCSI_SenseCode(lun, UNIT_ATTENTION, MEDIUM_HAVE_CHANGED);
+        return -1;
+    }
     
     MSC_BOT_DataLen = 0;
     return 0;
@@ -239,6 +266,12 @@ static int8_t SCSI_ModeSense6(uint8_t lun, uint8_t *params)
         len--;
         MSC_BOT_Data[len] = MSC_Mode_Sense6_data[len];
     }
+
+    /* Device-specific parameter: WP, so hosts mount read-only LUNs read-only */
+    if (USBD_STORAGE_fops->IsWriteProtected(lun) != 0)
+    {
+        MSC_BOT_Data[2] |= 0x80;
+    }
     return 0;
 }
 
@@ -259,6 +292,11 @@ static int8_t SCSI_ModeSense10(uint8_t lun, uint8_t *params)
         len--;
         MSC_BOT_Data[len] = MSC_Mode_Sense10_data[len];
     }
+
+    if (USBD_STORAGE_fops->IsWriteProtected(lun) != 0)
+    {
+        MSC_BOT_Data[3] |= 0x80;
+    }
     return 0;
 }
 
@@ -484,6 +522,13 @@ static int8_t SCSI_Verify10(uint8_t lun , uint8_t *params)
 */
 static int8_t SCSI_CheckAddressRange(uint8_t lun, uint32_t blk_offset, uint16_t blk_nbr)
 {
+    /* LUNs differ in size: do not rely on the last READ CAPACITY */
+    if (USBD_STORAGE_fops->GetCapacity(lun, &SCSI_blk_nbr, &SCSI_blk_size) != 0)
+    {
+        SCSI_SenseCode(lun, NOT_READY, MEDIUM_NOT_PRESENT);
+        return -1;
+    }
+
     if ((blk_offset + blk_nbr) > SCSI_blk_nbr )
     {
         SCSI_SenseCode(lun, ILLEGAL_REQUEST, ADDRESS_OUT_OF_RANGE);
@@ -563,3 +608,184 @@ static int8_t SCSI_ProcessWrite(uint8_t lun)
 
     return 0;
 }
+
+static void SCSI_PutLE32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)(v);
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+/**
+* @brief  SCSI_VendorLogInfo
+*         Report the stored seq range, capacity and clock of the record log
+* @param  lun: Logical unit number
+* @param  params: Command parameters
+* @retval status
+*/
+static int8_t SCSI_VendorLogInfo(uint8_t lun, uint8_t *params)
+{
+    LogRecord rec;
+    uint32_t first, next;
+    uint8_t i;
+
+    if (!LogStore_Mount())
+    {
+        SCSI_SenseCode(lun, NOT_READY, MEDIUM_NOT_PRESENT);
+        return -1;
+    }
+
+    for (i = 0; i < VENDOR_LOG_INFO_LEN; i++)
+    {
+        MSC_BOT_Data[i] = 0;
+    }
+
+    first = LogStore_FirstSeq();
+    next  = LogStore_NextSeq();
+
+    SCSI_PutLE32(&MSC_BOT_Data[0], VENDOR_LOG_MAGIC);
+    MSC_BOT_Data[4] = VENDOR_LOG_VERSION;
+    MSC_BOT_Data[5] = LOG_REC_SIZE;
+    SCSI_PutLE32(&MSC_BOT_Data[8], first);
+    SCSI_PutLE32(&MSC_BOT_Data[12], next);
+    SCSI_PutLE32(&MSC_BOT_Data[16], LOG_SLOTS);
+    SCSI_PutLE32(&MSC_BOT_Data[20], RTC_ReadEpoch2000());
+    if (first != next)
+    {
+        if (LogStore_ReadSeq(first, &rec)) SCSI_PutLE32(&MSC_BOT_Data[24], rec.time);
+        if (LogStore_ReadSeq(next - 1, &rec)) SCSI_PutLE32(&MSC_BOT_Data[28], rec.time);
+    }
+
+    MSC_BOT_DataLen = VENDOR_LOG_INFO_LEN;
+    return 0;
+}
+
+/**
+* @brief  SCSI_VendorLogRead
+*         Stream raw log records for a seq or time range. The host asks for a
+*         whole number of MSC_MEDIA_PACKET blocks; records are packed back to
+*         back and the tail is padded with erased (0xFF) records.
+* @param  lun: Logical unit number
+* @param  params: Command parameters
+* @retval status
+*/
+static int8_t SCSI_VendorLogRead(uint8_t lun, uint8_t *params)
+{
+    LogRecord rec;
+    uint32_t start, end, off;
+
+    if (MSC_BOT_State == BOT_IDLE)
+    {
+        if (((MSC_BOT_cbw.bmFlags & 0x80) != 0x80) ||
+            (MSC_BOT_cbw.dDataLength == 0) ||
+            (MSC_BOT_cbw.dDataLength % MSC_MEDIA_PACKET) != 0)
+        {
+            SCSI_SenseCode(lun, ILLEGAL_REQUEST, INVALID_FIELED_IN_COMMAND);
+            return -1;
+        }
+
+        if (!LogStore_Mount())
+        {
+            SCSI_SenseCode(lun, NOT_READY, MEDIUM_NOT_PRESENT);
+            return -1;
+        }
+
+        start = (params[2] << 24) | (params[3] << 16) | (params[4] <<  8) | params[5];
+        end   = (params[6] << 24) | (params[7] << 16) | (params[8] <<  8) | params[9];
+
+        if (params[1] == VENDOR_LOG_BY_TIME)
+        {
+            SCSI_log_seq  = LogStore_FindTime(start);
+            SCSI_log_end  = LOG_SEQ_NONE;
+            SCSI_log_tend = end;
+        }
+        else if (params[1] == VENDOR_LOG_BY_SEQ)
+        {
+            SCSI_log_seq  = (start > LogStore_FirstSeq()) ? start : LogStore_FirstSeq();
+            SCSI_log_end  = end;
+            SCSI_log_tend = 0xFFFFFFFFu;
+        }
+        else
+        {
+            SCSI_SenseCode(lun, ILLEGAL_REQUEST, INVALID_FIELED_IN_COMMAND);
+            return -1;
+        }
+
+        SCSI_log_done = 0;
+        SCSI_blk_len = MSC_BOT_cbw.dDataLength;
+        MSC_BOT_State = BOT_DATA_IN;
+    }
+
+    /* Fill one block; corrupt records are skipped, not returned */
+    off = 0;
+    while (!SCSI_log_done && off < MSC_MEDIA_PACKET &&
+           SCSI_log_seq < LogStore_NextSeq() && SCSI_log_seq <= SCSI_log_end)
+    {
+        if (LogStore_ReadSeq(SCSI_log_seq, &rec))
+        {
+            if (rec.time > SCSI_log_tend)
+            {
+                SCSI_log_done = 1;
+                break;
+            }
+            memcpy(&MSC_BOT_Data[off], &rec, LOG_REC_SIZE);
+            off += LOG_REC_SIZE;
+        }
+        SCSI_log_seq++;
+    }
+    memset(&MSC_BOT_Data[off], 0xFF, MSC_MEDIA_PACKET - off);
+
+    DCD_EP_Tx(cdev, MSC_IN_EP, MSC_BOT_Data, MSC_MEDIA_PACKET);
+
+    SCSI_blk_len -= MSC_MEDIA_PACKET;
+    MSC_BOT_csw.dDataResidue -= MSC_MEDIA_PACKET;
+
+    if (SCSI_blk_len == 0)
+    {
+        MSC_BOT_State = BOT_LAST_DATA_IN;
+    }
+    return 0;
+}
+
+/**
+* @brief  SCSI_VendorTimeSet
+*         Set the RTC to CDB[2..5] (big-endian seconds since 2000, UTC), log
+*         the correction and feed it to the drift calibration (rtc_cal.c).
+*         Returns the clock before and after and the new trim in ppb, LE32
+*         each. The host should issue it right on a second boundary.
+* @param  lun: Logical unit number
+* @param  params: Command parameters
+* @retval status
+*/
+static int8_t SCSI_VendorTimeSet(uint8_t lun, uint8_t *params)
+{
+    uint32_t t, old;
+
+    if ((MSC_BOT_cbw.bmFlags & 0x80) != 0x80)
+    {
+        SCSI_SenseCode(lun, ILLEGAL_REQUEST, INVALID_CDB);
+        return -1;
+    }
+
+    if (!LogStore_Mount())
+    {
+        SCSI_SenseCode(lun, NOT_READY, MEDIUM_NOT_PRESENT);
+        return -1;
+    }
+
+    t = (params[2] << 24) | (params[3] << 16) | (params[4] <<  8) | params[5];
+    if (!LogStore_SetClock(t, &old))
+    {
+        SCSI_SenseCode(lun, HARDWARE_ERROR, WRITE_FAULT);
+        return -1;
+    }
+
+    RtcCal_ClockSet(old, t, 1);
+
+    SCSI_PutLE32(&MSC_BOT_Data[0], old);
+    SCSI_PutLE32(&MSC_BOT_Data[4], t);
+    SCSI_PutLE32(&MSC_BOT_Data[8], (uint32_t)RtcCal_TrimPpb());
+    MSC_BOT_DataLen = VENDOR_TIME_LEN;
+    return 0;
+}
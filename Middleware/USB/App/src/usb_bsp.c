@@ -14,6 +14,34 @@
 #endif
 __ALIGN_BEGIN USB_OTG_CORE_HANDLE USB_OTG_dev __ALIGN_END;
 
+/*
+ * PHY/clock readiness: the OTG core only reports AHB master idle once the PHY
+ * 48 MHz clock is running, so poll GRSTCTL.AHBIDLE instead of a fixed delay.
+ * Bounded by USB_PHY_READY_TIMEOUT_US; on timeout the core reset in
+ * USB_OTG_CoreInit() still waits on the same bit.
+ */
+#define USB_PHY_READY_TIMEOUT_US    50000u
+#define USB_PHY_READY_POLL_US       10u
+
+/* Soft-disconnect pulse: the host only has to see D+ released for longer than
+ * TDDIS (2.5us); a few ms is enough for slow hubs without adding latency. */
+#define USB_DISCONNECT_PULSE_MS     3u
+
+static void USB_PHY_WaitReady(void)
+{
+    uint32_t waited = 0u;
+
+    while ((USB->GRSTCTL & (0x1u << 31)) == 0u)
+    {
+        if (waited >= USB_PHY_READY_TIMEOUT_US)
+        {
+            break;
+        }
+        DelayUs(USB_PHY_READY_POLL_US);
+        waited += USB_PHY_READY_POLL_US;
+    }
+}
+
 // USBʼ
 static void USB_Clock_Init(void)
 {
@@ -29,7 +57,7 @@ static void USB_Clock_Init(void)
     
     RCC->PHYBCKCR |= 0x1 << 8;  // PHY48Mʹ
     
-    DelayMs(1000);
+    USB_PHY_WaitReady();
 }
 
 // USBȥʼ
@@ -92,7 +120,7 @@ void USB_OTG_BSP_EnableInterrupt(USB_OTG_CORE_HANDLE * pdev)
 	
 	// 
 	USB_Soft_Disconnect(&USB_OTG_dev);
-	USB_OTG_BSP_mDelay(1000);
+	USB_OTG_BSP_mDelay(USB_DISCONNECT_PULSE_MS);
 	USB_Soft_Connect(&USB_OTG_dev);
 }
 
@@ -115,5 +143,6 @@ void USB_OTG_BSP_uDelay(const uint32_t usec)
 // USBmsʱ 
 void USB_OTG_BSP_mDelay(const uint32_t msec)
 {
-    USB_OTG_BSP_uDelay(msec * 1000);
+    /* Core reset and disconnect waits are minimums: late is fine */
+    DelayMs(msec, DELAY_COARSE);
 }
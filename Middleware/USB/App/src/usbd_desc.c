@@ -14,7 +14,12 @@
 #define DEVICE_UID4                 (*(uint32_t *)(0x1ffffe8c))
 
 #define USBD_VID                        0x464D
+/* Composite gets its own PID so hosts do not reuse the cached MSC-only driver binding */
+#if USBD_COMPOSITE_CDC
+#define USBD_PID                        0x0403
+#else
 #define USBD_PID                        0x0402
+#endif
 
 #define USBD_LANGID_STRING              0x409
 #define USBD_MANUFACTURER_STRING        "FMSH"
@@ -44,9 +49,15 @@ __ALIGN_BEGIN uint8_t USBD_DeviceDesc[USB_SIZ_DEVICE_DESC] __ALIGN_END = {
     USB_DEVICE_DESCRIPTOR_TYPE,   /* bDescriptorType */
     0x00,                         /* bcdUSB */
     0x02,
+#if USBD_COMPOSITE_CDC
+    0xEF,                         /* bDeviceClass: Miscellaneous (IAD) */
+    0x02,                         /* bDeviceSubClass: Common Class */
+    0x01,                         /* bDeviceProtocol: Interface Association */
+#else
     0x00,                         /* bDeviceClass */
     0x00,                         /* bDeviceSubClass */
     0x00,                         /* bDeviceProtocol */
+#endif
     USB_OTG_MAX_EP0_SIZE,         /* bMaxPacketSize */
     LOBYTE(USBD_VID),             /* idVendor */
     HIBYTE(USBD_VID),             /* idVendor */
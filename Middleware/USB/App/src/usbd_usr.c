@@ -1,4 +1,5 @@
 #include "usbd_usr.h"
+#include "usb.h"
 
 // ûص
 USBD_Usr_cb_TypeDef USR_cb = {
@@ -44,7 +45,7 @@ void USBD_USR_DeviceReset(uint8_t speed)
 */
 void USBD_USR_DeviceConfigured(void)
 {
-
+    USB_EnumStats_Mark(USB_ENUM_EVT_CONFIGURED);
 }
 
 /**
@@ -0,0 +1,46 @@
+#include "arena.h"
+#include "main.h"
+
+static uint32_t arena_mem[ARENA_SIZE / 4u];
+static uint32_t arena_top;          /* bytes in use */
+static uint8_t  arena_mode;
+static uint32_t arena_high[ARENA_MODES];
+
+void Arena_Mode(uint8_t mode)
+{
+    arena_top = 0u;
+    arena_mode = (mode < ARENA_MODES) ? mode : ARENA_MODE_BATTERY;
+}
+
+void *Arena_Alloc(uint32_t size)
+{
+    void *p;
+
+    size = ARENA_ROUND(size);
+    if (size > ARENA_SIZE - arena_top) return NULL;
+
+    p = (uint8_t*)arena_mem + arena_top;
+    arena_top += size;
+    if (arena_top > arena_high[arena_mode]) arena_high[arena_mode] = arena_top;
+    return p;
+}
+
+uint32_t Arena_Mark(void)
+{
+    return arena_top;
+}
+
+void Arena_Release(uint32_t mark)
+{
+    if (mark < arena_top) arena_top = mark;   /* an outer release may have come first */
+}
+
+uint32_t Arena_Used(void)
+{
+    return arena_top;
+}
+
+uint32_t Arena_HighWater(uint8_t mode)
+{
+    return (mode < ARENA_MODES) ? arena_high[mode] : 0u;
+}
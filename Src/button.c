@@ -0,0 +1,156 @@
+#include "button.h"
+#include "main.h"
+
+#define BTN_UP          0u      /* released, press edge armed */
+#define BTN_DOWN_DEB    1u      /* press edge seen, pin masked */
+#define BTN_DOWN        2u      /* pressed, release edge armed, long / stuck timer */
+#define BTN_UP_DEB      3u      /* release edge seen, pin masked */
+#define BTN_GAP         4u      /* after a first short press, press edge armed, double timer */
+#define BTN_HOLD        5u      /* stuck or reset while down: release edge armed, no timer */
+
+static ButtonHandler btn_handler;
+static uint8_t btn_state;
+static uint8_t btn_presses;     /* in this sequence, 1 or 2 */
+static uint8_t btn_long;        /* long already reported for this press */
+
+static void btn_report(uint8_t press)
+{
+    if (btn_handler) btn_handler(press);
+}
+
+/* Mask the pin and look again once it settled */
+static void btn_debounce(uint8_t state)
+{
+    WKUP_Button_Disable();
+    btn_state = state;
+    Sched_After(SCHED_TASK_BUTTON, BUTTON_DEBOUNCE_MS);
+}
+
+/* Wake on the next edge; one that came while the pin was masked is posted here */
+static void btn_arm(uint8_t press)
+{
+    WKUP_Button_SetEdge(press);
+    if (Button_Held() == press) (void)Sched_Post(SCHED_LEVEL_THREAD, SCHED_TASK_BUTTON, 0u);
+}
+
+static void btn_up(void)
+{
+    btn_state = BTN_UP;
+    btn_presses = 0u;
+    btn_arm(1u);
+}
+
+static void btn_down(uint32_t ms)
+{
+    btn_state = BTN_DOWN;
+    btn_arm(0u);
+    Sched_After(SCHED_TASK_BUTTON, ms);
+}
+
+static void btn_hold(void)
+{
+    Sched_Cancel(SCHED_TASK_BUTTON);
+    btn_state = BTN_HOLD;
+    btn_long = 1u;              /* its release reports nothing */
+    btn_arm(0u);
+}
+
+/* Edge events: the NMI posted one for the polarity armed */
+static void btn_edge(void)
+{
+    switch (btn_state)
+    {
+        case BTN_UP:
+        case BTN_GAP:
+            btn_debounce(BTN_DOWN_DEB);
+            break;
+
+        case BTN_DOWN:
+        case BTN_HOLD:
+            btn_debounce(BTN_UP_DEB);
+            break;
+
+        default:                /* posted before the pin was masked */
+            break;
+    }
+}
+
+static void btn_timer(void)
+{
+    switch (btn_state)
+    {
+        case BTN_DOWN_DEB:
+            if (!Button_Held()) {           /* glitch */
+                if (btn_presses != 0u) btn_report(BUTTON_SHORT);
+                btn_up();
+                break;
+            }
+            btn_presses++;
+            btn_long = 0u;
+            btn_down(BUTTON_LONG_MS);
+            break;
+
+        case BTN_DOWN:
+            if (!btn_long) {
+                btn_long = 1u;
+                btn_report(BUTTON_LONG);
+                btn_down(BUTTON_STUCK_MS - BUTTON_LONG_MS);
+                break;
+            }
+            btn_hold();
+            btn_report(BUTTON_STUCK);
+            break;
+
+        case BTN_UP_DEB:
+            if (Button_Held()) {            /* bounced: still down */
+                if (btn_long) btn_hold();
+                else btn_down(BUTTON_LONG_MS);
+                break;
+            }
+            if (btn_long) {
+                btn_up();
+            } else if (btn_presses == 1u) {
+                btn_state = BTN_GAP;
+                btn_arm(1u);
+                Sched_After(SCHED_TASK_BUTTON, BUTTON_DOUBLE_MS);
+            } else {
+                btn_up();
+                btn_report(BUTTON_DOUBLE);
+            }
+            break;
+
+        case BTN_GAP:
+            btn_up();
+            btn_report(BUTTON_SHORT);
+            break;
+
+        default:                /* cancelled meanwhile */
+            break;
+    }
+}
+
+void Button_Init(ButtonHandler handler)
+{
+    btn_handler = handler;
+    btn_long = 0u;
+    btn_up();   /* already down: posted as a press */
+}
+
+void Button_Task(uint8_t arg)
+{
+    if (arg == SCHED_ARG_TIMER) btn_timer();
+    else btn_edge();
+}
+
+void Button_Reset(void)
+{
+    Sched_Cancel(SCHED_TASK_BUTTON);
+    btn_presses = 0u;
+    if (Button_Held()) btn_hold();
+    else btn_up();
+}
+
+uint8_t Button_Held(void)
+{
+    return (uint8_t)LL_GPIO_IsInputPinSet(GPIOA, LL_GPIO_PIN_15);
+}
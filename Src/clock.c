@@ -0,0 +1,98 @@
+#include "clock.h"
+#include "main.h"
+
+#define NVR_CHECK(_N_VALUE_, _T_VALUE_)                         \
+                            ((((_N_VALUE_ >> 16) & 0xffff) ==   \
+                            ((~_N_VALUE_) & 0xffff)) ? _N_VALUE_ : _T_VALUE_)
+
+#define RCHF8M_DEF_TRIM     (0x30)      // RC8M default trim
+#define RCHF16M_DEF_TRIM    (0x2A)      // RC16M default trim
+#define RCHF24M_DEF_TRIM    (0x27)      // RC24M default trim
+
+#define RCHF8M_NVR_TRIM     (*(uint32_t *)0x1FFFFB40)	// RC8M factory trim
+#define RCHF16M_NVR_TRIM 	(*(uint32_t *)0x1FFFFB3C)	// RC16M factory trim
+#define RCHF24M_NVR_TRIM 	(*(uint32_t *)0x1FFFFB38)	// RC24M factory trim
+
+/* Level per task, see clock.h and Tools/clockmodel */
+static const uint8_t clock_policy[CLOCK_TASKS] = {
+    CLOCK_RCHF_8M,      /* CLOCK_TASK_IO */
+    CLOCK_RCHF_24M,     /* CLOCK_TASK_CPU */
+};
+
+uint8_t Clock_Level(void)
+{
+    if (LL_RCC_GetSystemClockSource() == LL_RCC_SYSTEM_CLKSOURCE_PLL) return CLOCK_PLL_64M;
+
+    switch (LL_RCC_GetRCHFFrequency())
+    {
+        case LL_RCC_RCHF_FREQUENCY_16MHZ: return CLOCK_RCHF_16M;
+        case LL_RCC_RCHF_FREQUENCY_24MHZ: return CLOCK_RCHF_24M;
+        default:                          return CLOCK_RCHF_8M;
+    }
+}
+
+uint8_t Clock_IsRchf(uint8_t level)
+{
+    return (uint8_t)(Clock_Level() == level &&
+                     LL_RCC_GetAHBPrescaler() == LL_RCC_SYSCLK_DIV_1 &&
+                     LL_RCC_GetAPB1Prescaler() == LL_RCC_APB1_DIV_1 &&
+                     LL_RCC_GetAPB2Prescaler() == LL_RCC_APB2_DIV_1 &&
+                     systemClock == LL_RCC_GetSystemClockFreq());
+}
+
+void Clock_SetRchf(uint8_t level)
+{
+    uint32_t trim;
+
+    /* The trim belongs to the frequency: load it right after FSEL */
+    switch (level)
+    {
+        case CLOCK_RCHF_16M:
+            LL_RCC_SetRCHFFrequency(LL_RCC_RCHF_FREQUENCY_16MHZ);
+            trim = NVR_CHECK(RCHF16M_NVR_TRIM, RCHF16M_DEF_TRIM) & 0x7f;
+            break;
+
+        case CLOCK_RCHF_24M:
+            LL_RCC_SetRCHFFrequency(LL_RCC_RCHF_FREQUENCY_24MHZ);
+            trim = NVR_CHECK(RCHF24M_NVR_TRIM, RCHF24M_DEF_TRIM) & 0x7f;
+            break;
+
+        default:
+            LL_RCC_SetRCHFFrequency(LL_RCC_RCHF_FREQUENCY_8MHZ);
+            trim = NVR_CHECK(RCHF8M_NVR_TRIM, RCHF8M_DEF_TRIM) & 0x7f;
+            break;
+    }
+    LL_RCC_SetRCHFTrimValue(trim);
+
+    LL_RCC_SetSystemClockSource(LL_RCC_SYSTEM_CLKSOURCE_RCHF);
+    LL_RCC_SetAHBPrescaler(LL_RCC_SYSCLK_DIV_1);
+    LL_RCC_SetAPB1Prescaler(LL_RCC_APB1_DIV_1);
+    LL_RCC_SetAPB2Prescaler(LL_RCC_APB2_DIV_1);
+
+    Clock_Retime();
+}
+
+uint8_t Clock_Request(uint8_t task)
+{
+    uint8_t prev = Clock_Level();
+
+    if (prev != CLOCK_PLL_64M && task < CLOCK_TASKS && clock_policy[task] != prev) {
+        Clock_SetRchf(clock_policy[task]);
+    }
+    return prev;
+}
+
+void Clock_Restore(uint8_t level)
+{
+    if (level == CLOCK_PLL_64M) return;   /* only USBInit() starts the PLL */
+    if (Clock_Level() != level) {
+        Clock_SetRchf(level);
+    }
+}
+
+void Clock_Retime(void)
+{
+    systemClock = LL_RCC_GetSystemClockFreq();
+    FlashSpi_Retime();
+    NST112_Retime();
+}
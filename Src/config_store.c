@@ -0,0 +1,267 @@
+#include "config_store.h"
+#include "main.h"
+
+static DevConfig cfg_cur;
+static uint8_t   cfg_mounted;
+static uint32_t  cfg_next_slot;   /* first erased slot, CONFIG_SLOTS = sector full */
+
+static void cfg_defaults(DevConfig *c)
+{
+    memset(c, 0xFF, sizeof(*c));
+    c->magic       = CONFIG_MAGIC;
+    c->interval_s  = CONFIG_INTERVAL_DEF_S;
+    c->alarm_lo_q4 = CONFIG_ALARM_OFF_LO;
+    c->alarm_hi_q4 = CONFIG_ALARM_OFF_HI;
+    c->sensor_rate = NST112_RATE_ONESHOT;
+    c->sensor_ext  = 0u;
+    c->alert_wake  = 0u;
+    c->acq_burst   = 1u;
+    c->acq_iir_shift = 0u;
+    c->crc         = Crc16_Ccitt((const uint8_t*)c, sizeof(*c) - 2u);
+}
+
+void Config_Mount(void)
+{
+    DevConfig c;
+
+    if (cfg_mounted) return;
+    cfg_defaults(&cfg_cur);
+    if (!Flash_CheckID()) return;   /* keep defaults, retry next time */
+
+    for (cfg_next_slot = 0u; cfg_next_slot < CONFIG_SLOTS; cfg_next_slot++) {
+        Flash_ReadData(CONFIG_ADDRESS + cfg_next_slot * CONFIG_SLOT_SIZE, (uint8_t*)&c, sizeof(c));
+        if (c.magic == 0xFFFFFFFFu) break;
+        if (c.magic == CONFIG_MAGIC && c.crc == Crc16_Ccitt((const uint8_t*)&c, sizeof(c) - 2u)) {
+            cfg_cur = c;
+        }
+    }
+    /* Slots written before a setting existed hold 0xFF there */
+    if (cfg_cur.sensor_rate > NST112_RATE_8HZ || cfg_cur.sensor_ext > 1u || cfg_cur.alert_wake > 1u ||
+        cfg_cur.acq_burst == 0u || cfg_cur.acq_burst > TEMP_ACQ_BURST_MAX ||
+        cfg_cur.acq_iir_shift > TEMP_ACQ_IIR_SHIFT_MAX) {
+        if (cfg_cur.sensor_rate > NST112_RATE_8HZ) cfg_cur.sensor_rate = NST112_RATE_ONESHOT;
+        if (cfg_cur.sensor_ext > 1u) cfg_cur.sensor_ext = 0u;
+        if (cfg_cur.alert_wake > 1u) cfg_cur.alert_wake = 0u;
+        if (cfg_cur.acq_burst == 0u || cfg_cur.acq_burst > TEMP_ACQ_BURST_MAX) cfg_cur.acq_burst = 1u;
+        if (cfg_cur.acq_iir_shift > TEMP_ACQ_IIR_SHIFT_MAX) cfg_cur.acq_iir_shift = 0u;
+        cfg_cur.crc = Crc16_Ccitt((const uint8_t*)&cfg_cur, sizeof(cfg_cur) - 2u);
+    }
+    cfg_mounted = 1u;
+}
+
+const DevConfig *Config_Get(void)
+{
+    if (!cfg_mounted) cfg_defaults(&cfg_cur);
+    return &cfg_cur;
+}
+
+uint8_t Config_Save(const DevConfig *cfg)
+{
+    DevConfig c = *cfg;
+
+    Config_Mount();
+    if (!cfg_mounted) return 0;
+
+    c.magic = CONFIG_MAGIC;
+    c.crc = Crc16_Ccitt((const uint8_t*)&c, sizeof(c) - 2u);
+    if (memcmp(&c, &cfg_cur, sizeof(c)) == 0) return 0;
+
+    if (cfg_next_slot >= CONFIG_SLOTS) {
+        Flash_SectorErase(CONFIG_ADDRESS);
+        cfg_next_slot = 0u;
+    }
+    Flash_PageProgram(CONFIG_ADDRESS + cfg_next_slot * CONFIG_SLOT_SIZE, (uint8_t*)&c, sizeof(c));
+    cfg_next_slot++;
+    cfg_cur = c;
+    return 1;
+}
+
+/* ---------------- CONFIG.TXT ---------------- */
+
+/* sensor_rate_Hz values, indexed by NST112_RATE_* */
+static const char *const rate_names[NST112_RATE_8HZ + 1u] = { "oneshot", "0.25", "1", "4", "8" };
+
+static void fmt_alarm(char *out, int16_t q4, int16_t off)
+{
+    int32_t a;
+
+    if (q4 == off) {
+        strcpy(out, "off");
+        return;
+    }
+    a = (q4 < 0) ? -(int32_t)q4 : q4;
+    (void)sprintf(out, "%s%ld.%04ld", (q4 < 0) ? "-" : "", (long)(a >> 4), (long)(a & 0x0F) * 625L);
+}
+
+int Config_Format(char *buf, uint32_t size)
+{
+    const DevConfig *c = Config_Get();
+    char lo[12], hi[12];
+    uint32_t t = RTC_ReadEpoch2000();
+    unsigned int y;
+    unsigned char mo, d;
+
+    fmt_alarm(lo, c->alarm_lo_q4, CONFIG_ALARM_OFF_LO);
+    fmt_alarm(hi, c->alarm_hi_q4, CONFIG_ALARM_OFF_HI);
+    RTC_DaysToDate(t / 86400u, &y, &mo, &d);
+    t %= 86400u;
+
+    return snprintf(buf, size,
+        "# TempTrack settings: edit, save, then eject.\r\n"
+        "# Sampling period on USB, seconds (>= %u)\r\n"
+        "interval_s=%u\r\n"
+        "# Alarm limits, degC or off\r\n"
+        "alarm_low_C=%s\r\n"
+        "alarm_high_C=%s\r\n"
+        "# Sensor: oneshot or 0.25/1/4/8 Hz continuous\r\n"
+        "sensor_rate_Hz=%s\r\n"
+        "# 1: 13-bit, to +150 degC\r\n"
+        "sensor_extended=%u\r\n"
+        "# 1: on battery, wake on crossing the alarm limit\r\n"
+        "alert_wake=%u\r\n"
+        "# Median of 1-%u reads; IIR 1/2^n, n=0-%u\r\n"
+        "burst=%u\r\n"
+        "iir_shift=%u\r\n"
+        "# Uncomment to set the clock (UTC)\r\n"
+        "# time=20%02u-%02u-%02u %02lu:%02lu:%02lu\r\n",
+        CONFIG_INTERVAL_MIN_S, c->interval_s, lo, hi,
+        rate_names[(c->sensor_rate <= NST112_RATE_8HZ) ? c->sensor_rate : NST112_RATE_ONESHOT],
+        (unsigned int)c->sensor_ext, (unsigned int)c->alert_wake,
+        TEMP_ACQ_BURST_MAX, TEMP_ACQ_IIR_SHIFT_MAX, (unsigned int)c->acq_burst, (unsigned int)c->acq_iir_shift,
+        y, mo, d, (unsigned long)(t / 3600u), (unsigned long)((t / 60u) % 60u), (unsigned long)(t % 60u));
+}
+
+/* Unsigned decimal of 1..digits digits (0 = any length); NULL if none */
+static const char *parse_uint(const char *p, const char *end, uint8_t digits, uint32_t *out)
+{
+    uint32_t v = 0u;
+    uint8_t n = 0u;
+
+    while (p < end && *p >= '0' && *p <= '9' && (digits == 0u || n < digits)) {
+        v = v * 10u + (uint32_t)(*p++ - '0');
+        if (++n > 9u) return NULL;
+    }
+    if (n == 0u) return NULL;
+    *out = v;
+    return p;
+}
+
+/* "[+-]ddd[.dddd]" in degC -> Q4, or "off" */
+static uint8_t parse_temp_q4(const char *p, const char *end, int16_t off, int16_t *out)
+{
+    uint8_t neg = 0u;
+    uint32_t ip, frac = 0u, scale = 1u;
+
+    if ((end - p) == 3 && (p[0] | 0x20) == 'o' && (p[1] | 0x20) == 'f' && (p[2] | 0x20) == 'f') {
+        *out = off;
+        return 1;
+    }
+    if (p < end && (*p == '+' || *p == '-')) neg = (uint8_t)(*p++ == '-');
+    if ((p = parse_uint(p, end, 4u, &ip)) == NULL || ip > 2000u) return 0;
+    if (p < end && *p == '.') {
+        p++;
+        while (p < end && *p >= '0' && *p <= '9') {
+            if (scale < 10000u) {
+                frac = frac * 10u + (uint32_t)(*p - '0');
+                scale *= 10u;
+            }
+            p++;
+        }
+    }
+    if (p != end) return 0;
+
+    ip = ip * 16u + (frac * 16u + scale / 2u) / scale;
+    *out = (int16_t)(neg ? -(int32_t)ip : (int32_t)ip);
+    return 1;
+}
+
+/* "YYYY-MM-DD HH:MM:SS" (or 'T' between date and time) -> seconds since 2000 */
+static uint8_t parse_time(const char *p, const char *end, uint32_t *out)
+{
+    static const char sep[5] = { '-', '-', ' ', ':', ':' };
+    uint32_t v[6];
+
+    for (uint8_t i = 0u; i < 6u; i++) {
+        if ((p = parse_uint(p, end, (i == 0u) ? 4u : 2u, &v[i])) == NULL) return 0;
+        if (i < 5u) {
+            if (p >= end || (*p != sep[i] && !(i == 2u && *p == 'T'))) return 0;
+            p++;
+        }
+    }
+    if (p != end) return 0;
+    if (v[0] < 2000u || v[0] > 2099u || v[1] < 1u || v[1] > 12u || v[2] < 1u || v[2] > 31u ||
+        v[3] > 23u || v[4] > 59u || v[5] > 59u) return 0;
+
+    *out = RTC_DateToEpoch2000(v[0] - 2000u, (unsigned char)v[1], (unsigned char)v[2],
+                               (unsigned char)v[3], (unsigned char)v[4], (unsigned char)v[5]);
+    return 1;
+}
+
+static uint8_t key_is(const char *k, const char *kend, const char *name)
+{
+    while (k < kend && *name) {
+        char ch = (*k >= 'A' && *k <= 'Z') ? (char)(*k + ('a' - 'A')) : *k;
+        if (ch != *name) return 0;
+        k++;
+        name++;
+    }
+    return (k == kend && *name == '\0');
+}
+
+uint8_t Config_ApplyText(const char *text, uint32_t len)
+{
+    DevConfig c = *Config_Get();
+    const char *p = text, *end = text + len;
+    uint8_t set_time = 0u, changed;
+    uint32_t t = 0u, old;
+
+    while (p < end) {
+        const char *k = p, *ke, *v, *ve, *eol = p;
+        uint32_t u;
+
+        while (eol < end && *eol != '\n' && *eol != '\0') eol++;
+        p = (eol < end) ? eol + 1 : end;
+
+        /* key = value, blanks around both */
+        while (k < eol && (*k == ' ' || *k == '\t')) k++;
+        if (k == eol || *k == '#' || *k == ';') continue;
+        for (v = k; v < eol && *v != '='; v++) {}
+        if (v == eol) continue;
+        ke = v++;
+        while (ke > k && (ke[-1] == ' ' || ke[-1] == '\t')) ke--;
+        while (v < eol && (*v == ' ' || *v == '\t')) v++;
+        ve = eol;
+        while (ve > v && (ve[-1] == '\r' || ve[-1] == ' ' || ve[-1] == '\t')) ve--;
+
+        if (key_is(k, ke, "interval_s")) {
+            if (parse_uint(v, ve, 0u, &u) == ve && u >= CONFIG_INTERVAL_MIN_S && u <= 0xFFFFu) {
+                c.interval_s = (uint16_t)u;
+            }
+        } else if (key_is(k, ke, "alarm_low_c")) {
+            (void)parse_temp_q4(v, ve, CONFIG_ALARM_OFF_LO, &c.alarm_lo_q4);
+        } else if (key_is(k, ke, "alarm_high_c")) {
+            (void)parse_temp_q4(v, ve, CONFIG_ALARM_OFF_HI, &c.alarm_hi_q4);
+        } else if (key_is(k, ke, "sensor_rate_hz")) {
+            for (u = 0u; u <= NST112_RATE_8HZ; u++) {
+                if (key_is(v, ve, rate_names[u])) c.sensor_rate = (uint8_t)u;
+            }
+        } else if (key_is(k, ke, "sensor_extended")) {
+            if (parse_uint(v, ve, 1u, &u) == ve && u <= 1u) c.sensor_ext = (uint8_t)u;
+        } else if (key_is(k, ke, "alert_wake")) {
+            if (parse_uint(v, ve, 1u, &u) == ve && u <= 1u) c.alert_wake = (uint8_t)u;
+        } else if (key_is(k, ke, "burst")) {
+            if (parse_uint(v, ve, 1u, &u) == ve && u >= 1u && u <= TEMP_ACQ_BURST_MAX) c.acq_burst = (uint8_t)u;
+        } else if (key_is(k, ke, "iir_shift")) {
+            if (parse_uint(v, ve, 1u, &u) == ve && u <= TEMP_ACQ_IIR_SHIFT_MAX) c.acq_iir_shift = (uint8_t)u;
+        } else if (key_is(k, ke, "time")) {
+            set_time = parse_time(v, ve, &t);
+        }
+    }
+
+    changed = Config_Save(&c);
+    if (set_time && LogStore_SetClock(t, &old)) {
+        RtcCal_ClockSet(old, t, 0u);   /* typed by hand: not a drift sample */
+        changed = 1u;
+    }
+    return changed;
+}
@@ -0,0 +1,137 @@
+#include "led.h"
+#include "main.h"
+
+#define LED_NONE            0xFFu
+
+static const LedStep led_ok[]    = { { LED_GREEN, 500u }, { 0u, 500u } };
+static const LedStep led_error[] = { { LED_RED, 500u }, { 0u, 500u }, { LED_RED, 500u }, { 0u, 500u } };
+
+static const struct {
+    const LedStep *steps;
+    uint8_t        n;
+} led_patterns[LED_PATTERNS] = {
+    { led_ok,    (uint8_t)(sizeof(led_ok) / sizeof(led_ok[0])) },
+    { led_error, (uint8_t)(sizeof(led_error) / sizeof(led_error[0])) },
+};
+
+static volatile uint8_t led_pat = LED_NONE;   /* playing */
+static volatile uint8_t led_step;
+static volatile uint8_t led_suspended;        /* Sleep_Ms() has LPTIM */
+static uint32_t led_left;                     /* LPTIM ticks of the step left while suspended */
+static volatile uint8_t led_queue[LED_QUEUE_LEN];
+static volatile uint8_t led_head, led_count;
+static volatile uint8_t led_idle;
+
+static void led_output(uint8_t leds)
+{
+    if (leds & LED_GREEN) LED0_ON(); else LED0_OFF();
+    if (leds & LED_RED)   LED1_ON(); else LED1_OFF();
+}
+
+static void led_start_step(void)
+{
+    const LedStep *s = &led_patterns[led_pat].steps[led_step];
+
+    led_output(s->leds);
+    led_left = Lptim_Ticks(s->ms);
+    if (!led_suspended) Lptim_OneShot(led_left);
+}
+
+/* Next step, else the next queued pattern, else idle. IRQs masked or in the ISR. */
+static void led_advance(void)
+{
+    if (led_pat != LED_NONE && ++led_step < led_patterns[led_pat].n) {
+        led_start_step();
+        return;
+    }
+    if (led_count != 0u) {
+        led_pat = led_queue[led_head];
+        led_head = (uint8_t)((led_head + 1u) % LED_QUEUE_LEN);
+        led_count--;
+        led_step = 0u;
+        led_start_step();
+        return;
+    }
+    led_pat = LED_NONE;
+    if (!led_suspended) Lptim_Stop();
+    led_output(led_idle);
+}
+
+void Led_Play(uint8_t pattern)
+{
+    if (pattern >= LED_PATTERNS) return;
+
+    __disable_irq();
+    if (led_count < LED_QUEUE_LEN) {
+        led_queue[(led_head + led_count) % LED_QUEUE_LEN] = pattern;
+        led_count++;
+        if (led_pat == LED_NONE && !led_suspended) {
+            led_advance();
+        }
+    }
+    __enable_irq();
+}
+
+void Led_SetIdle(uint8_t leds)
+{
+    __disable_irq();
+    if (leds != led_idle) {
+        led_idle = leds;
+        if (led_pat == LED_NONE) led_output(leds);
+    }
+    __enable_irq();
+}
+
+uint8_t Led_Busy(void)
+{
+    return (uint8_t)(led_pat != LED_NONE || led_count != 0u);
+}
+
+void Led_TimerEvent(void)
+{
+    if (!led_suspended) led_advance();
+}
+
+uint32_t Led_Suspend(void)
+{
+    uint32_t left = LED_NO_STEP;
+
+    __disable_irq();
+    if (led_pat != LED_NONE) {
+        led_suspended = 1u;
+        led_left = Lptim_Remaining();
+        left = led_left;
+        Lptim_Stop();
+    }
+    __enable_irq();
+    return left;
+}
+
+uint32_t Led_Elapse(uint32_t ticks)
+{
+    uint32_t left;
+
+    __disable_irq();
+    while (led_pat != LED_NONE && ticks >= led_left) {
+        ticks -= led_left;
+        led_advance();
+    }
+    if (led_pat != LED_NONE) led_left -= ticks;
+    left = (led_pat != LED_NONE) ? led_left : LED_NO_STEP;
+    __enable_irq();
+    return left;
+}
+
+void Led_Resume(void)
+{
+    __disable_irq();
+    if (led_suspended) {
+        led_suspended = 0u;
+        if (led_pat != LED_NONE && led_left != 0u) {
+            Lptim_OneShot(led_left);   /* what is left of the step */
+        } else {
+            led_advance();             /* due, or the next queued pattern */
+        }
+    }
+    __enable_irq();
+}
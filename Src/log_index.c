@@ -0,0 +1,180 @@
+#include "log_index.h"
+#include "main.h"
+
+#define LOG_INDEX_RUN   16u   /* records per flash burst while scanning */
+
+static LogDay   idx_days[LOG_INDEX_MAX_DAYS];
+static uint16_t idx_ndays;
+static uint32_t idx_scanned;  /* next seq to scan */
+static uint8_t  idx_built;
+static uint8_t  idx_chans;    /* channel bit mask */
+static LogSupply idx_supply;
+
+static void day_reset(LogDay *d, uint16_t day, uint32_t seq)
+{
+    memset(d, 0, sizeof(*d));
+    d->day = day;
+    d->chan = LOG_CHANNELS;
+    d->first_seq = seq;
+}
+
+static void day_add(LogDay *d, const LogRecord *rec, uint32_t seq, uint8_t ok)
+{
+    d->count = seq - d->first_seq + 1u;
+    if (!ok) return;
+    if (rec->type != LOG_REC_TEMP && rec->type != LOG_REC_SENSOR_ERR) return;
+    if (rec->chan >= LOG_CHANNELS || rec->chan > d->chan) return;   /* not the day's primary */
+    if (rec->chan < d->chan) {
+        /* A lower channel: it is the primary, start over with it */
+        d->chan = rec->chan;
+        d->ntemp = 0u;
+        d->tsum = 0;
+        d->nerr = 0u;
+    }
+
+    if (rec->type == LOG_REC_TEMP) {
+        if (d->ntemp == 0u || rec->value < d->tmin) d->tmin = rec->value;
+        if (d->ntemp == 0u || rec->value > d->tmax) d->tmax = rec->value;
+        d->tsum += rec->value;
+        d->ntemp++;
+    } else if (rec->type == LOG_REC_SENSOR_ERR) {
+        d->nerr++;
+    }
+}
+
+static void index_drop_first(void)
+{
+    idx_ndays--;
+    memmove(&idx_days[0], &idx_days[1], (uint32_t)idx_ndays * sizeof(LogDay));
+}
+
+/* Channels and supply history: log-wide, not per day */
+static void index_other(const LogRecord *rec)
+{
+    if ((rec->type == LOG_REC_TEMP || rec->type == LOG_REC_SENSOR_ERR || rec->type == LOG_REC_ALARM) &&
+        rec->chan < LOG_CHANNELS) {
+        idx_chans |= (uint8_t)(1u << rec->chan);
+    } else if (rec->type == LOG_REC_SUPPLY) {
+        if (idx_supply.count++ == 0u) {
+            idx_supply.first_time = rec->time;
+            idx_supply.first_mv = (uint16_t)rec->value;
+        }
+        idx_supply.last_time = rec->time;
+        idx_supply.last_mv = (uint16_t)rec->value;
+        idx_supply.last_mcu_q4 = (int16_t)rec->aux;
+    } else if (rec->type == LOG_REC_BROWNOUT) {
+        idx_supply.nbrownout++;
+    }
+}
+
+static void index_add(const LogRecord *rec, uint32_t seq, uint8_t ok)
+{
+    LogDay *last = idx_ndays ? &idx_days[idx_ndays - 1u] : NULL;
+
+    if (ok && (last == NULL || (rec->time / 86400u) > last->day)) {
+        if (idx_ndays == LOG_INDEX_MAX_DAYS) {
+            index_drop_first();
+        }
+        last = &idx_days[idx_ndays++];
+        day_reset(last, (uint16_t)(rec->time / 86400u), seq);
+    }
+
+    if (ok) {
+        index_other(rec);
+    }
+
+    /* Unreadable records before the first day have no date: leave them out */
+    if (last) {
+        day_add(last, rec, seq, ok);
+    }
+}
+
+/* Re-aggregate [from, to) into d, e.g. after the log dropped its oldest sector */
+static void index_rescan_day(LogDay *d, uint32_t from, uint32_t to)
+{
+    LogRecord run[LOG_INDEX_RUN];
+
+    day_reset(d, d->day, from);
+    while (from < to) {
+        uint32_t n = LogStore_ReadRun(from, run, ((to - from) < LOG_INDEX_RUN) ? (to - from) : LOG_INDEX_RUN);
+        if (n == 0u) break;
+        for (uint32_t i = 0u; i < n; i++, from++) {
+            day_add(d, &run[i], from, LogStore_RecordOk(&run[i], from));
+        }
+    }
+}
+
+/* Catch up by at most budget records; 0 if the log is unusable */
+static uint8_t index_update(uint32_t budget)
+{
+    LogRecord run[LOG_INDEX_RUN];
+    uint32_t first, next;
+
+    if (!LogStore_Mount()) return 0;
+
+    first = LogStore_FirstSeq();
+    next  = LogStore_NextSeq();
+
+    if (!idx_built || idx_scanned > next) {
+        idx_ndays = 0u;
+        idx_chans = 0u;
+        memset(&idx_supply, 0, sizeof(idx_supply));
+        idx_scanned = first;
+        idx_built = 1u;
+    }
+
+    /* Oldest sector was recycled: drop vanished days, trim the first one */
+    while (idx_ndays && (idx_days[0].first_seq + idx_days[0].count) <= first) {
+        index_drop_first();
+    }
+    if (idx_ndays && idx_days[0].first_seq < first) {
+        index_rescan_day(&idx_days[0], first, idx_days[0].first_seq + idx_days[0].count);
+    }
+    if (idx_scanned < first) {
+        idx_scanned = first;
+    }
+
+    if (next - idx_scanned > budget) next = idx_scanned + budget;
+    while (idx_scanned < next) {
+        uint32_t n = LogStore_ReadRun(idx_scanned, run, ((next - idx_scanned) < LOG_INDEX_RUN) ? (next - idx_scanned) : LOG_INDEX_RUN);
+        if (n == 0u) break;
+        for (uint32_t i = 0u; i < n; i++, idx_scanned++) {
+            index_add(&run[i], idx_scanned, LogStore_RecordOk(&run[i], idx_scanned));
+        }
+    }
+    return 1;
+}
+
+uint8_t LogIndex_Update(void)
+{
+    return index_update(0xFFFFFFFFu);
+}
+
+uint8_t LogIndex_UpdateSome(uint32_t max_records)
+{
+    uint32_t from = idx_scanned;
+
+    if (!index_update(max_records)) return 1u;   /* nothing to wait for */
+    /* A run that reads nothing will not read later either: stop there */
+    return (uint8_t)(idx_scanned >= LogStore_NextSeq() || idx_scanned == from);
+}
+
+uint16_t LogIndex_Days(void)
+{
+    return idx_ndays;
+}
+
+const LogDay *LogIndex_Day(uint16_t i)
+{
+    return (i < idx_ndays) ? &idx_days[i] : NULL;
+}
+
+uint8_t LogIndex_Channels(void)
+{
+    return idx_chans;
+}
+
+const LogSupply *LogIndex_Supply(void)
+{
+    return &idx_supply;
+}
@@ -0,0 +1,208 @@
+#include "log_store.h"
+#include "main.h"
+
+/*
+ * RAM view of the log. head is the slot the next record goes to;
+ * first_seq/next_seq bound what is stored (oldest .. newest + 1).
+ */
+static uint8_t  log_mounted;
+static uint32_t log_head;
+static uint32_t log_first_seq;
+static uint32_t log_next_seq;
+
+uint16_t Crc16_Ccitt(const uint8_t *p, uint32_t n)
+{
+    uint16_t crc = 0xFFFFu;
+    while (n--) {
+        crc ^= (uint16_t)((uint16_t)(*p++) << 8);
+        for (uint8_t b = 0u; b < 8u; b++) {
+            crc = (crc & 0x8000u) ? (uint16_t)((crc << 1) ^ 0x1021u) : (uint16_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+static uint32_t log_slot_addr(uint32_t slot)
+{
+    return LOG_STORE_ADDRESS + slot * LOG_REC_SIZE;
+}
+
+static uint32_t log_read_seq(uint32_t slot)
+{
+    uint32_t seq = LOG_SEQ_NONE;
+    Flash_ReadData(log_slot_addr(slot), (uint8_t*)&seq, sizeof(seq));
+    return seq;
+}
+
+/*
+ * Oldest stored seq: the head sector itself while it still holds old data
+ * (head at its start, not yet erased), else the sector after it, else
+ * sector 0 when the log has never wrapped.
+ */
+static void log_update_first(void)
+{
+    uint32_t sec = log_head / LOG_REC_PER_SECTOR;
+    uint32_t seq = LOG_SEQ_NONE;
+
+    if ((log_head % LOG_REC_PER_SECTOR) == 0u) {
+        seq = log_read_seq(log_head);
+    }
+    if (seq == LOG_SEQ_NONE) {
+        seq = log_read_seq(((sec + 1u) % LOG_SECTORS) * LOG_REC_PER_SECTOR);
+    }
+    if (seq == LOG_SEQ_NONE) {
+        seq = log_read_seq(0u);
+    }
+    if (seq == LOG_SEQ_NONE || seq > log_next_seq) {
+        seq = log_next_seq;
+    }
+    log_first_seq = seq;
+}
+
+uint8_t LogStore_Mount(void)
+{
+    uint32_t best_sec = LOG_SECTORS;
+    uint32_t best_seq = 0u;
+    uint32_t lo, hi;
+
+    if (log_mounted) return 1;
+    if (!Flash_CheckID()) return 0;
+
+    /* Newest sector = the one whose first record has the highest seq */
+    for (uint32_t sec = 0u; sec < LOG_SECTORS; sec++) {
+        uint32_t seq = log_read_seq(sec * LOG_REC_PER_SECTOR);
+        if (seq != LOG_SEQ_NONE && (best_sec == LOG_SECTORS || seq > best_seq)) {
+            best_sec = sec;
+            best_seq = seq;
+        }
+    }
+
+    if (best_sec == LOG_SECTORS) {
+        log_head = 0u;
+        log_next_seq = 0u;
+        log_first_seq = 0u;
+        log_mounted = 1u;
+        return 1;
+    }
+
+    /* Records fill a sector front to back: binary search for the first erased slot */
+    lo = 1u;
+    hi = LOG_REC_PER_SECTOR;
+    while (lo < hi) {
+        uint32_t mid = (lo + hi) / 2u;
+        if (log_read_seq(best_sec * LOG_REC_PER_SECTOR + mid) == LOG_SEQ_NONE) {
+            hi = mid;
+        } else {
+            lo = mid + 1u;
+        }
+    }
+
+    log_head = (best_sec * LOG_REC_PER_SECTOR + lo) % LOG_SLOTS;
+    log_next_seq = best_seq + lo;
+    log_update_first();
+    log_mounted = 1u;
+    return 1;
+}
+
+uint8_t LogStore_Append(uint8_t type, uint8_t chan, int16_t value, uint16_t aux)
+{
+    LogRecord rec;
+
+    if (!LogStore_Mount()) return 0;
+
+    /* Entering a sector: drop the oldest 256 records it holds */
+    if ((log_head % LOG_REC_PER_SECTOR) == 0u) {
+        if (log_read_seq(log_head) != LOG_SEQ_NONE) {
+            Flash_SectorErase(log_slot_addr(log_head));
+            log_update_first();
+        }
+    }
+
+    rec.seq   = log_next_seq;
+    rec.time  = RTC_ReadEpoch2000();
+    rec.type  = type;
+    rec.chan  = chan;
+    rec.value = value;
+    rec.aux   = aux;
+    rec.crc   = Crc16_Ccitt((const uint8_t*)&rec, LOG_REC_SIZE - 2u);
+
+    /* 16-byte slots never straddle a 256-byte page */
+    Flash_PageProgram(log_slot_addr(log_head), (uint8_t*)&rec, LOG_REC_SIZE);
+
+    log_next_seq++;
+    log_head = (log_head + 1u) % LOG_SLOTS;
+    return 1;
+}
+
+uint32_t LogStore_FirstSeq(void)
+{
+    return log_first_seq;
+}
+
+uint32_t LogStore_NextSeq(void)
+{
+    return log_next_seq;
+}
+
+static uint32_t log_seq_slot(uint32_t seq)
+{
+    return (log_head + LOG_SLOTS - (log_next_seq - seq)) % LOG_SLOTS;
+}
+
+uint8_t LogStore_RecordOk(const LogRecord *rec, uint32_t seq)
+{
+    if (rec->seq != seq) return 0;
+    return (rec->crc == Crc16_Ccitt((const uint8_t*)rec, LOG_REC_SIZE - 2u));
+}
+
+uint8_t LogStore_ReadSeq(uint32_t seq, LogRecord *rec)
+{
+    if (!log_mounted || seq < log_first_seq || seq >= log_next_seq) return 0;
+
+    Flash_ReadData(log_slot_addr(log_seq_slot(seq)), (uint8_t*)rec, LOG_REC_SIZE);
+    return LogStore_RecordOk(rec, seq);
+}
+
+uint32_t LogStore_ReadRun(uint32_t seq, LogRecord *recs, uint32_t n)
+{
+    uint32_t slot;
+
+    if (!log_mounted || seq < log_first_seq || seq >= log_next_seq) return 0;
+
+    slot = log_seq_slot(seq);
+    if (n > log_next_seq - seq) n = log_next_seq - seq;
+    if (n > LOG_SLOTS - slot) n = LOG_SLOTS - slot;
+
+    Flash_ReadData(log_slot_addr(slot), (uint8_t*)recs, n * LOG_REC_SIZE);
+    return n;
+}
+
+uint32_t LogStore_FindTime(uint32_t t)
+{
+    uint32_t lo = log_first_seq;
+    uint32_t hi = log_next_seq;
+    LogRecord rec;
+
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2u;
+        /* A corrupt record is treated as "before t" so the search keeps moving */
+        if (LogStore_ReadSeq(mid, &rec) && rec.time >= t) {
+            hi = mid;
+        } else {
+            lo = mid + 1u;
+        }
+    }
+    return lo;
+}
+
+uint8_t LogStore_SetClock(uint32_t t, uint32_t *old_time)
+{
+    uint32_t old = RTC_ReadEpoch2000();
+    uint32_t delta = t - old;   /* two's complement: negative = clock was fast */
+
+    if (old_time) *old_time = old;
+    if (!RTC_SetEpoch2000(t)) return 0;
+
+    (void)LogStore_Append(LOG_REC_TIME_SET, 0, (int16_t)(delta >> 16), (uint16_t)delta);
+    return 1;
+}
@@ -1,5 +1,413 @@
 #include "main.h"
 
+/*
+ * Excursion log driven by the NST112 ALERT pin (CONFIG.TXT alert_wake=1).
+ * The comparator watches alarm_high_C, or alarm_low_C if only that is set:
+ * one comparator covers one limit. The pin level is the sensor's verdict
+ * (with its hysteresis and fault queue); on every change the temperature
+ * is read and the start or end of the excursion is logged.
+ */
+static uint8_t exc_side = NST112_ALERT_OFF;   /* limit armed in the sensor */
+static int16_t exc_limit;
+static uint8_t exc_active;                    /* past the limit */
+static uint8_t exc_level;                     /* ALERT level last handled */
+
+static void excursion_log(uint8_t active)
+{
+    int16_t t_q4 = 0;
+
+    if (NST112_ReadTempQ4(&t_q4) != 0) return;   /* retried on the next edge */
+    Flash_Init();
+    (void)LogStore_Append(LOG_REC_EXCURSION, 0, t_q4,
+        (uint16_t)(exc_side | (active ? 0u : LOG_EXCURSION_END)));
+    exc_active = active;
+}
+
+/*
+ * Arm or disarm the comparator to match CONFIG.TXT and log ALERT changes.
+ * Returns the ALERT level now handled (wake on the opposite edge), or 0xFF
+ * when ALERT is not in use.
+ */
+static uint8_t excursion_poll(void)
+{
+    const DevConfig *cfg;
+    uint8_t side = NST112_ALERT_OFF;
+    int16_t limit = 0;
+    uint8_t level;
+
+    Config_Mount();
+    cfg = Config_Get();
+    if (cfg->alert_wake) {
+        if (cfg->alarm_hi_q4 != CONFIG_ALARM_OFF_HI) {
+            side = NST112_ALERT_HIGH;
+            limit = cfg->alarm_hi_q4;
+        } else if (cfg->alarm_lo_q4 != CONFIG_ALARM_OFF_LO) {
+            side = NST112_ALERT_LOW;
+            limit = cfg->alarm_lo_q4;
+        }
+    }
+
+    if (side != exc_side || limit != exc_limit) {
+        int16_t t_q4 = 0;
+
+        NST112_GPIO_Init();
+        NST112_Configure(cfg->sensor_rate, cfg->sensor_ext);
+        if (NST112_SetAlert(side, limit) != 0) return 0xFF;
+        exc_side = side;
+        exc_limit = limit;
+        exc_active = 0u;
+        if (side == NST112_ALERT_OFF) {
+            WKUP_ALERT_Disable();
+            return 0xFF;
+        }
+        /* The comparator settles after a few conversions: start from a reading */
+        WKUP_ALERT_init();
+        exc_level = NST112_AlertActive();
+        if (NST112_ReadTempQ4(&t_q4) == 0 &&
+            ((side == NST112_ALERT_HIGH) ? (t_q4 >= limit) : (t_q4 < limit))) {
+            excursion_log(1u);
+        }
+        return exc_level;
+    }
+    if (exc_side == NST112_ALERT_OFF) return 0xFF;
+
+    level = NST112_AlertActive();
+    if (level != exc_level) {
+        /* HIGH: active at or above THIGH. LOW: inactive once below TLOW. */
+        uint8_t past = (exc_side == NST112_ALERT_HIGH) ? level : (uint8_t)!level;
+
+        exc_level = level;
+        if (past != exc_active) {
+            NST112_GPIO_Init();
+            excursion_log(past);
+        }
+    }
+    return level;
+}
+
+/* ---------------- tasks ---------------- */
+
+#define USB_SERVICE_MS  10u   /* detach check, CONFIG.TXT settle, ALERT while attached */
+
+static uint8_t usb_started;
+
+/* Scheduler time: the USB 1 ms tick while attached, else the time slept on
+ * LPTIM, which is where battery timers wait. Timers armed in one mode are
+ * cancelled when it ends. */
+static uint32_t sched_clock(void)
+{
+    return usb_started ? usb_ms_ticks : Sleep_Clock();
+}
+
+static uint8_t usb_present(void)
+{
+    return (uint8_t)LL_GPIO_IsInputPinSet(GPIOB, LL_GPIO_PIN_2);
+}
+
+/*
+ * CDC live stream while a terminal holds the port open: one CSV record
+ * per conversion of the primary, seq,ms,temp_C,dropped. Sensors in
+ * continuous mode give one every NST112_PeriodMs(); one-shot ones are
+ * converted back to back. Like the sampler, the conversion is waited out
+ * on a scheduler timer and the bus is the stream's until it is read:
+ * code that needs the bus calls stream_finish() first. Not written to
+ * flash; a record the host cannot take in time is dropped.
+ */
+static uint32_t stream_seq;
+static uint8_t stream_conv;     /* conversion of stream_prim in flight */
+static uint8_t stream_prim;
+static uint8_t stream_exc;      /* excursion_poll() skipped for it: run after the read */
+static int16_t stream_t[NST112_MAX_SENSORS];
+static int stream_rc[NST112_MAX_SENSORS];
+
+static void stream_record(uint8_t ok)
+{
+    char line[48];
+    int len;
+
+    if (!ok) {
+        len = sprintf(line, "%lu,%lu,ERR,%lu\r\n", (unsigned long)stream_seq,
+            (unsigned long)usb_ms_ticks, (unsigned long)USB_Stream_Dropped());
+    } else {
+        int16_t t_q4 = stream_t[stream_prim];
+        int sign = (t_q4 < 0);
+        int16_t a = (int16_t)(sign ? -t_q4 : t_q4);
+        len = sprintf(line, "%lu,%lu,%s%d.%04d,%lu\r\n", (unsigned long)stream_seq,
+            (unsigned long)usb_ms_ticks, sign ? "-" : "", (int)(a >> 4),
+            (int)(a & 0x0F) * 625, (unsigned long)USB_Stream_Dropped());
+    }
+    stream_seq++;
+    (void)USB_Stream_Write(line, (uint16_t)len);
+}
+
+/* Start a conversion, or read the one in flight; returns the ms to the next step */
+static uint32_t stream_step(void)
+{
+    uint32_t ms;
+
+    if (!stream_conv) {
+        NST112_Configure(Config_Get()->sensor_rate, Config_Get()->sensor_ext);
+        stream_prim = NST112_Primary();
+        stream_conv = 1u;
+        ms = NST112_Start((uint8_t)(1u << stream_prim), stream_rc);
+        if (ms != 0u) return ms;   /* continuous and in step: read it now */
+    }
+    ms = NST112_Pending(stream_rc);
+    if (ms != 0u) return ms;
+    stream_conv = 0u;
+    stream_record((uint8_t)((NST112_Collect(stream_t, stream_rc) >> stream_prim) & 1u));
+    return NST112_PeriodMs();   /* 0: one-shot, the next one right away */
+}
+
+/* Complete the conversion in flight here, waiting with DelayMs() */
+static void stream_finish(void)
+{
+    while (stream_conv) {
+        uint32_t ms = stream_step();
+
+        if (stream_conv) DelayMs(ms, DELAY_COARSE);
+        else Sched_After(SCHED_TASK_STREAM, ms);
+    }
+}
+
+static void stream_task(uint8_t arg)
+{
+    (void)arg;
+    if (!usb_started) return;
+    if (!stream_conv && (!USB_Stream_IsOpen() || Sampler_Busy())) {
+        Sched_After(SCHED_TASK_STREAM, USB_STREAM_POLL_MS);   /* a record skipped, not late */
+        return;
+    }
+    Sched_After(SCHED_TASK_STREAM, stream_step());
+    if (!stream_conv && stream_exc) {
+        stream_exc = 0u;
+        (void)excursion_poll();
+    }
+}
+
+static void usb_attach(void)
+{
+    Sampler_Finish();   /* its timer runs on the clock that ends here */
+    usb_started = 1;
+    Profile_Cancel();   /* BSTIM becomes the USB tick */
+
+    Flash_Init();
+
+    Arena_Mode(ARENA_MODE_USB);
+    MSC_InvalidateImage();
+    MSC_EnableRawLun(Button_Held()); /* button held while plugging in: add raw flash LUN */
+    USBInit();            /* enumerate MSC: host starts talking right away */
+    MSC_PrepareImage();   /* reload file from external SPI flash while enumerating */
+    stream_seq = 0;
+    stream_exc = 0u;
+    NST112_GPIO_Init();
+    (void)NST112_Scan();   /* probes may have been plugged in meanwhile */
+
+    /* That press selected the raw LUN; it is not a sample request */
+    Button_Reset();
+
+    Sched_After(SCHED_TASK_USB, USB_SERVICE_MS);
+    Sched_After(SCHED_TASK_SAMPLE, Config_Get()->interval_s * 1000u);
+    Sched_After(SCHED_TASK_STREAM, USB_STREAM_POLL_MS);
+
+    /* Indicate USB active */
+    Led_SetIdle(LED_RED);
+}
+
+static void usb_detach(void)
+{
+    Sampler_Finish();
+    stream_finish();
+    Sched_Cancel(SCHED_TASK_USB);
+    Sched_Cancel(SCHED_TASK_SAMPLE);
+    Sched_Cancel(SCHED_TASK_STREAM);
+    USBStop();   /* USB clocks, BSTIM tick and PLL off: back on the base RCHF level */
+    Arena_Mode(ARENA_MODE_BATTERY);   /* the USB buffers are scratch again */
+    usb_started = 0; /* allow MSC re-init on next insertion */
+    Button_Reset();
+    Led_SetIdle(0u);
+}
+
+static void usb_task(uint8_t arg)
+{
+    if (!usb_present()) {
+        if (usb_started) usb_detach();
+        return;
+    }
+    if (!usb_started) {
+        usb_attach();
+        return;
+    }
+
+    /* SCSI/storage work deferred from the USB ISR */
+    USB_Process();
+    if (arg == SCHED_ARG_TIMER) {
+        if (stream_conv) stream_exc = 1u;   /* the stream has the bus: after its read */
+        else if (!Sampler_Busy()) (void)excursion_poll();   /* the sample has the bus */
+        MSC_Poll();   /* index catch-up, then CONFIG.TXT once the host's writes settled */
+        Sched_After(SCHED_TASK_USB, USB_SERVICE_MS);
+    }
+}
+
+static void usb_sampled(uint8_t stored)
+{
+    if (stored) {
+        MSC_RefreshImage();
+    }
+}
+
+/* Keep logging while attached: on a short press or every interval_s
+ * (CONFIG.TXT), then publish the new file to the host. */
+static void usb_sample(void)
+{
+    stream_finish();
+    (void)Sampler_Start(usb_sampled);   /* one running already: it counts */
+    Sched_After(SCHED_TASK_SAMPLE, Config_Get()->interval_s * 1000u);
+}
+
+static void sample_task(uint8_t arg)
+{
+    (void)arg;
+    if (usb_started) usb_sample();
+}
+
+static void battery_sampled(uint8_t stored)
+{
+    (void)stored;
+    Profile_Stop();
+}
+
+/* Short press while NOT connected to USB: read NST112 temperature and
+ * store it into the single file in SPI flash */
+static void battery_sample(void)
+{
+    Profile_Start();   /* the press was classified: time the sample only */
+    if (!Sampler_Start(battery_sampled)) Profile_Cancel();
+}
+
+/* Long press: measure and log the supply now, red when it is getting low */
+static void supply_check(void)
+{
+    uint16_t mv;
+    int16_t q4;
+
+    Sampler_Finish();
+    Flash_Init();
+    if (Supply_Measure(&mv, &q4) != 0) {
+        Led_Play(LED_PAT_ERROR);
+        return;
+    }
+    (void)LogStore_Append(LOG_REC_SUPPLY, 0, (int16_t)mv, (uint16_t)q4);
+    Led_Play((mv >= SUPPLY_CUTOFF_MV + 200u) ? LED_PAT_OK : LED_PAT_ERROR);
+}
+
+/* Double press: look for probes plugged in since the last scan */
+static void probe_rescan(void)
+{
+    Sampler_Finish();
+    stream_finish();
+    NST112_GPIO_Init();
+    Led_Play(NST112_Scan() ? LED_PAT_OK : LED_PAT_ERROR);
+}
+
+static void button_press(uint8_t press)
+{
+    if (usb_present() && !usb_started) return;   /* usb_task() takes it as the raw LUN request */
+
+    switch (press)
+    {
+        case BUTTON_SHORT:
+            if (usb_started) usb_sample();
+            else battery_sample();
+            break;
+
+        case BUTTON_LONG:
+            supply_check();
+            break;
+
+        case BUTTON_DOUBLE:
+            probe_rescan();
+            break;
+
+        default:   /* BUTTON_STUCK: ignored until released */
+            Led_Play(LED_PAT_ERROR);
+            break;
+    }
+}
+
+static void alert_task(uint8_t arg)
+{
+    (void)arg;
+    Sampler_Finish();
+    stream_finish();
+    (void)excursion_poll();
+}
+
+/* Supply falling through the SVD level: write out what is still
+ * pending and mark the log before a brown-out can cut it off */
+static void supply_task(uint8_t arg)
+{
+    (void)arg;
+    if (!Supply_Warning()) return;
+    Sampler_Abort();    /* no time for the rest of a burst: its old lines go back */
+    Profile_Cancel();   /* not a sample window */
+    Flash_Init();
+    if (usb_started) MSC_Flush();
+    (void)LogStore_Append(LOG_REC_BROWNOUT, 0, (int16_t)Supply_LastMv(), 0);
+}
+
+/*
+ * Idle hook: the deepest sleep the pending timers allow. Attached: WFI,
+ * the 1 ms BSTIM tick and USB keep running. A timer pending: PMU Sleep on
+ * LPTIM until it is due or an interrupt posts work. Otherwise DeepSleep
+ * until the button, USB or the next ALERT edge.
+ */
+static void idle(uint32_t wait_ms)
+{
+    if (wait_ms == 0u) return;   /* posted while dispatching */
+    if (usb_started) {
+        /* Plain WFI (Sleep_Deep() restored the Active mode). PRIMASK set:
+         * an IRQ between the check and WFI still wakes it. */
+        __disable_irq();
+        if (!Sched_Pending()) __WFI();
+        __enable_irq();
+        return;
+    }
+    if (wait_ms != SCHED_FOREVER) {
+        Sleep_Idle((wait_ms > 64000u) ? 64000u : wait_ms);
+        return;
+    }
+
+    uint8_t alert = excursion_poll();
+    if (alert != 0xFFu) {
+        WKUP_ALERT_SetEdge(alert);   /* active (low) now: wake on rising */
+        if (NST112_AlertActive() != alert) {   /* moved meanwhile */
+            (void)Sched_Post(SCHED_LEVEL_THREAD, SCHED_TASK_ALERT, 0u);
+            return;
+        }
+    }
+    Profile_Cancel();   /* this wake was not a sample */
+    if (Sched_Pending()) return;   /* an NMI came in meanwhile */
+
+    Flash_PowerDown();   /* the next command releases it */
+
+    /* A wake that posted nothing (an LED step on LPTIM) sleeps again without
+     * the resume work. PRIMASK set: the waking IRQ runs on the enable. */
+    __disable_irq();
+    do {
+        Sleep_Deep();
+        __enable_irq();
+        __disable_irq();
+    } while (!Sched_Pending());
+    __enable_irq();
+
+    /* Time the wake from here; a short press restarts the window for its sample */
+    Profile_Start();
+    UserResume();
+    RTC_SimpleInit_IfNeeded();   /* one compare: the signature is cached */
+    Profile_Lap(PROFILE_RESUME);
+}
+
 int main(void)
 {
     MF_Clock_Init();
@@ -10,80 +418,34 @@ int main(void)
 
     RTC_SimpleInit_IfNeeded();
 
+    /* MF_Clock_Init() cleared the RTC trim: restore the learned one */
+    Flash_Init();
+    RtcCal_Mount();
+    Profile_Mount();
+
+    /* Find the sensors once; the result survives DeepSleep */
+    NST112_GPIO_Init();
+    (void)NST112_Scan();
+
+    Sched_Init(sched_clock);
+    Sched_SetTask(SCHED_TASK_USB, usb_task);
+    Sched_SetTask(SCHED_TASK_BUTTON, Button_Task);
+    Sched_SetTask(SCHED_TASK_ALERT, alert_task);
+    Sched_SetTask(SCHED_TASK_SUPPLY, supply_task);
+    Sched_SetTask(SCHED_TASK_SAMPLE, sample_task);
+    Sched_SetTask(SCHED_TASK_STREAM, stream_task);
+    Sched_SetTask(SCHED_TASK_SAMPLER, Sampler_Task);
+
     WKUP_init();
     WKUP_USB_init();
+    Button_Init(button_press);
+    Supply_Init();
+
+    /* The wake pins are edge triggered: pick up levels already high */
+    if (usb_present()) (void)Sched_Post(SCHED_LEVEL_THREAD, SCHED_TASK_USB, 0u);
 
-    uint8_t usb_started = 0;
     while (1)
     {
-        uint8_t usb  = LL_GPIO_IsInputPinSet(GPIOB, LL_GPIO_PIN_2);
-        uint8_t butt = LL_GPIO_IsInputPinSet(GPIOA, LL_GPIO_PIN_15);
-
-        if (usb)
-        {
-            if (!usb_started)
-            {
-                usb_started = 1;
-
-                FlashGpio_init();
-                FlashSpi_init();
-                Flash_CS_High();
-
-                MSC_PrepareImage();   /* reload file from external SPI flash into RAM image */
-                USBInit();            /* enumerate MSC */
-            }
-
-            /* Indicate USB active */
-            LED1_ON();
-            LED0_OFF();
-        }
-        else if (butt)
-        {
-            /* Button press (WKUP0) while NOT connected to USB:
-             * read NST112 temperature and store it into the single file in SPI flash.
-             */
-            FlashGpio_init();
-            FlashSpi_init();
-            Flash_CS_High(); // init all pins for SPI_FLASH P25Q16SH
-
-            NST112_GPIO_Init(); // init nst112 sensor pins for Temperature
-
-            int16_t t_q4 = 0;
-            int rc = NST112_ReadTempQ4(&t_q4);
-            if (rc == 0) {
-                (void)RTC_SimpleInit_IfNeeded();
-                unsigned char hh=0, mm=0, ss=0;
-                RTC_ReadTimeHMS(&hh, &mm, &ss);
-                (void)Flash_WriteTemperatureWithTimeFile_Q4(t_q4, hh, mm, ss);
-                blink_green();
-            } else {
-                /* Error reading sensor: append diagnostics into the ring log */
-                (void)RTC_SimpleInit_IfNeeded();
-                unsigned char hh=0, mm=0, ss=0;
-                RTC_ReadTimeHMS(&hh, &mm, &ss);
-
-                char err[96];
-                (void)sprintf(err, "%02u:%02u:%02u  NST112 error, rc=%d\r\n", hh, mm, ss, rc);
-                (void)Flash_LogLine_Ring5(err, (uint32_t)strlen(err));
-
-                blink_red();
-                blink_red();
-            }
-            /* Wait for button release to avoid repeated writes while held */
-            while (LL_GPIO_IsInputPinSet(GPIOA, LL_GPIO_PIN_15)) {
-                DelayMs(10);
-            }
-        }
-        else
-        {
-            usb_started = 0; /* allow MSC re-init on next insertion */
-            LED0_OFF();
-            LED1_OFF();
-
-            Sleep_Deep();
-
-            UserInit();
-            RTC_SimpleInit_IfNeeded();
-        }
+        idle(Sched_Dispatch());
     }
 }
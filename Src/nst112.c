@@ -1,13 +1,22 @@
 #include "nst112.h"
-#include "fm33lc0xx.h"
-#include "fm33lc0xx_ll_gpio.h"
+#include "main.h"
 
-/* Simple bit-banged I2C for NST112 (standard-mode). */
+/*
+ * NST112 sensors on PA11 (SCL) / PA12 (SDA), one per strap address.
+ * Default path: the I2C peripheral at NST112_I2C_BAUD, one interrupt per
+ * bus event, the core in WFI between them. Fallback: bit-banged bus.
+ */
+
+static uint8_t nst_addr = NST112_I2C_ADDR;   /* 7-bit address of the selected sensor */
+
+/* ---------------- bit-banged bus ---------------- */
+
+static uint32_t bb_loops = 1u;   /* i2c_delay() iterations, from systemClock */
+static uint8_t bb_ready;         /* bb_init() ran */
 
 static void i2c_delay(void)
 {
-    /* ~10-20us at 8MHz. Adjust if needed. */
-    for (volatile int i = 0; i < 120; i++) {
+    for (volatile uint32_t i = bb_loops; i != 0u; i--) {
         __NOP();
     }
 }
@@ -18,47 +27,41 @@ static void scl_low(void)  { LL_GPIO_ResetOutputPin(NST112_SCL_PORT, NST112_SCL_
 static void sda_high(void) { LL_GPIO_SetOutputPin(NST112_SDA_PORT, NST112_SDA_PIN); }
 static void sda_low(void)  { LL_GPIO_ResetOutputPin(NST112_SDA_PORT, NST112_SDA_PIN); }
 
-static void sda_out(void)
-{
-    LL_GPIO_InitTypeDef io = {0};
-    io.Pin        = NST112_SDA_PIN;
-    io.Mode       = LL_GPIO_MODE_OUTPUT;
-    io.OutputType = LL_GPIO_OUTPUT_OPENDRAIN;
-    io.Pull       = ENABLE;
-    io.RemapPin   = DISABLE;
-    LL_GPIO_Init(NST112_SDA_PORT, &io);
-}
+/* Direction only; open drain, pull-up and input enable are set once in bb_init() */
+static void sda_out(void) { LL_GPIO_SetPinMode(NST112_SDA_PORT, NST112_SDA_PIN, LL_GPIO_MODE_OUTPUT); }
+static void sda_in(void)  { LL_GPIO_SetPinMode(NST112_SDA_PORT, NST112_SDA_PIN, LL_GPIO_MODE_INPUT); }
 
-static void sda_in(void)
+static int sda_read(void)
 {
-    LL_GPIO_InitTypeDef io = {0};
-    io.Pin        = NST112_SDA_PIN;
-    io.Mode       = LL_GPIO_MODE_INPUT;
-    io.OutputType = LL_GPIO_OUTPUT_PUSHPULL;
-    io.Pull       = ENABLE;
-    io.RemapPin   = DISABLE;
-    LL_GPIO_Init(NST112_SDA_PORT, &io);
+    return (int)LL_GPIO_IsInputPinSet(NST112_SDA_PORT, NST112_SDA_PIN);
 }
 
-static int sda_read(void)
+/* About 4 cycles per loop on the M0+: half period in NST112_BB_HALF_US */
+static void bb_timing(void)
 {
-    return (int)LL_GPIO_IsInputPinSet(NST112_SDA_PORT, NST112_SDA_PIN);
+    bb_loops = (systemClock / 1000000u) * NST112_BB_HALF_US / 4u;
+    if (bb_loops == 0u) bb_loops = 1u;
 }
 
-void NST112_GPIO_Init(void)
+static void bb_init(void)
 {
     LL_GPIO_InitTypeDef io = {0};
 
-    /* SCL as open-drain output with pull-up */
-    io.Pin        = NST112_SCL_PIN;
-    io.Mode       = LL_GPIO_MODE_OUTPUT;
+    bb_timing();
+    bb_ready = 1u;
+
+    /* SDA as input first so the input buffer is enabled, then both as
+     * open-drain outputs with pull-up */
+    io.Pin        = NST112_SDA_PIN;
+    io.Mode       = LL_GPIO_MODE_INPUT;
     io.OutputType = LL_GPIO_OUTPUT_OPENDRAIN;
     io.Pull       = ENABLE;
     io.RemapPin   = DISABLE;
-    LL_GPIO_Init(NST112_SCL_PORT, &io);
+    LL_GPIO_Init(NST112_SDA_PORT, &io);
 
-    /* SDA as open-drain output with pull-up (we will switch it to input for ACK/read) */
-    sda_out();
+    io.Pin        = NST112_SCL_PIN | NST112_SDA_PIN;
+    io.Mode       = LL_GPIO_MODE_OUTPUT;
+    LL_GPIO_Init(NST112_SCL_PORT, &io);
 
     /* Idle state: both high */
     scl_high();
@@ -139,35 +142,574 @@ static uint8_t i2c_read_byte(int ack)
     return b;
 }
 
-int NST112_ReadTempQ4(int16_t *out_q4)
+/*
+ * One bus transaction: START, address+W, tx[0..ntx-1]; then, if nrx > 0,
+ * repeated START, address+R and nrx bytes (last one NACKed); STOP.
+ * Returns 0, or 3/4/5 for a NACK on address+W / a data byte / address+R.
+ */
+static int bb_xfer(const uint8_t *tx, uint8_t ntx, uint8_t *rx, uint8_t nrx)
 {
-    if (!out_q4) return 2;
-
-    /* NST112 pointer register for temperature is 0x00 */
-    const uint8_t addr_w = (uint8_t)((NST112_I2C_ADDR << 1) | 0u);
-    const uint8_t addr_r = (uint8_t)((NST112_I2C_ADDR << 1) | 1u);
+    const uint8_t addr_w = (uint8_t)((nst_addr << 1) | 0u);
+    const uint8_t addr_r = (uint8_t)((nst_addr << 1) | 1u);
 
     i2c_start();
     if (!i2c_write_byte(addr_w)) { i2c_stop(); return 3; }
-    if (!i2c_write_byte(0x00u))   { i2c_stop(); return 4; }
-
-    /* repeated start */
-    i2c_start();
-    if (!i2c_write_byte(addr_r)) { i2c_stop(); return 5; }
+    for (uint8_t i = 0u; i < ntx; i++) {
+        if (!i2c_write_byte(tx[i])) { i2c_stop(); return 4; }
+    }
 
-    uint8_t msb = i2c_read_byte(1); /* ACK */
-    uint8_t lsb = i2c_read_byte(0); /* NACK */
+    if (nrx) {
+        /* repeated start */
+        i2c_start();
+        if (!i2c_write_byte(addr_r)) { i2c_stop(); return 5; }
+        for (uint8_t i = 0u; i < nrx; i++) {
+            rx[i] = i2c_read_byte(i + 1u < nrx); /* ACK all but the last */
+        }
+    }
     i2c_stop();
+    return 0;
+}
+
+/* ---------------- I2C peripheral ---------------- */
+
+#if NST112_USE_HW_I2C
+
+/* Time allowed per transaction before giving up on the peripheral; a
+ * register read takes under 0.5 ms. SysTick bounds it: on battery no other
+ * interrupt may be enabled to end the WFI (a START with SDA held low never
+ * raises one, the SCL timeout does not cover it). */
+#define HW_XFER_TIMEOUT_US  5000u
+
+enum {
+    HW_IDLE = 0,
+    HW_START,       /* START sent, next: address + W */
+    HW_ADDR_W,      /* next: first tx byte */
+    HW_TX,          /* next: tx byte, repeated START or STOP */
+    HW_RSTART,      /* next: address + R */
+    HW_ADDR_R,      /* next: first receive */
+    HW_RX,          /* next: receive or STOP */
+    HW_STOP,        /* waiting for the STOP flag */
+    HW_DONE
+};
+
+static volatile uint8_t hw_state;
+static volatile uint8_t hw_rc;
+static const uint8_t *hw_tx;
+static uint8_t *hw_rx;
+static uint8_t hw_ntx, hw_nrx, hw_idx;
+static uint8_t hw_failed;   /* peripheral timed out: bit-bang until reset */
+static uint8_t hw_ready;    /* hw_init() ran, hw_release() not yet */
+
+/* SCL high/low and SDA hold from the live APB1 clock, as LL_I2C_MasterMode_Init() */
+static void hw_timing(void)
+{
+    uint32_t apb1 = LL_RCC_GetAPB1ClockFreq(LL_RCC_GetAHBClockFreq(LL_RCC_GetSystemClockFreq()));
+    uint32_t brg = apb1 / (2u * NST112_I2C_BAUD) - 1u;
+
+    LL_I2C_MasterMode_Disable(I2C);
+    LL_I2C_MasterMode_Set_SCL_HighWidth(I2C, brg);
+    LL_I2C_MasterMode_Set_SCL_LowWidth(I2C, brg);
+    LL_I2C_MasterMode_Set_SDA_HoldTime(I2C, (brg + 1u) / 2u);
+    LL_I2C_MasterMode_Enable(I2C);
+}
+
+static void hw_init(void)
+{
+    LL_GPIO_InitTypeDef io = {0};
+    LL_I2C_MasterMode_InitTypeDef i2c = {0};
+
+    io.Pin        = NST112_SCL_PIN | NST112_SDA_PIN;
+    io.Mode       = LL_GPIO_MODE_DIGITAL;
+    io.OutputType = LL_GPIO_OUTPUT_OPENDRAIN;
+    io.Pull       = ENABLE;
+    io.RemapPin   = DISABLE;
+    LL_GPIO_Init(NST112_SCL_PORT, &io);
+
+    i2c.ClockSource = LL_RCC_I2C_OPERATION_CLOCK_SOURCE_APBCLK1;
+    i2c.BaudRate    = NST112_I2C_BAUD;
+    (void)LL_I2C_MasterMode_Init(I2C, &i2c);
+
+    /* A sensor holding SCL low ends the transfer with OVT instead of hanging */
+    LL_I2C_MasterMode_Set_SlaveSCL_TimeOut(I2C, I2C_MSPTOR_TIMEOUT_Msk);
+    LL_I2C_MasterMode_Enable_TimeOut(I2C);
+
+    WRITE_REG(I2C->MSPISR, 0xFFFFFFFFu);
+    LL_I2C_MasterMode_EnabledIT_Start(I2C);
+    LL_I2C_MasterMode_EnabledIT_Stop(I2C);
+    LL_I2C_MasterMode_EnabledIT_Nack(I2C);
+    LL_I2C_MasterMode_EnabledIT_TransmitCompleted(I2C);
+    LL_I2C_MasterMode_EnabledIT_ReceiveCompleted(I2C);
+    LL_I2C_MasterMode_EnabledIT_TimeOut(I2C);
+
+    NVIC_DisableIRQ(I2C_IRQn);
+    NVIC_SetPriority(I2C_IRQn, 2);
+    NVIC_EnableIRQ(I2C_IRQn);
+    hw_ready = 1u;
+}
+
+static void hw_release(void)
+{
+    NVIC_DisableIRQ(I2C_IRQn);
+    LL_I2C_MasterMode_Disable(I2C);
+    hw_state = HW_IDLE;
+    hw_ready = 0u;
+}
+
+static void hw_finish(uint8_t rc)
+{
+    hw_rc = rc;
+    hw_state = HW_STOP;
+    LL_I2C_MasterMode_Enable_I2C_Stop(I2C);
+}
+
+static void hw_receive(void)
+{
+    LL_I2C_MasterMode_SetMasterRespond(I2C, (hw_idx + 1u < hw_nrx) ?
+        LL_I2C_SSP_MASTER_RESPOND_ACK : LL_I2C_SSP_MASTER_RESPOND_NACK);
+    LL_I2C_MasterMode_EnableReceive(I2C);
+}
+
+void I2C_IRQHandler(void)
+{
+    if (LL_I2C_MasterMode_IsActiveFlag_TimeOut(I2C)) {
+        LL_I2C_MasterMode_ClearFlag_TimeOut(I2C);
+        hw_rc = 0xFFu;
+        hw_state = HW_DONE;
+        return;
+    }
+    if (LL_I2C_MasterMode_IsActiveFlag_Nack(I2C)) {
+        LL_I2C_MasterMode_ClearFlag_Nack(I2C);
+        LL_I2C_MasterMode_ClearFlag_TransmitCompleted(I2C);
+        switch (hw_state) {
+        case HW_ADDR_W: hw_finish(3); return;
+        case HW_TX:     hw_finish(4); return;
+        case HW_ADDR_R: hw_finish(5); return;
+        default: break;
+        }
+    }
+    if (LL_I2C_MasterMode_IsActiveFlag_Start(I2C)) {
+        LL_I2C_MasterMode_ClearFlag_Start(I2C);
+        if (hw_state == HW_START) {
+            hw_state = HW_ADDR_W;
+            LL_I2C_MasterMode_WriteDataBuff(I2C, (uint32_t)(nst_addr << 1) | 0u);
+        } else if (hw_state == HW_RSTART) {
+            hw_state = HW_ADDR_R;
+            LL_I2C_MasterMode_WriteDataBuff(I2C, (uint32_t)(nst_addr << 1) | 1u);
+        }
+    }
+    if (LL_I2C_MasterMode_IsActiveFlag_TransmitCompleted(I2C)) {
+        LL_I2C_MasterMode_ClearFlag_TransmitCompleted(I2C);
+        if (hw_state == HW_ADDR_W || hw_state == HW_TX) {
+            if (hw_idx < hw_ntx) {
+                hw_state = HW_TX;
+                LL_I2C_MasterMode_WriteDataBuff(I2C, hw_tx[hw_idx++]);
+            } else if (hw_nrx) {
+                hw_state = HW_RSTART;
+                LL_I2C_MasterMode_Enable_I2C_Rstart(I2C);
+            } else {
+                hw_finish(0);
+            }
+        } else if (hw_state == HW_ADDR_R) {
+            hw_state = HW_RX;
+            hw_idx = 0u;
+            hw_receive();
+        }
+    }
+    if (LL_I2C_MasterMode_IsActiveFlag_ReceiveCompleted(I2C)) {
+        LL_I2C_MasterMode_ClearFlag_ReceiveCompleted(I2C);
+        if (hw_state == HW_RX) {
+            hw_rx[hw_idx++] = (uint8_t)LL_I2C_MasterMode_ReadDataBuff(I2C);
+            if (hw_idx < hw_nrx) hw_receive(); else hw_finish(0);
+        }
+    }
+    if (LL_I2C_MasterMode_IsActiveFlag_Stop(I2C)) {
+        LL_I2C_MasterMode_ClearFlag_Stop(I2C);
+        if (hw_state == HW_STOP) hw_state = HW_DONE;
+    }
+}
+
+/* Only ends the WFI in hw_xfer(); TICKINT is off otherwise */
+void SysTick_Handler(void)
+{
+}
+
+/*
+ * Same transaction as bb_xfer() on the peripheral. Sleeps (plain WFI:
+ * Sleep_Deep() and Sleep_Ms() leave the PMU in Active mode) until the IRQ
+ * handler reaches HW_DONE or HW_XFER_TIMEOUT_US passed. Returns 0xFF if the
+ * peripheral stopped responding.
+ */
+static int hw_xfer(const uint8_t *tx, uint8_t ntx, uint8_t *rx, uint8_t nrx)
+{
+    if (LL_I2C_MasterMode_IsActiveFlag_Busy(I2C)) return 0xFF;
+
+    hw_tx = tx;
+    hw_ntx = ntx;
+    hw_rx = rx;
+    hw_nrx = nrx;
+    hw_idx = 0u;
+    hw_rc = 0xFFu;
+    hw_state = HW_START;
+
+    /* One SysTick period is the deadline (DelayUs() reloads it anyway) */
+    SysTick->LOAD = (uint32_t)((uint64_t)systemClock * HW_XFER_TIMEOUT_US / 1000000u) - 1u;
+    SysTick->VAL = 0u;   /* also clears COUNTFLAG */
+    SysTick->CTRL |= SysTick_CTRL_TICKINT_Msk | SysTick_CTRL_ENABLE_Msk;
+    LL_I2C_MasterMode_Enable_I2C_Start(I2C);
+
+    /* PRIMASK set: an IRQ that fires before WFI still wakes it */
+    __disable_irq();
+    while (hw_state != HW_DONE && !(SysTick->CTRL & SysTick_CTRL_COUNTFLAG_Msk)) {
+        __WFI();
+        __enable_irq();
+        __disable_irq();
+    }
+    __enable_irq();
+    SysTick->CTRL &= ~SysTick_CTRL_TICKINT_Msk;
+
+    if (hw_state != HW_DONE) {
+        hw_state = HW_IDLE;
+        return 0xFF;
+    }
+    hw_state = HW_IDLE;
+    return hw_rc;
+}
+
+#endif /* NST112_USE_HW_I2C */
+
+static int xfer(const uint8_t *tx, uint8_t ntx, uint8_t *rx, uint8_t nrx)
+{
+#if NST112_USE_HW_I2C
+    if (!hw_failed) {
+        int rc = hw_xfer(tx, ntx, rx, nrx);
+        if (rc != 0xFF) return rc;
+
+        /* Peripheral stuck: switch to the bit-banged bus and retry once */
+        hw_failed = 1u;
+        hw_release();
+        bb_init();
+    }
+#endif
+    return bb_xfer(tx, ntx, rx, nrx);
+}
+
+static int read_reg16(uint8_t reg, uint16_t *val)
+{
+    uint8_t rx[2];
+    int rc = xfer(&reg, 1u, rx, 2u);
+
+    if (rc == 0) *val = (uint16_t)(((uint16_t)rx[0] << 8) | rx[1]);
+    return rc;
+}
 
-    uint16_t raw = ((uint16_t)msb << 8) | (uint16_t)lsb;
+static int write_reg16(uint8_t reg, uint16_t val)
+{
+    uint8_t tx[3];
+
+    tx[0] = reg;
+    tx[1] = (uint8_t)(val >> 8);
+    tx[2] = (uint8_t)val;
+    return xfer(tx, 3u, NULL, 0u);
+}
+
+/* ---------------- sensor power management ---------------- */
+
+static uint8_t  nst_rate = NST112_RATE_ONESHOT;
+static uint8_t  nst_ext;
+static uint8_t  nst_alert = NST112_ALERT_OFF;
+static int16_t  nst_alert_q4;
+static uint8_t  nst_present;  /* channels that answered NST112_Scan() */
+static uint8_t  nst_primary;  /* lowest present channel, owns ALERT */
+static uint8_t  nst_chan;     /* channel on the bus */
+static uint8_t  nst_synced;   /* channels whose registers match the settings above */
+static uint32_t nst_wait_ms;  /* total waited for conversions */
+static uint8_t  nst_started;  /* NST112_Start() to NST112_Collect(): channels converting */
+static uint8_t  nst_started_os; /* of those, one-shot conversions */
+static uint32_t nst_waited;   /* ms NST112_Start() and NST112_Pending() asked for */
+
+static void nst_select(uint8_t chan)
+{
+    nst_chan = chan;
+    nst_addr = (uint8_t)(NST112_I2C_ADDR + chan);
+}
+
+static uint8_t nst_armed(void)
+{
+    return (nst_alert != NST112_ALERT_OFF && nst_chan == nst_primary);
+}
+
+/* The comparator needs conversions: an armed ALERT keeps the sensor running */
+static uint8_t nst_oneshot(void)
+{
+    return (nst_rate == NST112_RATE_ONESHOT && !nst_armed());
+}
+
+static uint16_t nst_config(void)
+{
+    uint16_t c = 0u;
+    uint8_t rate = nst_rate;
+
+    if (nst_oneshot()) {
+        c |= NST112_CFG_SD | NST112_CFG_CR_4HZ;
+    } else {
+        if (rate == NST112_RATE_ONESHOT) rate = NST112_RATE_0_25HZ;
+        c |= (uint16_t)((uint16_t)(rate - NST112_RATE_0_25HZ) << NST112_CFG_CR_Pos);
+    }
+    if (nst_armed()) c |= NST112_CFG_F_2;   /* comparator, ALERT active low */
+    if (nst_ext) c |= NST112_CFG_EM;
+    return c;
+}
+
+/* Q4 to the left-aligned limit register layout of the current mode */
+static uint16_t q4_to_reg(int32_t q4)
+{
+    int32_t max = nst_ext ? 4095 : 2047;
+
+    if (q4 > max) q4 = max;
+    if (q4 < -max - 1) q4 = -max - 1;
+    return (uint16_t)((uint32_t)q4 << (nst_ext ? 3u : 4u));
+}
+
+/* Write the limit registers (ALERT armed) and then the configuration register */
+static int nst_sync(uint16_t extra)
+{
+    int rc;
+
+    if (nst_armed()) {
+        int32_t hi = nst_alert_q4, lo = nst_alert_q4;
 
-    /* Default NST112 format: 12-bit temperature left-aligned (bits 15..4), LSB = 0.0625C.
-       After shifting right by 4 we have a 12-bit signed value in Q4 format. */
-    int16_t t12 = (int16_t)(raw >> 4);
-    if (t12 & 0x0800) {
-        t12 |= (int16_t)0xF000; /* sign-extend from 12-bit */
+        if (nst_alert == NST112_ALERT_HIGH) lo -= NST112_ALERT_HYST_Q4; else hi += NST112_ALERT_HYST_Q4;
+        rc = write_reg16(NST112_REG_THIGH, q4_to_reg(hi));
+        if (rc != 0) return rc;
+        rc = write_reg16(NST112_REG_TLOW, q4_to_reg(lo));
+        if (rc != 0) return rc;
     }
+    rc = write_reg16(NST112_REG_CONFIG, (uint16_t)(nst_config() | extra));
+    if (rc == 0) nst_synced |= (uint8_t)(1u << nst_chan);
+    return rc;
+}
+
+static int16_t nst_decode(uint16_t raw)
+{
+    /* Temperature is left-aligned, LSB = 0.0625C. Bit 0 set marks the
+       13-bit extended format (bits 15..3), otherwise 12 bits (15..4).
+       Either way the right-aligned value is already Q4. */
+    int16_t t;
+    if (raw & 0x0001u) {
+        t = (int16_t)(raw >> 3);
+        if (t & 0x1000) t |= (int16_t)0xE000; /* sign-extend from 13-bit */
+    } else {
+        t = (int16_t)(raw >> 4);
+        if (t & 0x0800) t |= (int16_t)0xF000; /* sign-extend from 12-bit */
+    }
+    return t;
+}
+
+/* NST112_Start(), the wait, NST112_Pending() and NST112_Collect() in one call */
+static uint8_t nst_read(uint8_t mask, int16_t *out_q4, int *rc)
+{
+    uint32_t wait = NST112_Start(mask, rc);
+
+    if (wait) Sleep_Ms(wait);
+    wait = NST112_Pending(rc);
+    if (wait) Sleep_Ms(wait);
+    return NST112_Collect(out_q4, rc);
+}
+
+void NST112_Configure(uint8_t rate, uint8_t extended)
+{
+    if (rate > NST112_RATE_8HZ) rate = NST112_RATE_ONESHOT;
+    extended = (extended == 1u);
+    if (rate != nst_rate || extended != nst_ext) {
+        nst_rate = rate;
+        nst_ext = extended;
+        nst_synced = 0u;
+    }
+}
+
+int NST112_SetAlert(uint8_t side, int16_t limit_q4)
+{
+    if (side != NST112_ALERT_HIGH && side != NST112_ALERT_LOW) {
+        side = NST112_ALERT_OFF;
+        limit_q4 = 0;
+    }
+    nst_select(nst_primary);
+    if (side != nst_alert || limit_q4 != nst_alert_q4) {
+        nst_alert = side;
+        nst_alert_q4 = limit_q4;
+        nst_synced &= (uint8_t)~(1u << nst_primary);
+    }
+    return (nst_synced & (1u << nst_primary)) ? 0 : nst_sync(0u);
+}
+
+uint32_t NST112_PeriodMs(void)
+{
+    static const uint16_t period_ms[4] = { 4000u, 1000u, 250u, 125u };
+    uint8_t rate = nst_rate;
+
+    if (rate == NST112_RATE_ONESHOT) {
+        if (nst_alert == NST112_ALERT_OFF) return 0u;
+        rate = NST112_RATE_0_25HZ;   /* the primary runs for its comparator */
+    }
+    return period_ms[rate - NST112_RATE_0_25HZ];
+}
+
+uint32_t NST112_WaitMs(void)
+{
+    return nst_wait_ms;
+}
 
-    *out_q4 = t12;
+uint8_t NST112_AlertActive(void)
+{
+    return (uint8_t)!LL_GPIO_IsInputPinSet(NST112_ALERT_PORT, NST112_ALERT_PIN);
+}
+
+/* ---------------- API ---------------- */
+
+void NST112_GPIO_Init(void)
+{
+#if NST112_USE_HW_I2C
+    if (!hw_failed) {
+        if (!hw_ready) hw_init();
+        return;
+    }
+#endif
+    if (!bb_ready) bb_init();
+}
+
+void NST112_Retime(void)
+{
+    bb_timing();
+#if NST112_USE_HW_I2C
+    if (hw_ready) hw_timing();
+#endif
+}
+
+uint8_t NST112_Scan(void)
+{
+    uint16_t raw;
+    uint8_t found = 0u;
+
+    for (uint8_t ch = 0u; ch < NST112_MAX_SENSORS; ch++) {
+        nst_select(ch);
+        if (read_reg16(NST112_REG_CONFIG, &raw) == 0) found |= (uint8_t)(1u << ch);
+    }
+    /* A sensor that was away may have been power cycled: configure it again */
+    nst_synced &= (uint8_t)(nst_present & found);
+    nst_present = found;
+
+    /* Keep the primary (and its ALERT setup) while it is still there */
+    if (!(found & (1u << nst_primary))) {
+        nst_primary = 0u;
+        if (found) {
+            while (!(found & (1u << nst_primary))) nst_primary++;
+        }
+        nst_synced &= (uint8_t)~(1u << nst_primary);
+    }
+    return found;
+}
+
+uint8_t NST112_Present(void)
+{
+    return nst_present ? nst_present : NST112_Scan();
+}
+
+uint8_t NST112_Primary(void)
+{
+    return nst_primary;
+}
+
+int NST112_ReadTempQ4(int16_t *out_q4)
+{
+    int16_t t[NST112_MAX_SENSORS];
+    int rc[NST112_MAX_SENSORS];
+
+    if (!out_q4) return 2;
+
+    if (!nst_read((uint8_t)(1u << nst_primary), t, rc)) return rc[nst_primary];
+    *out_q4 = t[nst_primary];
     return 0;
 }
+
+uint8_t NST112_ReadQ4(uint8_t mask, int16_t *out_q4, int *rc)
+{
+    if (!out_q4 || !rc) return 0u;
+    return nst_read(mask, out_q4, rc);
+}
+
+/* Every sensor is started first so their conversions overlap and a single
+ * wait covers all of them */
+uint32_t NST112_Start(uint8_t mask, int *rc)
+{
+    uint32_t wait = 0u;
+    uint8_t ch;
+
+    mask &= (uint8_t)((1u << NST112_MAX_SENSORS) - 1u);
+    nst_started_os = 0u;
+    for (ch = 0u; ch < NST112_MAX_SENSORS; ch++) {
+        uint8_t bit = (uint8_t)(1u << ch);
+
+        if (!(mask & bit)) continue;
+        nst_select(ch);
+        rc[ch] = 0;
+        if (nst_oneshot()) {
+            /* Shut down between samples: SD plus OS starts one conversion */
+            rc[ch] = nst_sync(NST112_CFG_OS);
+            if (rc[ch] == 0) {
+                nst_started_os |= bit;
+                if (wait < NST112_CONV_TYP_MS) wait = NST112_CONV_TYP_MS;
+            }
+        } else if (!(nst_synced & bit)) {
+            /* Leaving shutdown or changing rate: wait out the first conversion */
+            rc[ch] = nst_sync(0u);
+            if (rc[ch] == 0) wait = NST112_CONV_MAX_MS;
+        }
+        if (rc[ch] != 0) mask &= (uint8_t)~bit;
+    }
+    nst_started = mask;
+    nst_waited = wait;
+    nst_wait_ms += wait;
+    return wait;
+}
+
+uint32_t NST112_Pending(int *rc)
+{
+    uint16_t raw;
+
+    /* OS reads back 1 once a conversion is done; top up once if one is late */
+    for (uint8_t ch = 0u; ch < NST112_MAX_SENSORS && nst_waited < NST112_CONV_MAX_MS; ch++) {
+        uint8_t bit = (uint8_t)(1u << ch);
+
+        if (!(nst_started_os & nst_started & bit)) continue;
+        nst_select(ch);
+        rc[ch] = read_reg16(NST112_REG_CONFIG, &raw);
+        if (rc[ch] != 0) {
+            nst_started &= (uint8_t)~bit;
+        } else if (!(raw & NST112_CFG_OS)) {
+            uint32_t more = NST112_CONV_MAX_MS - nst_waited;
+
+            nst_waited = NST112_CONV_MAX_MS;
+            nst_wait_ms += more;
+            return more;
+        }
+    }
+    return 0u;
+}
+
+uint8_t NST112_Collect(int16_t *out_q4, int *rc)
+{
+    uint8_t got = 0u;
+    uint16_t raw;
+
+    for (uint8_t ch = 0u; ch < NST112_MAX_SENSORS; ch++) {
+        if (!(nst_started & (1u << ch))) continue;
+        nst_select(ch);
+        rc[ch] = read_reg16(NST112_REG_TEMP, &raw);
+        if (rc[ch] == 0) {
+            out_q4[ch] = nst_decode(raw);
+            got |= (uint8_t)(1u << ch);
+        }
+    }
+    nst_started = 0u;
+    return got;
+}
@@ -0,0 +1,148 @@
+#include "profile.h"
+#include "main.h"
+
+static ProfileSnapshot prof;
+static uint8_t  prof_mounted;
+static uint32_t prof_next;          /* first erased slot, PROFILE_SLOTS = sector full */
+static uint8_t  prof_open;          /* window running */
+static uint32_t prof_t0;            /* BSTIM count at Profile_Start() */
+static uint32_t prof_lap;           /* at the previous lap */
+
+static const char *const prof_names[PROFILE_PHASES] = {
+    "wake", "resume", "flash_init", "sensor_init", "sensor_read",
+    "rtc", "log_write", "supply", "ring_write", "led"
+};
+
+/* About 30k cycles over a snapshot: worth the CPU clock level */
+static uint16_t prof_crc(const ProfileSnapshot *s)
+{
+    uint8_t clk = Clock_Request(CLOCK_TASK_CPU);
+    uint16_t crc = Crc16_Ccitt((const uint8_t*)s, sizeof(*s) - 2u);
+
+    Clock_Restore(clk);
+    return crc;
+}
+
+static void prof_clear(void)
+{
+    memset(&prof, 0, sizeof(prof));
+    prof.reserved = 0xFFFFu;
+}
+
+void Profile_Mount(void)
+{
+    ProfileSnapshot s;
+
+    if (prof_mounted) return;
+    prof_clear();
+    if (!Flash_CheckID()) return;   /* start from zero, nothing saved this run */
+
+    for (prof_next = 0u; prof_next < PROFILE_SLOTS; prof_next++) {
+        Flash_ReadData(PROFILE_ADDRESS + prof_next * PROFILE_SLOT_SIZE, (uint8_t*)&s, sizeof(s));
+        if (s.seq == 0xFFFFFFFFu) break;
+        if (s.crc == prof_crc(&s)) {
+            prof = s;
+        }
+    }
+    prof_mounted = 1u;
+}
+
+static void prof_save(void)
+{
+    uint32_t addr;
+
+    if (!prof_mounted) return;   /* flash was not there at boot */
+
+    prof.seq++;
+    prof.crc = prof_crc(&prof);
+    if (prof_next >= PROFILE_SLOTS) {
+        Flash_SectorErase(PROFILE_ADDRESS);
+        prof_next = 0u;
+    }
+    /* Slots are page aligned: two page programs */
+    addr = PROFILE_ADDRESS + prof_next * PROFILE_SLOT_SIZE;
+    Flash_PageProgram(addr, (uint8_t*)&prof, 256u);
+    Flash_PageProgram(addr + 256u, (uint8_t*)&prof + 256u, (uint16_t)(sizeof(prof) - 256u));
+    prof_next++;
+}
+
+static void prof_add(uint8_t phase, uint32_t ticks)
+{
+    ProfilePhase *p = &prof.phase[phase];
+    uint8_t bin = 0u;
+
+    while (bin < PROFILE_BINS - 1u && (ticks >> bin) != 0u) bin++;
+
+    p->count++;
+    p->sum += ticks;
+    if (p->count == 1u || ticks < p->min) p->min = ticks;
+    if (ticks > p->max) p->max = ticks;
+    if (p->hist[bin] != 0xFFFFu) p->hist[bin]++;
+}
+
+void Profile_Start(void)
+{
+    /* On the PLL, USBInit() runs BSTIM as the 1 ms tick; it redoes that setup */
+    if (LL_RCC_GetSystemClockSource() == LL_RCC_SYSTEM_CLKSOURCE_PLL) return;
+
+    LL_RCC_Group4_EnableBusClock(LL_RCC_BUS4_CLOCK_BTIM);
+    LL_RCC_SetBSTIMClockSource(LL_RCC_BSTIM_OPERATION_CLK_SOURCE_LSCLK);
+    LL_RCC_Group2_EnableOperationClock(LL_RCC_OPERATION2_CLOCK_BSTIM);
+    LL_BSTIM_SetCounterPsc(BSTIM, 0u);
+    LL_BSTIM_SetCounterAutoReloadValue(BSTIM, 0xFFFFFFFFu);   /* 32-bit, wraps after 36 h */
+    LL_BSTIM_EnableAutoReload(BSTIM);
+    LL_BSTIM_DisableIT_UpdataEvent(BSTIM);
+    LL_BSTIM_GenerateEvent_UPDATE(BSTIM);
+    LL_BSTIM_ClearFlag_UpdataEvent(BSTIM);
+    LL_BSTIM_EnableCounter(BSTIM);
+
+    prof_t0 = LL_BSTIM_GetCounterCnt(BSTIM);
+    prof_lap = prof_t0;
+    prof_open = 1u;
+}
+
+void Profile_Lap(uint8_t phase)
+{
+    uint32_t now;
+
+    if (!prof_open || phase >= PROFILE_PHASES) return;
+    now = LL_BSTIM_GetCounterCnt(BSTIM);
+    prof_add(phase, now - prof_lap);
+    prof_lap = now;
+}
+
+void Profile_Cancel(void)
+{
+    if (!prof_open) return;
+    prof_open = 0u;
+    LL_BSTIM_DisableCounter(BSTIM);
+    LL_RCC_Group2_DisableOperationClock(LL_RCC_OPERATION2_CLOCK_BSTIM);
+    LL_RCC_Group4_DisableBusClock(LL_RCC_BUS4_CLOCK_BTIM);
+}
+
+void Profile_Stop(void)
+{
+    if (!prof_open) return;
+    prof_add(PROFILE_WAKE, LL_BSTIM_GetCounterCnt(BSTIM) - prof_t0);
+    Profile_Cancel();
+
+    prof.windows++;
+    if ((prof.windows % PROFILE_SAVE_EVERY) == 0u) {
+        prof_save();
+    }
+}
+
+const ProfileSnapshot *Profile_Get(void)
+{
+    return &prof;
+}
+
+const char *Profile_Name(uint8_t phase)
+{
+    return (phase < PROFILE_PHASES) ? prof_names[phase] : "?";
+}
+
+uint32_t Profile_Us(uint32_t ticks)
+{
+    return (uint32_t)(((uint64_t)ticks * 15625u) >> 9);   /* * 10^6 / 32768 */
+}
@@ -0,0 +1,98 @@
+#include "rtc_cal.h"
+#include "main.h"
+
+static RtcCalEntry cal_last;        /* newest entry, zeroed until one exists */
+static uint8_t     cal_mounted;
+static uint32_t    cal_next;        /* first erased entry, RTC_CAL_ENTRIES = sector full */
+
+/* Same bus clock handling as MF_Clock_Init() */
+static void cal_program(int32_t ppb)
+{
+    uint32_t lsb = (uint32_t)(((ppb < 0) ? -ppb : ppb) + RTC_CAL_PPB_PER_LSB / 2) / RTC_CAL_PPB_PER_LSB;
+
+    if (lsb > 511u) lsb = 511u;
+    LL_RCC_Group1_EnableBusClock(LL_RCC_BUS1_CLOCK_RTC);
+    LL_RTC_SetAdjustDirect(RTC, (ppb > 0) ? LL_RTC_ADJUST_DIR_REDUCE : LL_RTC_ADJUST_DIR_INCREASE);
+    LL_RTC_SetAdjustVel(RTC, lsb);
+    LL_RCC_Group1_DisableBusClock(LL_RCC_BUS1_CLOCK_RTC);
+}
+
+void RtcCal_Mount(void)
+{
+    RtcCalEntry e;
+
+    if (cal_mounted) return;
+    if (!Flash_CheckID()) return;   /* no trim, retry next time */
+
+    memset(&cal_last, 0, sizeof(cal_last));
+    for (cal_next = 0u; cal_next < RTC_CAL_ENTRIES; cal_next++) {
+        Flash_ReadData(RTC_CAL_ADDRESS + cal_next * RTC_CAL_ENTRY_SIZE, (uint8_t*)&e, sizeof(e));
+        if (e.time == 0xFFFFFFFFu) break;
+        if (e.crc == Crc16_Ccitt((const uint8_t*)&e, sizeof(e) - 2u)) {
+            cal_last = e;
+        }
+    }
+    cal_mounted = 1u;
+    cal_program(cal_last.ppb);
+}
+
+void RtcCal_ClockSet(uint32_t old_time, uint32_t new_time, uint8_t precise)
+{
+    RtcCalEntry e;
+
+    RtcCal_Mount();
+    if (!cal_mounted) return;
+
+    memset(&e, 0xFF, sizeof(e));
+    e.time        = new_time;
+    e.error_s     = (int32_t)(old_time - new_time);
+    e.ref_time    = new_time;
+    e.acc_error_s = 0;
+    e.ppb         = cal_last.ppb;
+    e.learned     = cal_last.learned;
+    e.flags       = precise ? RTC_CAL_REF : 0u;
+
+    /* Drift left over on top of the trim, over the span since the reference */
+    if (precise && (cal_last.flags & RTC_CAL_REF) && new_time > cal_last.ref_time) {
+        uint32_t span = new_time - cal_last.ref_time;
+        int32_t err = cal_last.acc_error_s + e.error_s;
+        int32_t resid = (int32_t)(((int64_t)err * 1000000000LL) / (int64_t)span);
+
+        /* Out of range: the clock was reset in between (reflash), start over */
+        if (resid > -RTC_CAL_MAX_RESID_PPB && resid < RTC_CAL_MAX_RESID_PPB) {
+            if (span < RTC_CAL_MIN_SPAN_S) {
+                e.ref_time    = cal_last.ref_time;
+                e.acc_error_s = err;
+            } else {
+                uint32_t w = (span < RTC_CAL_FULL_SPAN_S) ? span : RTC_CAL_FULL_SPAN_S;
+                int32_t ppb = e.ppb + (int32_t)(((int64_t)resid * w) / RTC_CAL_FULL_SPAN_S);
+
+                if (ppb > RTC_CAL_MAX_PPB) ppb = RTC_CAL_MAX_PPB;
+                if (ppb < -RTC_CAL_MAX_PPB) ppb = -RTC_CAL_MAX_PPB;
+                e.ppb = ppb;
+                e.flags |= RTC_CAL_LEARNED;
+                if (e.learned < 0xFFu) e.learned++;
+            }
+        }
+    }
+    e.crc = Crc16_Ccitt((const uint8_t*)&e, sizeof(e) - 2u);
+
+    if (cal_next >= RTC_CAL_ENTRIES) {
+        Flash_SectorErase(RTC_CAL_ADDRESS);
+        cal_next = 0u;
+    }
+    Flash_PageProgram(RTC_CAL_ADDRESS + cal_next * RTC_CAL_ENTRY_SIZE, (uint8_t*)&e, sizeof(e));
+    cal_next++;
+    cal_last = e;
+    cal_program(e.ppb);
+}
+
+int32_t RtcCal_TrimPpb(void)
+{
+    return cal_last.ppb;
+}
+
+uint8_t RtcCal_Learned(void)
+{
+    return cal_last.learned;
+}
@@ -0,0 +1,231 @@
+#include "sampler.h"
+#include "main.h"
+
+#define SMP_IDLE        0u
+#define SMP_SETUP       1u      /* flash release, bus, config */
+#define SMP_NEXT        2u      /* next conversion round, after the burst gap */
+#define SMP_START       3u      /* start it; the first also reads the RTC, the last starts the erase */
+#define SMP_READ        4u      /* conversion waited out: read it */
+#define SMP_FILTER      5u      /* burst done: median, IIR */
+#define SMP_COMMIT      6u      /* erase done: text log, records, supply, LED */
+
+static uint8_t smp_state;
+static SamplerDone smp_done;
+static uint8_t smp_chans;       /* channels sampled */
+static uint8_t smp_prim;
+static uint8_t smp_mask;        /* converting this round */
+static uint8_t smp_first;       /* first round not started yet */
+static uint8_t smp_prepared;    /* Flash_Ring5_Prepare() tried */
+static uint8_t smp_ring;        /* text log sector read and erasing */
+static uint8_t smp_got;
+static uint32_t smp_now;        /* RTC */
+static int16_t smp_t[NST112_MAX_SENSORS];
+static int32_t smp_q8[NST112_MAX_SENSORS];
+static int smp_rc[NST112_MAX_SENSORS];
+
+/* The 5-line text file follows the primary sensor */
+static uint32_t smp_line(char *line)
+{
+    unsigned int yy;
+    unsigned char mon, day;
+    uint32_t sod = smp_now % 86400u;
+
+    if (smp_got & (1u << smp_prim)) {
+        return Flash_FormatTemperatureWithDate_Q4(line, (int16_t)(smp_q8[smp_prim] >> 4), smp_now);
+    }
+    /* Error reading sensor: append diagnostics into the ring log */
+    RTC_DaysToDate(smp_now / 86400u, &yy, &mon, &day);
+    (void)sprintf(line, "20%02u-%02u-%02u %02lu:%02lu:%02lu  NST112 error, rc=%d\r\n",
+        yy, mon, day, (unsigned long)(sod / 3600u), (unsigned long)((sod / 60u) % 60u),
+        (unsigned long)(sod % 60u), smp_rc[smp_prim]);
+    return (uint32_t)strlen(line);
+}
+
+static void smp_records(void)
+{
+    const DevConfig *cfg = Config_Get();
+
+    for (uint8_t ch = 0u; ch < NST112_MAX_SENSORS; ch++) {
+        if (!(smp_chans & (1u << ch))) continue;
+        if (smp_got & (1u << ch)) {
+            int16_t t_q4 = (int16_t)(smp_q8[ch] >> 4);
+
+            (void)LogStore_Append(LOG_REC_TEMP, ch, t_q4, (uint16_t)(smp_q8[ch] & 0x0F));
+            if (t_q4 > cfg->alarm_hi_q4) {
+                (void)LogStore_Append(LOG_REC_ALARM, ch, t_q4, LOG_ALARM_HIGH);
+            } else if (t_q4 < cfg->alarm_lo_q4) {
+                (void)LogStore_Append(LOG_REC_ALARM, ch, t_q4, LOG_ALARM_LOW);
+            }
+        } else {
+            (void)LogStore_Append(LOG_REC_SENSOR_ERR, ch, 0, (uint16_t)smp_rc[ch]);
+        }
+    }
+}
+
+/* One step; returns the ms to wait before the next (0: go on now) */
+static uint32_t smp_step(void)
+{
+    const DevConfig *cfg;
+    char *line;
+    uint32_t ms, mark;
+    uint8_t ok = 0u;
+
+    switch (smp_state)
+    {
+        case SMP_SETUP:
+            Flash_Init();
+            Flash_Wake();   /* no command for FLASH_RES_US: the sensor start goes first */
+            Profile_Lap(PROFILE_FLASH_INIT);
+
+            NST112_GPIO_Init(); // init nst112 sensor pins for Temperature
+            Config_Mount();
+            cfg = Config_Get();
+            NST112_Configure(cfg->sensor_rate, cfg->sensor_ext);
+
+            /* Every sensor found on the bus; none: try the primary to log why */
+            smp_chans = NST112_Present();
+            smp_prim = NST112_Primary();
+            if (smp_chans == 0u) smp_chans = (uint8_t)(1u << smp_prim);
+            TempAcq_Begin(smp_chans, cfg->acq_burst, cfg->acq_iir_shift);
+            smp_first = 1u;
+            smp_prepared = 0u;
+            Profile_Lap(PROFILE_SENSOR_INIT);
+            smp_state = SMP_NEXT;
+            return 0u;
+
+        case SMP_NEXT:
+            smp_mask = TempAcq_Next(&ms);
+            smp_state = smp_mask ? SMP_START : SMP_FILTER;
+            return ms;
+
+        case SMP_START:
+            ms = NST112_Start(smp_mask, smp_rc);
+            smp_state = SMP_READ;
+            if (smp_first) {
+                smp_first = 0u;
+                Profile_Lap(PROFILE_SENSOR_READ);
+
+                /* While the sensors convert */
+                (void)RTC_SimpleInit_IfNeeded();
+                smp_now = RTC_ReadEpoch2000();
+                Profile_Lap(PROFILE_RTC);
+            }
+            if (TempAcq_Last()) {
+                /* From the erase to the commit the old lines are only in
+                 * RAM: overlap it with the last conversion, not the burst */
+                smp_ring = Flash_Ring5_Prepare();
+                smp_prepared = 1u;
+                Profile_Lap(PROFILE_RING_WRITE);
+            }
+            return ms;
+
+        case SMP_READ:
+            ms = NST112_Pending(smp_rc);
+            if (ms != 0u) return ms;
+            TempAcq_Add(NST112_Collect(smp_t, smp_rc), smp_t);
+            smp_state = SMP_NEXT;
+            return 0u;
+
+        case SMP_FILTER:
+            if (!smp_prepared) {
+                /* Every channel failed before the last round */
+                smp_ring = Flash_Ring5_Prepare();
+                smp_prepared = 1u;
+            }
+            smp_got = TempAcq_End(smp_q8);
+            Profile_Lap(PROFILE_SENSOR_READ);
+            smp_state = SMP_COMMIT;
+            return 0u;
+
+        case SMP_COMMIT:
+            /* The erase ran under the conversions; poll what is left from sleep */
+            if (smp_ring && Flash_Busy()) return FLASH_ERASE_POLL_MS;
+
+            if (smp_ring) {
+                mark = Arena_Mark();
+                line = (char*)Arena_Alloc(FLASH_LINE_MAX);   /* NULL: the old lines go back */
+                ok = Flash_Ring5_Commit(line, line ? smp_line(line) : 0u);
+                Arena_Release(mark);
+            }
+            smp_ring = 0u;
+            Profile_Lap(PROFILE_RING_WRITE);
+
+            smp_records();
+            Profile_Lap(PROFILE_LOG_WRITE);
+
+            Supply_Sample();   /* VDD and MCU temperature every SUPPLY_EVERY_N samples */
+            Profile_Lap(PROFILE_SUPPLY);
+
+            /* Played from LPTIM while the core sleeps */
+            Led_Play((smp_got == smp_chans) ? LED_PAT_OK : LED_PAT_ERROR);
+            Profile_Lap(PROFILE_LED);
+
+            smp_state = SMP_IDLE;
+            if (smp_done) smp_done(ok);
+            return 0u;
+
+        default:
+            smp_state = SMP_IDLE;
+            return 0u;
+    }
+}
+
+/* Sensor waits and flash writes: the IO clock level for each step (no-op on USB) */
+static uint32_t smp_run(void)
+{
+    uint8_t clk = Clock_Request(CLOCK_TASK_IO);
+    uint32_t ms = smp_step();
+
+    Clock_Restore(clk);
+    return ms;
+}
+
+static void smp_continue(void)
+{
+    uint32_t ms = 0u;
+
+    while (smp_state != SMP_IDLE && (ms = smp_run()) == 0u) {
+    }
+    if (smp_state != SMP_IDLE) {
+        Sched_After(SCHED_TASK_SAMPLER, ms);
+    }
+}
+
+uint8_t Sampler_Start(SamplerDone done)
+{
+    if (smp_state != SMP_IDLE) return 0u;
+    smp_done = done;
+    smp_state = SMP_SETUP;
+    smp_continue();
+    return 1u;
+}
+
+void Sampler_Task(uint8_t arg)
+{
+    (void)arg;
+    smp_continue();
+}
+
+uint8_t Sampler_Busy(void)
+{
+    return (uint8_t)(smp_state != SMP_IDLE);
+}
+
+void Sampler_Abort(void)
+{
+    Sched_Cancel(SCHED_TASK_SAMPLER);
+    if (smp_state == SMP_IDLE) return;
+    if (smp_ring) (void)Flash_Ring5_Commit(NULL, 0u);   /* waits out the erase */
+    smp_ring = 0u;
+    smp_state = SMP_IDLE;
+}
+
+void Sampler_Finish(void)
+{
+    Sched_Cancel(SCHED_TASK_SAMPLER);
+    while (smp_state != SMP_IDLE) {
+        uint32_t ms = smp_run();
+
+        if (ms != 0u) DelayMs(ms, DELAY_COARSE);
+    }
+}
@@ -0,0 +1,151 @@
+#include "sched.h"
+#include <string.h>
+
+typedef struct {
+    volatile uint8_t task[SCHED_QUEUE_LEN];
+    volatile uint8_t arg[SCHED_QUEUE_LEN];
+    volatile uint8_t head;          /* written by the producer only */
+    volatile uint8_t tail;          /* written by Sched_Dispatch() only */
+} SchedQueue;
+
+static SchedQueue sched_q[SCHED_LEVELS];
+static SchedHandler sched_handler[SCHED_TASKS];
+static volatile uint8_t sched_signal[SCHED_TASKS];
+static uint8_t  sched_armed[SCHED_TASKS];
+static uint32_t sched_due[SCHED_TASKS];
+static uint32_t (*sched_clock)(void);
+static SchedStats sched_stats;
+
+void Sched_Init(uint32_t (*clock)(void))
+{
+    for (uint8_t i = 0u; i < SCHED_LEVELS; i++) {
+        sched_q[i].head = 0u;
+        sched_q[i].tail = 0u;
+    }
+    for (uint8_t t = 0u; t < SCHED_TASKS; t++) {
+        sched_handler[t] = 0;
+        sched_signal[t] = 0u;
+        sched_armed[t] = 0u;
+    }
+    sched_clock = clock;
+    memset(&sched_stats, 0, sizeof(sched_stats));
+}
+
+void Sched_SetTask(uint8_t task, SchedHandler handler)
+{
+    if (task < SCHED_TASKS) sched_handler[task] = handler;
+}
+
+uint8_t Sched_Post(uint8_t level, uint8_t task, uint8_t arg)
+{
+    SchedQueue *q = &sched_q[level];
+    uint8_t head = q->head;
+    uint8_t used = (uint8_t)(head - q->tail);
+
+    if (used >= SCHED_QUEUE_LEN) {
+        sched_stats.dropped[level]++;
+        return 0u;
+    }
+    /* Slot first, then publish it by moving head */
+    q->task[head & (SCHED_QUEUE_LEN - 1u)] = task;
+    q->arg[head & (SCHED_QUEUE_LEN - 1u)] = arg;
+    q->head = (uint8_t)(head + 1u);
+
+    if (used + 1u > sched_stats.high_water[level]) sched_stats.high_water[level] = (uint8_t)(used + 1u);
+    sched_stats.posted[level]++;
+    return 1u;
+}
+
+void Sched_Signal(uint8_t task)
+{
+    if (task < SCHED_TASKS) sched_signal[task] = 1u;
+}
+
+void Sched_After(uint8_t task, uint32_t ms)
+{
+    if (task >= SCHED_TASKS) return;
+    sched_due[task] = sched_clock() + ms;
+    sched_armed[task] = 1u;
+}
+
+void Sched_Cancel(uint8_t task)
+{
+    if (task < SCHED_TASKS) sched_armed[task] = 0u;
+}
+
+uint8_t Sched_Pending(void)
+{
+    for (uint8_t i = 0u; i < SCHED_LEVELS; i++) {
+        if (sched_q[i].head != sched_q[i].tail) return 1u;
+    }
+    for (uint8_t t = 0u; t < SCHED_TASKS; t++) {
+        if (sched_signal[t]) return 1u;
+    }
+    return 0u;
+}
+
+static void sched_run(uint8_t task, uint8_t arg)
+{
+    sched_stats.dispatched++;
+    if (task < SCHED_TASKS && sched_handler[task]) sched_handler[task](arg);
+}
+
+/* One ready item, highest level first; 0 if there was none */
+static uint8_t sched_step(void)
+{
+    uint32_t now;
+
+    for (uint8_t i = 0u; i < SCHED_LEVELS; i++) {
+        SchedQueue *q = &sched_q[i];
+        uint8_t tail = q->tail;
+
+        if (q->head != tail) {
+            uint8_t task = q->task[tail & (SCHED_QUEUE_LEN - 1u)];
+            uint8_t arg = q->arg[tail & (SCHED_QUEUE_LEN - 1u)];
+
+            q->tail = (uint8_t)(tail + 1u);   /* slot free before the handler posts again */
+            sched_run(task, arg);
+            return 1u;
+        }
+    }
+    for (uint8_t t = 0u; t < SCHED_TASKS; t++) {
+        if (sched_signal[t]) {
+            sched_signal[t] = 0u;   /* cleared first: a signal during the run is kept */
+            sched_run(t, SCHED_ARG_SIGNAL);
+            return 1u;
+        }
+    }
+    now = sched_clock();
+    for (uint8_t t = 0u; t < SCHED_TASKS; t++) {
+        if (sched_armed[t] && (int32_t)(sched_due[t] - now) <= 0) {
+            sched_armed[t] = 0u;
+            sched_run(t, SCHED_ARG_TIMER);
+            return 1u;
+        }
+    }
+    return 0u;
+}
+
+uint32_t Sched_Dispatch(void)
+{
+    uint32_t now, wait = SCHED_FOREVER;
+
+    while (sched_step()) {
+    }
+    if (Sched_Pending()) return 0u;   /* posted since the last step */
+
+    now = sched_clock();
+    for (uint8_t t = 0u; t < SCHED_TASKS; t++) {
+        if (sched_armed[t]) {
+            int32_t left = (int32_t)(sched_due[t] - now);
+            uint32_t ms = (left > 0) ? (uint32_t)left : 0u;
+            if (ms < wait) wait = ms;
+        }
+    }
+    return wait;
+}
+
+const SchedStats *Sched_Stats(void)
+{
+    return &sched_stats;
+}
@@ -43,7 +43,37 @@ void FlashGpio_init(void)
 }
 
 
+#define FLASH_READY       0u
+#define FLASH_DPD         1u      /* deep power-down: only 0xAB is heard */
+#define FLASH_ERASING     2u      /* Flash_SectorEraseStart() not seen finished */
+
+static uint8_t flash_spi_ready;   /* FlashSpi_init() ran: SPI2 is clocked */
+static uint8_t flash_state;
+
+/* One command byte, optionally followed by one byte read back */
+static uint8_t flash_cmd_raw(uint8_t cmd, uint8_t read)
+{
+    uint8_t r = 0u;
+
+    LL_GPIO_ResetOutputPin(FLASH_CS_PORT, FLASH_CS_PIN);
+    (void)SPI_TransmitReceive(cmd);
+    if (read) r = SPI_TransmitReceive(0x00);
+    LL_GPIO_SetOutputPin(FLASH_CS_PORT, FLASH_CS_PIN);
+    return r;
+}
+
+/* Every command starts here: a chip left in power-down or erasing is
+ * brought back first, so callers that do not know about either still work */
 void Flash_CS_Low(void) {
+    if (flash_state == FLASH_DPD) {
+        (void)flash_cmd_raw(CMD_RELEASE_POWER_DOWN, 0u);
+        flash_state = FLASH_READY;
+        DelayUs(FLASH_RES_US);
+    } else if (flash_state == FLASH_ERASING) {
+        while (Flash_Busy()) {
+            DelayMs(FLASH_ERASE_POLL_MS, DELAY_COARSE);
+        }
+    }
     LL_GPIO_ResetOutputPin(FLASH_CS_PORT, FLASH_CS_PIN);
 }
 
@@ -51,6 +81,22 @@ void Flash_CS_High(void) {
     LL_GPIO_SetOutputPin(FLASH_CS_PORT, FLASH_CS_PIN);
 }
 
+static uint32_t flash_spi_baud(void)
+{
+    uint32_t apb1 = LL_RCC_GetAPB1ClockFreq(LL_RCC_GetAHBClockFreq(LL_RCC_GetSystemClockFreq()));
+    uint32_t div = 0u;   /* SCK = APB1 / 2^(div + 1) */
+
+    while (div < 7u && (apb1 >> (div + 1u)) > FLASH_SPI_MAX_HZ) div++;
+    return div << SPI_CR1_BAUD_Pos;
+}
+
+void FlashSpi_Retime(void)
+{
+    if (flash_spi_ready) {
+        LL_SPI_SetBaudrate(SPI2, flash_spi_baud());
+    }
+}
+
 void FlashSpi_init(void)
 {
 		LL_SPI_InitTypeDef SPI_InitStruct;
@@ -65,7 +111,7 @@ void FlashSpi_init(void)
     SPI_InitStruct.DataWidth = LL_SPI_DATAWIDTH_8BIT;        // 8-bit sending
     SPI_InitStruct.ClockPolarity = LL_SPI_SPI_POLARITY_LOW;  // CPOL = 0
     SPI_InitStruct.ClockPhase = LL_SPI_SPI_PHASE_1EDGE;         // CPHA = 0 
-    SPI_InitStruct.BaudRate = LL_SPI_BAUDRATEPRESCALER_DIV8;
+    SPI_InitStruct.BaudRate = flash_spi_baud();
     SPI_InitStruct.BitOrder = LL_SPI_BIT_ORDER_MSB_FIRST;
     
     SPI_InitStruct.SSN = 0; // enable CS
@@ -83,6 +129,16 @@ void FlashSpi_init(void)
     // clear buffers
     LL_SPI_TxBuffClear(SPI2);
     LL_SPI_RxBuffClear(SPI2);
+    flash_spi_ready = 1u;
+}
+
+void Flash_Init(void)
+{
+    /* Pins and SPI2 keep their setup through DeepSleep, clock changes retime SPI2 */
+    if (flash_spi_ready) return;
+    FlashGpio_init();
+    FlashSpi_init();
+    Flash_CS_High();
 }
 
 uint8_t SPI_TransmitReceive(uint8_t data)
@@ -134,7 +190,7 @@ void Flash_WriteEnable(void) {
     Flash_CS_High();
 }
 
-void Flash_SectorErase(uint32_t address) {
+void Flash_SectorEraseStart(uint32_t address) {
     // Write enable
     Flash_WriteEnable();
     Flash_WaitForReady();
@@ -146,9 +202,36 @@ void Flash_SectorErase(uint32_t address) {
     SPI_TransmitReceive((address >> 8) & 0xFF);   // addr byte 1
     SPI_TransmitReceive(address & 0xFF);          // addr byte 0
     Flash_CS_High();
+    flash_state = FLASH_ERASING;
+}
+
+uint8_t Flash_Busy(void) {
+    if (flash_state == FLASH_DPD) return 0;
+    if (flash_cmd_raw(CMD_READ_STATUS, 1u) & STATUS_BUSY) return 1;
+    flash_state = FLASH_READY;
+    return 0;
+}
+
+void Flash_SectorErase(uint32_t address) {
+    Flash_SectorEraseStart(address);
     
-    // wait erase ending
+    // wait erase ending: tens of ms, poll from sleep
+    while (Flash_Busy()) {
+        DelayMs(FLASH_ERASE_POLL_MS, DELAY_COARSE);
+    }
+}
+
+void Flash_PowerDown(void) {
+    if (!flash_spi_ready || flash_state == FLASH_DPD) return;
     Flash_WaitForReady();
+    (void)flash_cmd_raw(CMD_POWER_DOWN, 0u);
+    flash_state = FLASH_DPD;
+}
+
+void Flash_Wake(void) {
+    if (flash_state != FLASH_DPD) return;
+    (void)flash_cmd_raw(CMD_RELEASE_POWER_DOWN, 0u);
+    flash_state = FLASH_READY;
 }
 
 void Flash_PageProgram(uint32_t address, uint8_t *data, uint16_t size) {
@@ -211,10 +294,15 @@ uint32_t Flash_ReadID(void) {
 
 // check Flash ID (for P25Q16SH expected 0x856015)
 uint8_t Flash_CheckID(void) {
-    uint32_t id = Flash_ReadID();
+    static uint8_t id_ok;   /* the chip does not go away: probe until it answers once */
+    uint32_t id;
+
+    if (id_ok) return 1;
+    id = Flash_ReadID();
     
     // check ID P25Q16SH
     if((id >> 16) == 0x85) {  // Manufacturer ID (Puya)
+        id_ok = 1u;
         return 1;
     }
     return 0;
@@ -240,29 +328,37 @@ uint8_t WriteFileToFlash(void)
     return 2;
 }
 
-uint8_t Flash_WriteFileEntry(const char *filename, const uint8_t *data, uint32_t size)
+static void file_entry_fill(FileEntry *fe, const char *filename, const uint8_t *data, uint32_t size)
 {
-    if (!Flash_CheckID()) return 0;
-
-    FileEntry fe;
-    memset(&fe, 0, sizeof(fe));
+    memset(fe, 0, sizeof(*fe));
 
     if (filename && filename[0] != '\0') {
-        strncpy(fe.filename, filename, sizeof(fe.filename) - 1);
+        strncpy(fe->filename, filename, sizeof(fe->filename) - 1);
     } else {
-        strncpy(fe.filename, FILE_NAME, sizeof(fe.filename) - 1);
+        strncpy(fe->filename, FILE_NAME, sizeof(fe->filename) - 1);
     }
 
-    if (size > sizeof(fe.data)) size = sizeof(fe.data);
-    fe.size = size;
-    fe.timestamp = 0;
+    if (size > sizeof(fe->data)) size = sizeof(fe->data);
+    fe->size = size;
+    fe->timestamp = 0;
 
     if (data && size) {
-        memcpy(fe.data, data, size);
+        memcpy(fe->data, data, size);
     }
+}
+
+uint8_t Flash_WriteFileEntry(const char *filename, const uint8_t *data, uint32_t size)
+{
+    if (!Flash_CheckID()) return 0;
+
+    uint32_t mark = Arena_Mark();
+    FileEntry *fe = (FileEntry*)Arena_Alloc(sizeof(FileEntry));
+    if (!fe) return 0;
+    file_entry_fill(fe, filename, data, size);
 
     Flash_SectorErase(FILE_ADDRESS);
-    Flash_WriteBytes(FILE_ADDRESS, (const uint8_t*)&fe, (uint32_t)sizeof(fe));
+    Flash_WriteBytes(FILE_ADDRESS, (const uint8_t*)fe, (uint32_t)sizeof(*fe));
+    Arena_Release(mark);
     return 1;
 }
 
@@ -279,23 +375,42 @@ static int fileentry_valid_local(const FileEntry *fe)
     return 1;
 }
 
-uint8_t Flash_LogLine_Ring5(const char *line, uint32_t size)
+/* Deepest scratch: a caller's line, the old entry held from Prepare, the new one in Commit */
+ARENA_CHECK(ring5_scratch, ARENA_ROUND(FLASH_LINE_MAX) + 2u * ARENA_ROUND(sizeof(FileEntry)) <= ARENA_SCRATCH_BYTES);
+
+static FileEntry *ring_old;    /* arena, Flash_Ring5_Prepare() to Flash_Ring5_Commit() */
+static uint32_t ring_mark;
+static uint8_t ring_prepared;
+
+uint8_t Flash_Ring5_Prepare(void)
 {
+    ring_prepared = 0u;
     if (!Flash_CheckID()) return 0;
-    if (!line || size == 0u) return 0;
 
-    if (size > sizeof(((FileEntry*)0)->data)) size = sizeof(((FileEntry*)0)->data);
+    ring_mark = Arena_Mark();
+    ring_old = (FileEntry*)Arena_Alloc(sizeof(FileEntry));
+    if (!ring_old) return 0;
+    memset(ring_old, 0, sizeof(*ring_old));
+    Flash_ReadData(FILE_ADDRESS, (uint8_t*)ring_old, (uint32_t)sizeof(*ring_old));
+    Flash_SectorEraseStart(FILE_ADDRESS);
+    ring_prepared = 1u;
+    return 1;
+}
+
+uint8_t Flash_Ring5_Commit(const char *line, uint32_t size)
+{
+    if (!ring_prepared) return 0;
+    ring_prepared = 0u;
+    if (!line) size = 0u;   /* the sector is erased already: write the old lines back */
 
-    FileEntry fe_old;
-    memset(&fe_old, 0, sizeof(fe_old));
-    Flash_ReadData(FILE_ADDRESS, (uint8_t*)&fe_old, (uint32_t)sizeof(fe_old));
+    if (size > sizeof(ring_old->data)) size = sizeof(ring_old->data);
 
     const uint8_t *old = NULL;
     uint32_t old_len = 0u;
-    if (fileentry_valid_local(&fe_old)) {
-        old = (const uint8_t*)fe_old.data;
-        old_len = fe_old.size;
-        if (old_len > sizeof(fe_old.data)) old_len = sizeof(fe_old.data);
+    if (fileentry_valid_local(ring_old)) {
+        old = (const uint8_t*)ring_old->data;
+        old_len = ring_old->size;
+        if (old_len > sizeof(ring_old->data)) old_len = sizeof(ring_old->data);
     }
 
     uint32_t starts[LOG_RING_LINES];
@@ -319,28 +434,42 @@ uint8_t Flash_LogLine_Ring5(const char *line, uint32_t size)
         }
     }
 
-    uint8_t out[256];
-    memset(out, 0, sizeof(out));
-    uint32_t out_len = 0u;
-
-    uint32_t copy_new = size;
-    if (copy_new > sizeof(out)) copy_new = sizeof(out);
-    memcpy(out, line, copy_new);
-    out_len = copy_new;
+    /* Built in place in the new entry: no separate text buffer */
+    FileEntry *fe = (FileEntry*)Arena_Alloc(sizeof(FileEntry));
+    if (!fe) {
+        Arena_Release(ring_mark);
+        return 0;
+    }
+    file_entry_fill(fe, FILE_NAME, (const uint8_t*)line, size);
+    uint32_t out_len = size;
 
     /* Append up to 4 previous lines (newest-first already in file). */
     for (uint32_t i = 0u; i < nlines && i < (LOG_RING_LINES - 1u); i++) {
-        if (out_len + lens[i] > sizeof(out)) break;
-        memcpy(&out[out_len], &old[starts[i]], lens[i]);
+        if (out_len + lens[i] > sizeof(fe->data)) break;
+        memcpy(&fe->data[out_len], &old[starts[i]], lens[i]);
         out_len += lens[i];
     }
+    fe->size = out_len;
 
-    return Flash_WriteFileEntry(FILE_NAME, out, out_len);
+    Flash_WriteBytes(FILE_ADDRESS, (const uint8_t*)fe, (uint32_t)sizeof(*fe));   /* waits out the erase */
+    Arena_Release(ring_mark);
+    return 1;
+}
+
+uint8_t Flash_LogLine_Ring5(const char *line, uint32_t size)
+{
+    if (!line || size == 0u) return 0;
+    if (!Flash_Ring5_Prepare()) return 0;
+    return Flash_Ring5_Commit(line, size);
 }
 
 uint8_t Flash_LogTemperatureWithTime_Ring5_Q4(int16_t temp_q4, uint8_t hh, uint8_t mm, uint8_t ss)
 {
-    char buf[96];
+    uint32_t mark = Arena_Mark();
+    char *buf = (char*)Arena_Alloc(FLASH_LINE_MAX);
+    uint8_t ok;
+
+    if (!buf) return 0;
 
     int sign = (temp_q4 < 0);
     int16_t a = (int16_t)(sign ? -temp_q4 : temp_q4);
@@ -354,7 +483,37 @@ uint8_t Flash_LogTemperatureWithTime_Ring5_Q4(int16_t temp_q4, uint8_t hh, uint8
         (void)sprintf(buf, "%02u:%02u:%02u  Temperature: %d.%04d C\r\n", hh, mm, ss, whole, frac_4d);
     }
 
-    return Flash_LogLine_Ring5(buf, (uint32_t)strlen(buf));
+    ok = Flash_LogLine_Ring5(buf, (uint32_t)strlen(buf));
+    Arena_Release(mark);
+    return ok;
+}
+
+uint32_t Flash_FormatTemperatureWithDate_Q4(char *buf, int16_t temp_q4, uint32_t t)
+{
+    unsigned int yy;
+    unsigned char mon, day;
+    uint32_t sod = t % 86400u;
+
+    int sign = (temp_q4 < 0);
+    int16_t a = (int16_t)(sign ? -temp_q4 : temp_q4);
+
+    RTC_DaysToDate(t / 86400u, &yy, &mon, &day);
+    (void)sprintf(buf, "20%02u-%02u-%02u %02lu:%02lu:%02lu  Temperature: %s%d.%04d C\r\n",
+        yy, mon, day, (unsigned long)(sod / 3600u), (unsigned long)((sod / 60u) % 60u),
+        (unsigned long)(sod % 60u), sign ? "-" : "", (int)(a >> 4), (int)(a & 0x0F) * 625);
+    return (uint32_t)strlen(buf);
+}
+
+uint8_t Flash_LogTemperatureWithDate_Ring5_Q4(int16_t temp_q4, uint32_t t)
+{
+    uint32_t mark = Arena_Mark();
+    char *buf = (char*)Arena_Alloc(FLASH_LINE_MAX);
+    uint8_t ok;
+
+    if (!buf) return 0;
+    ok = Flash_LogLine_Ring5(buf, Flash_FormatTemperatureWithDate_Q4(buf, temp_q4, t));
+    Arena_Release(mark);
+    return ok;
 }
 
 uint8_t Flash_WriteTemperatureFile_Q4(int16_t temp_q4)
@@ -0,0 +1,149 @@
+#include "supply.h"
+#include "main.h"
+
+#define ADC_TIMEOUT   20000u   /* EOC polls; a conversion takes ~50 us */
+
+static volatile uint8_t supply_warn;   /* set by the SVD interrupt */
+static uint8_t  supply_count = SUPPLY_EVERY_N - 1u;   /* first sample measures */
+static uint16_t supply_last_mv;
+
+void SVD_IRQHandler(void)
+{
+    if (LL_SVD_IsActiveFlag_PowerFallFlag(SVD)) {
+        LL_PMU_ClearFlag_PowerFallFlag(SVD);
+        supply_warn = 1u;
+        (void)Sched_Post(SCHED_LEVEL_IRQ, SCHED_TASK_SUPPLY, 0u);
+    }
+    if (LL_SVD_IsActiveFlag_PowerRiseFlag(SVD)) {
+        LL_PMU_ClearFlag_PowerRiseFlag(SVD);
+    }
+}
+
+void Supply_Init(void)
+{
+    SVD_InitTypeDef svd;
+
+    LL_SVD_StructInit(&svd);
+    svd.Mode      = LL_SVD_WORK_MODE_INTERMITTENT;   /* digital filter forced on */
+    svd.Interval  = LL_SVD_INTERVEL_ENABLE_PERIOD_1000MS;
+    svd.Threshold = SUPPLY_SVD_LEVEL;
+    (void)LL_SVD_Init(SVD, &svd);
+
+    LL_PMU_ClearFlag_PowerFallFlag(SVD);
+    LL_PMU_ClearFlag_PowerRiseFlag(SVD);
+    LL_SVD_EnableITPowerFall(SVD);
+    LL_SVD_EnableSVD(SVD);
+
+    NVIC_DisableIRQ(SVD_IRQn);
+    NVIC_SetPriority(SVD_IRQn, 2);
+    NVIC_EnableIRQ(SVD_IRQn);
+}
+
+uint8_t Supply_Warning(void)
+{
+    uint8_t w = supply_warn;
+
+    supply_warn = 0u;
+    return w;
+}
+
+/* One single-channel conversion; the hardware averages 8 samples */
+static int adc_convert(uint32_t channel, uint32_t *out)
+{
+    uint32_t n = ADC_TIMEOUT;
+
+    LL_ADC_EnalbleSequencerChannel(ADC, channel);
+    LL_ADC_ClearFlag_EOC(ADC);
+    LL_ADC_Enable(ADC);
+    LL_ADC_StartConversion(ADC);
+    while (!LL_ADC_IsActiveFlag_EOC(ADC) && --n != 0u) {
+    }
+    *out = LL_ADC_ReadConversionData12(ADC);
+    LL_ADC_ClearFlag_EOC(ADC);
+    LL_ADC_Disable(ADC);
+    LL_ADC_DisableSequencerChannel(ADC, channel);
+    return (n == 0u) ? 1 : 0;
+}
+
+int Supply_Measure(uint16_t *vdd_mv, int16_t *mcu_q4)
+{
+    LL_ADC_CommonInitTypeDef common;
+    LL_ADC_InitTypeDef init;
+    uint32_t vref = 0u, ts = 0u, mv, ts_uv, cal_uv;
+    uint32_t vref_on = LL_VREF_IsEnabledVREF(VREF);
+    int rc;
+
+    /* RCHF straight in at 8 MHz, /4 at 16 or 24 (clock.c moves it), short
+     * sampling: the internal sources are buffered, so 32 clocks settle them */
+    common.AdcClockSource    = LL_RCC_ADC_OPERATION_CLOCK_PRESCALLER_RCHF;
+    common.AdcClockPrescaler = (LL_RCC_GetRCHFFrequency() == LL_RCC_RCHF_FREQUENCY_8MHZ) ?
+        LL_RCC_ADC_OPERATION_CLOCK_PRESCALER_DIV1 : LL_RCC_ADC_OPERATION_CLOCK_PRESCALER_DIV4;
+    (void)LL_ADC_CommonInit(&common);
+
+    LL_ADC_StructInit(&init);
+    init.ADC_ContinuousConvMode = LL_ADC_CONV_SINGLE;
+    init.ADC_Channel_Swap_Wiat  = LL_ADC_SAMPLEING_INTERVAL_2_CYCLE;
+    init.ADC_Channel_Fast_Time  = LL_ADC_FAST_CH_SAMPLING_TIME_32_ADCCLK;
+    init.ADC_Channel_Slow_Time  = LL_ADC_SLOW_CH_SAMPLING_TIME_32_ADCCLK;
+    init.ADC_OverSampingRatio   = LL_ADC_OVERSAMPLING_8X;
+    init.ADC_OversamplingShift  = LL_ADC_OVERSAMPLING_RESULT_DIV8;
+    (void)LL_ADC_Init(ADC, &init);   /* also starts VREF and the sensor, self-calibrates */
+
+    LL_VREF_EnableVREFBuffer(VREF);
+    LL_VREF_EnableVPTATBuffer(VREF);
+    DelayUs(10);
+
+    rc = adc_convert(LL_ADC_INTERNAL_CH_VREF, &vref);
+    if (rc == 0) rc = adc_convert(LL_ADC_INTERNAL_CH_TEMPSENSOR, &ts);
+
+    LL_VREF_DisableVPTATBuffer(VREF);
+    LL_VREF_DisableVREFBuffer(VREF);
+    LL_VREF_DisableTemperatureSensor(VREF);
+    if (!vref_on) LL_VREF_DisableVREF(VREF);
+    (void)LL_ADC_CommonDeInit();
+
+    if (rc != 0 || vref == 0u) return 1;
+
+    mv = (uint32_t)SUPPLY_VREF_CAL * 3000u / vref;
+
+    /* Sensor voltage now and at calibration, uV (x1000/4096: 0.02% low, same both sides) */
+    ts_uv  = ts * mv * 250u / 1024u;
+    cal_uv = (uint32_t)SUPPLY_TS_CAL * 3000u * 250u / 1024u;
+
+    *vdd_mv = (uint16_t)mv;
+    *mcu_q4 = (int16_t)(SUPPLY_TS_CAL_C * 16 + ((int32_t)ts_uv - (int32_t)cal_uv) * 16 / SUPPLY_TS_UV_PER_C);
+    supply_last_mv = (uint16_t)mv;
+    return 0;
+}
+
+void Supply_Sample(void)
+{
+    uint16_t mv;
+    int16_t q4;
+
+    if (++supply_count < SUPPLY_EVERY_N) return;
+    supply_count = 0u;
+
+    if (Supply_Measure(&mv, &q4) == 0) {
+        (void)LogStore_Append(LOG_REC_SUPPLY, 0, (int16_t)mv, (uint16_t)q4);
+    }
+}
+
+uint16_t Supply_LastMv(void)
+{
+    return supply_last_mv;
+}
+
+int32_t Supply_LifeDays(void)
+{
+    const LogSupply *s = LogIndex_Supply();
+    uint32_t span_days, days;
+
+    if (s->count < 2u) return -1;
+    span_days = (s->last_time - s->first_time) / 86400u;
+    if (span_days == 0u || s->first_mv <= s->last_mv) return -1;
+    if (s->last_mv <= SUPPLY_CUTOFF_MV) return 0;
+
+    days = (uint32_t)(s->last_mv - SUPPLY_CUTOFF_MV) * span_days / (uint32_t)(s->first_mv - s->last_mv);
+    return (days > 99999u) ? 99999 : (int32_t)days;
+}
@@ -0,0 +1,135 @@
+#include "temp_acq.h"
+#include "main.h"
+
+static TempAcqStats acq_stats;
+static int32_t acq_iir_q12[NST112_MAX_SENSORS];   /* IIR state, degC * 4096 */
+static uint8_t acq_iir_valid;                     /* channel bit mask */
+static uint8_t acq_iir_shift;
+
+/* Burst in progress, TempAcq_Begin() to TempAcq_End() */
+static int16_t  acq_v[NST112_MAX_SENSORS][TEMP_ACQ_BURST_MAX];
+static uint8_t  acq_got;      /* channels still in the burst */
+static uint8_t  acq_burst;
+static uint8_t  acq_n;        /* conversions taken */
+static uint32_t acq_wait0;    /* NST112_WaitMs() at the start */
+static uint32_t acq_gap_ms;   /* waited between conversions */
+
+/* Free-running SysTick (24-bit, counts down) for cycle counts; DelayUs()
+ * reloads it, so only spans without delays are measured. */
+static uint32_t cyc_start(void)
+{
+    SysTick->LOAD = 0x00FFFFFFu;
+    SysTick->VAL  = 0u;
+    return SysTick->VAL;
+}
+
+static uint32_t cyc_since(uint32_t start)
+{
+    return (start - SysTick->VAL) & 0x00FFFFFFu;
+}
+
+/* Median of n Q4 readings as Q8 (mean of the middle two when n is even) */
+static int32_t median_q8(int16_t *v, uint8_t n)
+{
+    for (uint8_t i = 1u; i < n; i++) {
+        int16_t x = v[i];
+        uint8_t j = i;
+        while (j > 0u && v[j - 1u] > x) {
+            v[j] = v[j - 1u];
+            j--;
+        }
+        v[j] = x;
+    }
+    if (n & 1u) return (int32_t)v[n >> 1] << 4;
+    return ((int32_t)v[(n >> 1) - 1u] + v[n >> 1]) << 3;
+}
+
+void TempAcq_Reset(void)
+{
+    acq_iir_valid = 0u;
+}
+
+const TempAcqStats *TempAcq_Stats(void)
+{
+    return &acq_stats;
+}
+
+void TempAcq_Begin(uint8_t chans, uint8_t burst, uint8_t iir_shift)
+{
+    if (burst == 0u) burst = 1u;
+    if (burst > TEMP_ACQ_BURST_MAX) burst = TEMP_ACQ_BURST_MAX;
+    if (iir_shift > TEMP_ACQ_IIR_SHIFT_MAX) iir_shift = TEMP_ACQ_IIR_SHIFT_MAX;
+    if (iir_shift != acq_iir_shift) {
+        acq_iir_shift = iir_shift;
+        acq_iir_valid = 0u;
+    }
+    acq_got = chans;
+    acq_burst = burst;
+    acq_n = 0u;
+    acq_wait0 = NST112_WaitMs();
+    acq_gap_ms = 0u;
+}
+
+/* One-shot: every read is a fresh conversion. Continuous: wait for the
+ * next one, or the burst would read the same register value again. */
+uint8_t TempAcq_Next(uint32_t *gap_ms)
+{
+    uint32_t gap = 0u;
+
+    if (acq_n >= acq_burst || acq_got == 0u) return 0u;
+    if (acq_n != 0u) gap = NST112_PeriodMs();
+    acq_gap_ms += gap;
+    *gap_ms = gap;
+    return acq_got;
+}
+
+uint8_t TempAcq_Last(void)
+{
+    return (uint8_t)(acq_n + 1u >= acq_burst);
+}
+
+/* A channel that fails drops out of the rest of the burst */
+void TempAcq_Add(uint8_t got, const int16_t *t_q4)
+{
+    acq_got &= got;
+    for (uint8_t ch = 0u; ch < NST112_MAX_SENSORS; ch++) {
+        if (acq_got & (1u << ch)) acq_v[ch][acq_n] = t_q4[ch];
+    }
+    acq_n++;
+}
+
+uint8_t TempAcq_End(int32_t *out_q8)
+{
+    uint8_t got = acq_got;   /* non-zero only with the burst complete */
+    uint8_t iir_shift = acq_iir_shift;
+    uint32_t cyc;
+    int32_t x;
+
+    acq_iir_valid &= got;
+
+    cyc = cyc_start();
+    for (uint8_t ch = 0u; ch < NST112_MAX_SENSORS; ch++) {
+        uint8_t bit = (uint8_t)(1u << ch);
+
+        if (!(got & bit)) continue;
+        x = median_q8(acq_v[ch], acq_burst);
+        if (iir_shift == 0u) {
+            out_q8[ch] = x;
+        } else {
+            if (!(acq_iir_valid & bit)) {
+                acq_iir_q12[ch] = x << 4;
+                acq_iir_valid |= bit;
+            } else {
+                acq_iir_q12[ch] += ((x << 4) - acq_iir_q12[ch]) >> iir_shift;
+            }
+            out_q8[ch] = (acq_iir_q12[ch] + 8) >> 4;
+        }
+    }
+    acq_stats.filter_cycles = cyc_since(cyc);
+
+    acq_stats.chans = got;
+    acq_stats.burst = acq_burst;
+    acq_stats.iir_shift = iir_shift;
+    acq_stats.wait_ms = (uint16_t)(NST112_WaitMs() - acq_wait0 + acq_gap_ms);
+    return got;
+}
@@ -5,6 +5,57 @@
 #include "usbd_desc.h"
 #include "usbd_usr.h"
 #include "msc_core.h"
+#include "comp_core.h"
+#include "cdc_core.h"
+#include "msc_bot.h"
+
+volatile uint32_t usb_ms_ticks;
+volatile USB_EnumStats usb_enum_stats;
+volatile uint16_t usb_isr_last_us;
+volatile uint16_t usb_isr_max_us;
+
+ARENA_CHECK(usb_core, ARENA_ROUND(MSC_MEDIA_PACKET) + ARENA_ROUND(CDC_STREAM_BUF_SIZE) <= ARENA_USB_CORE_BYTES);
+
+/* us timestamp from the 1 MHz BSTIM count; only valid with BSTIM_IRQ masked
+ * or at equal priority (USB and BSTIM both run at priority 2). */
+static uint32_t usb_now_us(void)
+{
+    uint32_t ms  = usb_ms_ticks;
+    uint32_t cnt = LL_BSTIM_GetCounterCnt(BSTIM);
+
+    if (LL_BSTIM_IsActiveFlag_UpdataEvent(BSTIM) && (cnt < 500u))
+    {
+        ms++;   /* wrapped, tick not yet counted */
+    }
+    return (ms * 1000u) + cnt;
+}
+
+/* Forwards every DCD event to the device core, recording the first SETUP. */
+static uint8_t USB_SetupStage_Hook(USB_OTG_CORE_HANDLE *pdev)
+{
+    USB_EnumStats_Mark(USB_ENUM_EVT_SETUP);
+    return USBD_DCD_INT_cb.SetupStage(pdev);
+}
+
+static USBD_DCD_INT_cb_TypeDef USB_DCD_INT_hook;
+
+void USB_EnumStats_Mark(uint8_t evt)
+{
+    volatile uint32_t *slot;
+
+    switch (evt)
+    {
+        case USB_ENUM_EVT_SETUP:      slot = &usb_enum_stats.first_setup_ms; break;
+        case USB_ENUM_EVT_CONFIGURED: slot = &usb_enum_stats.configured_ms;  break;
+        case USB_ENUM_EVT_MOUNT:      slot = &usb_enum_stats.mount_ms;       break;
+        default: return;
+    }
+
+    if (*slot == USB_ENUM_NOT_SEEN)
+    {
+        *slot = usb_ms_ticks;
+    }
+}
 
 void USBInit(void)
 {
@@ -21,7 +72,7 @@ void USBInit(void)
     LL_RCC_SetAPB1Prescaler(LL_RCC_APB1_DIV_2);
     LL_RCC_SetAPB2Prescaler(LL_RCC_APB2_DIV_2);
     LL_RCC_SetSystemClockSource(LL_RCC_SYSTEM_CLKSOURCE_PLL);
-    systemClock = 64000000;
+    Clock_Retime();   /* systemClock = 64 MHz, SPI and I2C for the 32 MHz APB */
     
     // ʼBTIMʱ(ʱ: (64000000 / 2 / 32 * 1000) = 1ms)
     BSTIM_InitStruct.ClockSource = LL_RCC_BSTIM_OPERATION_CLK_SOURCE_APBCLK2;
@@ -37,6 +88,15 @@ void USBInit(void)
     NVIC_SetPriority(BSTIM_IRQn, 2);
     NVIC_EnableIRQ(BSTIM_IRQn);
     
+    /* Start the 1 ms tick before the PHY comes up so enumeration is timed
+     * from the moment VBUS was seen. */
+    usb_ms_ticks = 0;
+    usb_enum_stats.first_setup_ms = USB_ENUM_NOT_SEEN;
+    usb_enum_stats.configured_ms  = USB_ENUM_NOT_SEEN;
+    usb_enum_stats.mount_ms       = USB_ENUM_NOT_SEEN;
+    usb_isr_max_us = 0;
+    LL_BSTIM_EnableCounter(BSTIM);
+    
     // GPIOʼ
     GPIO_InitStruct.Pin = LL_GPIO_PIN_10;       // KEY1
     GPIO_InitStruct.Mode = LL_GPIO_MODE_INPUT;
@@ -52,20 +112,102 @@ void USBInit(void)
     GPIO_InitStruct.Pin = LL_GPIO_PIN_6;        // KEY4
     LL_GPIO_Init(GPIOC, &GPIO_InitStruct);
     
+    /* USB mode blocks, before the core can touch them */
+    MSC_BOT_Data = (uint8_t*)Arena_Alloc(MSC_MEDIA_PACKET);
+#if USBD_COMPOSITE_CDC
+    CDC_Stream_Buf = (uint8_t*)Arena_Alloc(CDC_STREAM_BUF_SIZE);
+#endif
+
     // USBʼ
+    USB_DCD_INT_hook = USBD_DCD_INT_cb;
+    USB_DCD_INT_hook.SetupStage = USB_SetupStage_Hook;
+    USBD_DCD_INT_fops = &USB_DCD_INT_hook;
+
+#if USBD_COMPOSITE_CDC
+    USBD_Init(&USB_OTG_dev, USB_OTG_FS_CORE_ID, 
+        &USR_desc, &USBD_COMP_cb, &USR_cb);
+#else
     USBD_Init(&USB_OTG_dev, USB_OTG_FS_CORE_ID, 
         &USR_desc, &USBD_MSC_cb, &USR_cb);
+#endif
+}
 
-    // ʱ
-    LL_BSTIM_EnableCounter(BSTIM);
+/*
+ * VBUS gone: detach and mask the interrupt (the arena blocks are free after
+ * this), stop the USB clocks and the 1 ms tick and leave the PLL for the
+ * base RCHF level, so battery mode starts here and not at the next DeepSleep.
+ */
+void USBStop(void)
+{
+    USB_OTG_BSP_DisableInterrupt(&USB_OTG_dev);
+    USB_OTG_BSP_DeInit(&USB_OTG_dev);   /* PHY and USB core clock off */
+
+    NVIC_DisableIRQ(BSTIM_IRQn);
+    LL_BSTIM_DisableIT_UpdataEvent(BSTIM);
+    LL_BSTIM_DisableCounter(BSTIM);
+    LL_BSTIM_ClearFlag_UpdataEvent(BSTIM);
+
+    Clock_SetRchf(ClockBaseLevel());
+    LL_RCC_PLL_Disable();
 }
 
 void BSTIM_IRQHandler(void)
 {
     LL_BSTIM_ClearFlag_UpdataEvent(BSTIM);
+    usb_ms_ticks++;
 }
 
 void USB_IRQHandler(void)
 {
+    uint32_t t0 = usb_now_us();
+    uint32_t dt;
+
     USBD_OTG_ISR_Handler(&USB_OTG_dev);
+    Sched_Signal(SCHED_TASK_USB);   /* SCSI work for USB_Process() */
+
+    dt = usb_now_us() - t0;
+    if (dt > 0xFFFFu) dt = 0xFFFFu;
+    usb_isr_last_us = (uint16_t)dt;
+    if (usb_isr_last_us > usb_isr_max_us)
+    {
+        usb_isr_max_us = usb_isr_last_us;
+    }
+}
+
+/* Main-loop half of the MSC class: runs SCSI/storage work queued by the ISR */
+void USB_Process(void)
+{
+    MSC_BOT_Process(&USB_OTG_dev);
+}
+
+/* Queue one live-stream record on the CDC port; dropped whole if the host lags */
+uint8_t USB_Stream_Write(const char *line, uint16_t len)
+{
+#if USBD_COMPOSITE_CDC
+    uint8_t ok = CDC_Stream_Write((const uint8_t *)line, len);
+    CDC_Stream_Kick(&USB_OTG_dev);
+    return ok;
+#else
+    (void)line;
+    (void)len;
+    return 0;
+#endif
+}
+
+uint8_t USB_Stream_IsOpen(void)
+{
+#if USBD_COMPOSITE_CDC
+    return CDC_Stream_Open;
+#else
+    return 0;
+#endif
+}
+
+uint32_t USB_Stream_Dropped(void)
+{
+#if USBD_COMPOSITE_CDC
+    return CDC_Stream_Dropped;
+#else
+    return 0;
+#endif
 }
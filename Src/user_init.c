@@ -1,57 +1,23 @@
 #include "user_init.h"
 
-#define NVR_CHECK(_N_VALUE_, _T_VALUE_)                         \
-                            ((((_N_VALUE_ >> 16) & 0xffff) ==   \
-                            ((~_N_VALUE_) & 0xffff)) ? _N_VALUE_ : _T_VALUE_)
-
-#define RCHF8M_DEF_TRIM     (0x30)      // RC8M У׼ֵ
-#define RCHF16M_DEF_TRIM    (0x2A)      // RC16M У׼ֵ
-#define RCHF24M_DEF_TRIM    (0x27)      // RC24M У׼ֵ
-
-#define RCHF8M_NVR_TRIM     (*(uint32_t *)0x1FFFFB40)	// RC8M У׼ֵ
-#define RCHF16M_NVR_TRIM 	(*(uint32_t *)0x1FFFFB3C)	// RC16M У׼ֵ
-#define RCHF24M_NVR_TRIM 	(*(uint32_t *)0x1FFFFB38)	// RC24M У׼ֵ
-
 uint32_t systemClock;
 
-static void ClockInit(void)
+static uint8_t user_init_done;   /* LED and FOUT pins set up: they survive DeepSleep */
+
+/* Build-time default level; tasks move off it through Clock_Request() */
+uint8_t ClockBaseLevel(void)
 {
-    uint32_t trim;
     switch (RCHF_CLOCK)
     {
-        case LL_RCC_RCHF_FREQUENCY_8MHZ:
-            systemClock = 8000000;
-            LL_RCC_SetRCHFFrequency(RCHF_CLOCK);
-            trim = NVR_CHECK(RCHF8M_NVR_TRIM, RCHF8M_DEF_TRIM) & 0x7f;
-            LL_RCC_SetRCHFTrimValue(trim);
-            break;
-        
-        case LL_RCC_RCHF_FREQUENCY_16MHZ:
-            systemClock = 16000000;
-            LL_RCC_SetRCHFFrequency(RCHF_CLOCK);
-            trim = NVR_CHECK(RCHF16M_NVR_TRIM, RCHF16M_DEF_TRIM) & 0x7f;
-            LL_RCC_SetRCHFTrimValue(trim);
-            break;
-        
-        case LL_RCC_RCHF_FREQUENCY_24MHZ:
-            systemClock = 24000000;
-            LL_RCC_SetRCHFFrequency(RCHF_CLOCK);
-            trim = NVR_CHECK(RCHF24M_NVR_TRIM, RCHF24M_DEF_TRIM) & 0x7f;
-            LL_RCC_SetRCHFTrimValue(trim);
-            break;
-        
-        default:
-            systemClock = 8000000;
-            LL_RCC_SetRCHFFrequency(RCHF_CLOCK);
-            trim = NVR_CHECK(RCHF8M_NVR_TRIM, RCHF8M_DEF_TRIM) & 0x7f;
-            LL_RCC_SetRCHFTrimValue(trim);
-            break;
+        case LL_RCC_RCHF_FREQUENCY_16MHZ: return CLOCK_RCHF_16M;
+        case LL_RCC_RCHF_FREQUENCY_24MHZ: return CLOCK_RCHF_24M;
+        default:                          return CLOCK_RCHF_8M;
     }
-    
-    LL_RCC_SetSystemClockSource(LL_RCC_SYSTEM_CLKSOURCE_RCHF);
-    LL_RCC_SetAHBPrescaler(LL_RCC_SYSCLK_DIV_1);
-    LL_RCC_SetAPB1Prescaler(LL_RCC_APB1_DIV_1);
-    LL_RCC_SetAPB2Prescaler(LL_RCC_APB2_DIV_1);
+}
+
+static void ClockInit(void)
+{
+    Clock_SetRchf(ClockBaseLevel());
 }
 
 static void SystickInit(void)
@@ -82,34 +48,38 @@ static void LedInit(void)
 		GPIO_InitStruct.RemapPin = DISABLE;
 		LL_GPIO_Init(LED1_GPIO, &GPIO_InitStruct);
     
-		LED0_OFF();
-    LED1_OFF();
+    /* Woken by an LED pattern step: leave the LEDs to it */
+    if (!Led_Busy())
+    {
+        LED0_OFF();
+        LED1_OFF();
+    }
 }
 
 void blink_green(void)
 {
 		LED0_ON();
-		DelayMs(500);
+		DelayMs(500, DELAY_COARSE);
 		LED0_OFF();
-		DelayMs(500);
+		DelayMs(500, DELAY_COARSE);
 }
 
 void blink_red(void)
 {
 		LED1_ON();
-		DelayMs(500);
+		DelayMs(500, DELAY_COARSE);
 		LED1_OFF();
-		DelayMs(500);
+		DelayMs(500, DELAY_COARSE);
 }
 
 void blink_both(void)
 {
 		LED0_ON();
 		LED1_ON();
-		DelayMs(500);
+		DelayMs(500, DELAY_COARSE);
 		LED0_OFF();
 		LED1_OFF();
-		DelayMs(500);
+		DelayMs(500, DELAY_COARSE);
 }
 
 static void FoutInit(void)
@@ -131,20 +101,63 @@ void UserInit(void)
     SystickInit();
     LedInit();
     FoutInit();
+    user_init_done = 1;
 }
 
-void DelayUs(uint32_t count)
+void UserResume(void)
 {
-    count = (uint64_t)systemClock * count / 1000000;
-    count = count > 16777216 ? 16777216 : count;
+    if (!user_init_done)
+    {
+        UserInit();
+        return;
+    }
     
-    SysTick->LOAD = count - 1;
-    SysTick->VAL = 0;
-    while (!((SysTick->CTRL >> 16) & 0x1));
+    /* Sleep_Deep() wakes RCHF at the level it slept at; after a USB
+     * session the buses are still divided for the PLL */
+    if (!Clock_IsRchf(ClockBaseLevel()))
+    {
+        ClockInit();
+    }
+    SystickInit();   /* Sleep_Deep() stopped it */
+}
+
+void DelayUs(uint32_t count)
+{
+    uint64_t ticks = (uint64_t)systemClock * count / 1000000;
+
+    /* SysTick reloads at most 2^24 ticks: wait in chunks */
+    while (ticks != 0u)
+    {
+        uint32_t n = (ticks > 16777216u) ? 16777216u : (uint32_t)ticks;
+
+        SysTick->LOAD = n - 1;
+        SysTick->VAL = 0;
+        while (!((SysTick->CTRL >> 16) & 0x1));
+        ticks -= n;
+    }
 }
 
-void DelayMs(uint32_t count)
+void DelayMs(uint32_t count, uint8_t mode)
 {
+    if (mode == DELAY_COARSE && count >= DELAY_SLEEP_MIN_MS && __get_IPSR() == 0u)
+    {
+        if (LL_RCC_GetSystemClockSource() == LL_RCC_SYSTEM_CLKSOURCE_PLL &&
+            LL_BSTIM_IsEnabledIT_UpdataEvent(BSTIM))
+        {
+            /* USB running: BSTIM wakes the core every ms, USB keeps its IRQ */
+            uint32_t t0 = usb_ms_ticks;
+            while ((usb_ms_ticks - t0) <= count)
+            {
+                __WFI();
+            }
+        }
+        else
+        {
+            Sleep_Ms(count);
+        }
+        return;
+    }
+
     while (count--)
     {
         DelayUs(1000);
@@ -7,10 +7,17 @@ void NMI_Handler(void)
     if(SET == LL_PMU_IsActiveFlag_WakeupPIN(PMU, LL_PMU_WKUP2PIN))
     {
 				LL_PMU_ClearFlag_WakeupPIN(PMU, LL_PMU_WKUP2PIN);
+        (void)Sched_Post(SCHED_LEVEL_NMI, SCHED_TASK_USB, 0u);
     }
 		if(SET == LL_PMU_IsActiveFlag_WakeupPIN(PMU, LL_PMU_WKUP0PIN))
     {
 				LL_PMU_ClearFlag_WakeupPIN(PMU, LL_PMU_WKUP0PIN);
+        (void)Sched_Post(SCHED_LEVEL_NMI, SCHED_TASK_BUTTON, 0u);
+    }
+    if(SET == LL_PMU_IsActiveFlag_WakeupPIN(PMU, NST112_ALERT_PMU_WKUP))
+    {
+        LL_PMU_ClearFlag_WakeupPIN(PMU, NST112_ALERT_PMU_WKUP);
+        (void)Sched_Post(SCHED_LEVEL_NMI, SCHED_TASK_ALERT, 0u);
     }
 }
 
@@ -33,6 +40,20 @@ void WKUP_init(void)
     LL_GPIO_EnableWkup(GPIO_COMMON, LL_GPIO_WKUP_0);
 }
 
+/* Button edge to wake on: the press (rising) or the release */
+void WKUP_Button_SetEdge(uint8_t rising)
+{
+    LL_GPIO_SetWkupPolarity(GPIO_COMMON, LL_GPIO_WKUP_0,
+        rising ? LL_GPIO_WKUP_POLARITY_RISING : LL_GPIO_WKUP_POLARITY_FALLING);
+    LL_PMU_ClearFlag_WakeupPIN(PMU, LL_PMU_WKUP0PIN);
+    LL_GPIO_EnableWkup(GPIO_COMMON, LL_GPIO_WKUP_0);
+}
+
+void WKUP_Button_Disable(void)
+{
+    LL_GPIO_DisableWkup(GPIO_COMMON, LL_GPIO_WKUP_0);
+}
+
 void WKUP_USB_init(void)
 {
 		LL_GPIO_InitTypeDef gpio_init;
@@ -51,6 +72,37 @@ void WKUP_USB_init(void)
 		LL_GPIO_EnableWkup(GPIO_COMMON, LL_GPIO_WKUP_2);
 }
 
+/* NST112 ALERT: input with pull-up, wakeup on the edge WKUP_ALERT_SetEdge() selects */
+void WKUP_ALERT_init(void)
+{
+    LL_GPIO_InitTypeDef gpio_init = {0};
+
+    LL_RCC_Enable_SleepmodeExternalInterrupt();
+    LL_RCC_Group1_EnableOperationClock(LL_RCC_OPERATION1_CLOCK_EXTI);
+
+    gpio_init.Pin        = NST112_ALERT_PIN;
+    gpio_init.Mode       = LL_GPIO_MODE_INPUT;
+    gpio_init.OutputType = LL_GPIO_OUTPUT_PUSHPULL;
+    gpio_init.Pull       = ENABLE;
+    gpio_init.RemapPin   = DISABLE;
+    LL_GPIO_Init(NST112_ALERT_PORT, &gpio_init);
+
+    LL_GPIO_SetWkupEntry(GPIO_COMMON, LL_GPIO_WKUP_INT_ENTRY_NMI);
+}
+
+void WKUP_ALERT_SetEdge(uint8_t rising)
+{
+    LL_GPIO_SetWkupPolarity(GPIO_COMMON, NST112_ALERT_WKUP,
+        rising ? LL_GPIO_WKUP_POLARITY_RISING : LL_GPIO_WKUP_POLARITY_FALLING);
+    LL_PMU_ClearFlag_WakeupPIN(PMU, NST112_ALERT_PMU_WKUP);
+    LL_GPIO_EnableWkup(GPIO_COMMON, NST112_ALERT_WKUP);
+}
+
+void WKUP_ALERT_Disable(void)
+{
+    LL_GPIO_DisableWkup(GPIO_COMMON, NST112_ALERT_WKUP);
+}
+
 void Sleep_Deep(void)
 {
     // ?????: ?? ???????????? ARM SLEEPDEEP ??? ????? ? Sleep/DeepSleep ?? FM33
@@ -61,15 +113,170 @@ void Sleep_Deep(void)
 
     // ???????? ??????? ????? ??????????? (WKFSEL): 00=8MHz, 01=16MHz, 10=24MHz :contentReference[oaicite:5]{index=5}
     // ?????? ??, ??????? ????????????? ?????? UserInit() (RCHF_CLOCK).
+    uint8_t level = Clock_Level();
     uint32_t cr = PMU->CR;
     cr &= ~((3u << 0) | (1u << 9) | (3u << 10));  // PMOD[1:0], SLPDP, WKFSEL[11:10]
     cr |=  (2u << 0);    // PMOD=10 => Sleep/DeepSleep 
     cr |=  (1u << 9);    // SLPDP=1 => DeepSleep 
-    cr |=  (0u << 10);   // WKFSEL=00 => wake @ RCHF 8MHz :contentReference[oaicite:8]{index=8}
+    if (level != CLOCK_PLL_64M) {
+        cr |= ((uint32_t)level << 10);   // WKFSEL = CLOCK_RCHF_*: wake where we slept, UserResume() keeps it
+    }                                    // on the PLL: 00 => RCHF 8MHz :contentReference[oaicite:8]{index=8}
     PMU->CR = cr;
 
     __DSB();
     __WFI(); 
     __ISB();
+
+    /* Back to plain WFI: DelayMs() on USB and idle() would DeepSleep otherwise */
+    LL_PMU_SetLowPowerMode(PMU, LL_PMU_POWER_MODE_ACTIVE_AND_LPACTIVE);
+}
+
+/* ---------------- timed sleep on LPTIM ---------------- */
+
+#define LPTIM_TICK_HZ   1024u   /* LSCLK 32768 Hz / 32 */
+
+static volatile uint8_t lptim_fired;
+static volatile uint8_t lptim_sleeping;   /* Sleep_Ms() owns LPTIM, else the LED engine */
+static uint32_t lptim_slept_ms;           /* Sleep_Clock() */
+static uint32_t lptim_slept_frac;         /* ms * 1024 not yet counted */
+
+/* Overflow ticks for about ms milliseconds (1..64000) */
+uint32_t Lptim_Ticks(uint32_t ms)
+{
+    uint32_t ticks = (ms * LPTIM_TICK_HZ + 999u) / 1000u;
+
+    if (ticks == 0u) ticks = 1u;
+    if (ticks > 0xFFFFu) ticks = 0xFFFFu;
+    return ticks;
+}
+
+void LPTIM_IRQHandler(void)
+{
+    if (LL_LPTIM_IsActiveFlag_CounterOver(LPTIM)) {
+        LL_LPTIM_ClearFlag_CounterOver(LPTIM);
+        if (lptim_sleeping) {
+            lptim_fired = 1u;
+        } else {
+            Led_TimerEvent();
+        }
+    }
+}
+
+/* Overflow interrupt after ticks (1..0xFFFF, Lptim_Ticks()), restarting LPTIM */
+void Lptim_OneShot(uint32_t ticks)
+{
+    LL_LPTIM_TimeInitTypeDef tim;
+
+    LL_LPTIM_TimeModeStructInit(&tim);
+    tim.ClockSource = LL_RCC_LPTIM_OPERATION_CLOCK_SOURCE_LSCLK;
+    tim.Prescaler   = LL_LPTIM_CLOCKDIVISION_DIV32;
+    tim.OneState    = LL_LPTIM_ONE_STATE_TIMER_SINGLE;
+    (void)LL_LPTIM_TimeModeInit(LPTIM, &tim);
+    LL_LPTIM_SetAutoReload(LPTIM, ticks);
+    LL_LPTIM_ClearFlag_CounterOver(LPTIM);
+    LL_LPTIM_EnableIT_CounterOver(LPTIM);
+    NVIC_SetPriority(LPTIM_IRQn, 2);
+    NVIC_EnableIRQ(LPTIM_IRQn);
+    LL_LPTIM_Enable(LPTIM);
+}
+
+/* Ticks left before the overflow, 0 once it is due */
+uint32_t Lptim_Remaining(void)
+{
+    uint32_t arr = LL_LPTIM_GetAutoReload(LPTIM);
+    uint32_t cnt = LL_LPTIM_GetCounter(LPTIM);
+
+    if (LL_LPTIM_IsActiveFlag_CounterOver(LPTIM) || cnt >= arr) return 0u;
+    return arr - cnt;
+}
+
+void Lptim_Stop(void)
+{
+    NVIC_DisableIRQ(LPTIM_IRQn);
+    LL_LPTIM_Disable(LPTIM);
+    LL_RCC_Group2_DisableOperationClock(LL_RCC_OPERATION2_CLOCK_LPTIM);
+    LL_RCC_Group1_DisableBusClock(LL_RCC_BUS1_CLOCK_LPTIM);
 }
 
+/*
+ * Sleep about ms milliseconds (1..64000) on a one-shot LPTIM.
+ * Running from RCHF the PMU Sleep mode is used, which stops the high-speed
+ * clocks and wakes at the same RCHF frequency; on the PLL (USB attached)
+ * only the core clock is gated so USB keeps being serviced.
+ * An LED pattern keeps its timing: the sleep is cut at each step boundary,
+ * the step advanced, and the LED engine gets back what is left of its step.
+ * for_event: also end when an interrupt posted scheduler work.
+ * The time slept, early end included, advances Sleep_Clock().
+ */
+static void lptim_sleep(uint32_t ms, uint8_t for_event)
+{
+    uint32_t total = Lptim_Ticks(ms);
+    uint32_t done = 0u;
+    uint32_t led = Led_Suspend();
+    uint32_t chunk, ticks;
+
+    SCB->SCR &= ~SCB_SCR_SLEEPDEEP_Msk;
+    if (LL_RCC_GetSystemClockSource() == LL_RCC_SYSTEM_CLKSOURCE_RCHF) {
+        uint32_t f = LL_RCC_GetRCHFClockFreq();
+        LL_PMU_SetWakeupRCHFFrequency(PMU, (f >= 24000000u) ? LL_PMU_SLEEP_WAKEUP_FREQ_RCHF_24MHZ :
+                                           (f >= 16000000u) ? LL_PMU_SLEEP_WAKEUP_FREQ_RCHF_16MHZ :
+                                                              LL_PMU_SLEEP_WAKEUP_FREQ_RCHF_8MHZ);
+        LL_PMU_SetSleepMode(PMU, LL_PMU_SLEEP_MODE_NOMAL);
+        LL_PMU_SetLowPowerMode(PMU, LL_PMU_POWER_MODE_SLEEP_AND_DEEPSLEEP);
+    } else {
+        LL_PMU_SetLowPowerMode(PMU, LL_PMU_POWER_MODE_ACTIVE_AND_LPACTIVE);
+    }
+
+    lptim_sleeping = 1u;
+    while (done < total) {
+        if (led == 0u) {                /* a step is due now */
+            led = Led_Elapse(0u);
+            continue;
+        }
+        chunk = (led < total - done) ? led : (total - done);
+
+        lptim_fired = 0u;
+        Lptim_OneShot(chunk);
+
+        /* PRIMASK set: an IRQ that fires before WFI still wakes it */
+        __disable_irq();
+        while (!lptim_fired && !(for_event && Sched_Pending())) {
+            __DSB();
+            __WFI();
+            __ISB();
+            __enable_irq();
+            __disable_irq();
+        }
+        __enable_irq();
+
+        ticks = lptim_fired ? chunk : LL_LPTIM_GetCounter(LPTIM);
+        Lptim_Stop();
+        done += ticks;
+        if (led != LED_NO_STEP) led = Led_Elapse(ticks);
+        if (!lptim_fired || (for_event && Sched_Pending())) break;
+    }
+
+    lptim_slept_frac += done * 1000u;
+    lptim_slept_ms += lptim_slept_frac / LPTIM_TICK_HZ;
+    lptim_slept_frac %= LPTIM_TICK_HZ;
+
+    LL_PMU_SetLowPowerMode(PMU, LL_PMU_POWER_MODE_ACTIVE_AND_LPACTIVE);
+    lptim_sleeping = 0u;
+
+    Led_Resume();
+}
+
+void Sleep_Ms(uint32_t ms)
+{
+    lptim_sleep(ms, 0u);
+}
+
+void Sleep_Idle(uint32_t ms)
+{
+    lptim_sleep(ms, 1u);
+}
+
+uint32_t Sleep_Clock(void)
+{
+    return lptim_slept_ms;
+}
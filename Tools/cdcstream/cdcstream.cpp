@@ -0,0 +1,275 @@
+// Drives the CDC live stream class (Middleware/USB/App/src/cdc_core.c)
+// through a stub DCD: DCD_EP_Tx records each IN packet and a simulated
+// host completes it with the class DataIn callback, as the USB interrupt
+// would. Checks the byte stream the host sees against what was written
+// while the ring wraps, the zero-length packet after a full one, the
+// drop counting when the host stops reading, and that closing and
+// reopening the port (DTR) starts an empty ring.
+//
+//   gcc -O2 -c -I stub -I ../../Middleware/USB/App/inc -I ../../Middleware/USB/Device/inc ../../Middleware/USB/App/src/cdc_core.c
+//   g++ -std=c++11 -O2 -I stub -I ../../Middleware/USB/App/inc -I ../../Middleware/USB/Device/inc -o cdcstream cdcstream.cpp cdc_core.o
+//   ./cdcstream
+
+extern "C" {
+#include "cdc_core.h"
+}
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Packet {
+    size_t   offset;    // into CDC_Stream_Buf
+    uint32_t len;
+};
+
+uint8_t g_ring[CDC_STREAM_BUF_SIZE];
+int     g_dev;                      // pdev, never dereferenced
+int     g_irq_off;                  // NVIC_DisableIRQ(USB_IRQn) depth
+bool    g_in_irq;                   // inside a class callback
+bool    g_tx_busy;                  // a packet the host has not taken yet
+Packet  g_tx;
+std::vector<Packet> g_packets;      // every IN packet, in order
+std::string g_rx;                   // bytes the host received
+unsigned g_failed;
+
+#define CHECK(c) check((c), #c, __LINE__)
+
+void check(bool ok, const char *what, int line)
+{
+    if (ok) return;
+    std::printf("  FAIL line %d: %s\n", line, what);
+    g_failed++;
+}
+
+}  // namespace
+
+extern "C" {
+
+uint32_t DCD_EP_Open(void *, uint8_t, uint16_t, uint8_t) { return 0; }
+uint32_t DCD_EP_Close(void *, uint8_t) { return 0; }
+uint32_t DCD_EP_PrepareRx(void *, uint8_t, uint8_t *, uint16_t) { return 0; }
+
+uint32_t DCD_EP_Tx(void *, uint8_t ep_addr, uint8_t *pbuf, uint32_t buf_len)
+{
+    CHECK(ep_addr == CDC_IN_EP);
+    CHECK(!g_tx_busy);                      // one packet at a time
+    CHECK(g_in_irq || g_irq_off > 0);       // never raced by DataIn
+    CHECK(buf_len <= CDC_DATA_MAX_PACKET);
+    CHECK(pbuf >= g_ring && pbuf + buf_len <= g_ring + CDC_STREAM_BUF_SIZE);
+    g_tx.offset = size_t(pbuf - g_ring);
+    g_tx.len = buf_len;
+    g_tx_busy = true;
+    g_packets.push_back(g_tx);
+    return 0;
+}
+
+USBD_Status USBD_CtlSendData(void *, uint8_t *, uint16_t) { return USBD_OK; }
+USBD_Status USBD_CtlPrepareRx(void *, uint8_t *, uint16_t) { return USBD_OK; }
+void USBD_CtlError(void *, USB_SETUP_REQ *) {}
+
+void NVIC_DisableIRQ(IRQn_Type) { g_irq_off++; }
+void NVIC_EnableIRQ(IRQn_Type) { g_irq_off--; }
+
+}  // extern "C"
+
+namespace {
+
+// The host takes the packet in flight: copy it out, then the interrupt
+// runs DataIn, which starts the next one. False if nothing was queued.
+bool host_take()
+{
+    if (!g_tx_busy) return false;
+    g_rx.append(reinterpret_cast<const char *>(g_ring) + g_tx.offset, g_tx.len);
+    g_tx_busy = false;
+    g_in_irq = true;
+    USBD_CDC_cb.DataIn(&g_dev, CDC_IN_EP & 0x7F);
+    g_in_irq = false;
+    return true;
+}
+
+void host_drain()
+{
+    while (host_take()) {
+    }
+}
+
+void set_dtr(bool on)
+{
+    USB_SETUP_REQ req = { 0x21, CDC_SET_CONTROL_LINE_STATE, uint16_t(on ? 3 : 0), 0, 0 };
+    g_in_irq = true;
+    USBD_CDC_cb.Setup(&g_dev, &req);
+    g_in_irq = false;
+}
+
+// SET_CONFIGURATION, then a terminal opens the port
+void attach()
+{
+    g_in_irq = true;
+    USBD_CDC_cb.Init(&g_dev, 1);
+    g_in_irq = false;
+    g_tx_busy = false;
+    g_packets.clear();
+    g_rx.clear();
+    set_dtr(true);
+}
+
+// A record like main.c writes: "seq,...\r\n", len bytes
+std::string record(unsigned seq, size_t len)
+{
+    std::string r = std::to_string(seq) + ",";
+    while (r.size() + 2 < len) r += char('a' + (seq + r.size()) % 26);
+    return r + "\r\n";
+}
+
+// USB_Stream_Write(): queue, then kick the pipe
+bool write(const std::string &r)
+{
+    bool ok = CDC_Stream_Write(reinterpret_cast<const uint8_t *>(r.data()), uint16_t(r.size())) != 0;
+    CDC_Stream_Kick(&g_dev);
+    return ok;
+}
+
+std::vector<uint32_t> sizes()
+{
+    std::vector<uint32_t> s;
+    for (const Packet &p : g_packets) s.push_back(p.len);
+    return s;
+}
+
+// Records of 1..63 bytes, the host reading after every few: the ring
+// wraps several times, packets stop at the ring end and go on from 0
+void test_wrap()
+{
+    std::string sent;
+    unsigned split = 0;
+
+    std::printf("wrap\n");
+    attach();
+    for (unsigned seq = 0; sent.size() < 6u * CDC_STREAM_BUF_SIZE; seq++) {
+        std::string r = record(seq, 5 + (seq * 7) % 59);
+        CHECK(write(r));
+        sent += r;
+        if (seq % 5 == 4) host_drain();
+    }
+    host_drain();
+    for (const Packet &p : g_packets) {
+        if (p.offset + p.len == CDC_STREAM_BUF_SIZE) split++;
+    }
+    CHECK(g_rx == sent);
+    CHECK(split >= 5);
+    std::printf("  %zu bytes in %zu packets, %u ending at the ring end\n",
+        sent.size(), g_packets.size(), split);
+}
+
+// A transfer that ends on a full packet is closed by a ZLP, a short
+// last packet closes it by itself
+void test_zlp()
+{
+    std::printf("zlp\n");
+    attach();
+    CHECK(write(record(1, CDC_DATA_MAX_PACKET)));
+    host_drain();
+    CHECK(sizes() == std::vector<uint32_t>({ CDC_DATA_MAX_PACKET, 0 }));
+
+    attach();
+    CHECK(write(record(2, CDC_DATA_MAX_PACKET)));   // in flight
+    CHECK(write(record(3, CDC_DATA_MAX_PACKET)));   // queued behind it
+    host_drain();
+    CHECK(sizes() == std::vector<uint32_t>({ CDC_DATA_MAX_PACKET, CDC_DATA_MAX_PACKET, 0 }));
+
+    attach();
+    CHECK(write(record(4, CDC_DATA_MAX_PACKET)));
+    CHECK(write(record(5, 36)));
+    host_drain();
+    CHECK(sizes() == std::vector<uint32_t>({ CDC_DATA_MAX_PACKET, 36 }));
+    CHECK(g_rx == record(4, CDC_DATA_MAX_PACKET) + record(5, 36));
+}
+
+// The host stops reading: whole records are dropped and counted once the
+// ring is full, never a partial one, and the stream goes on afterwards
+void test_drops()
+{
+    const size_t len = 40;
+    const unsigned fit = (CDC_STREAM_BUF_SIZE - 1) / len;
+    uint32_t dropped0 = CDC_Stream_Dropped;
+    std::string sent;
+    unsigned queued = 0;
+
+    std::printf("drops\n");
+    attach();
+    for (unsigned seq = 0; seq < fit + 5; seq++) {
+        std::string r = record(seq, len);
+        if (write(r)) {
+            sent += r;
+            queued++;
+        }
+    }
+    CHECK(queued == fit);
+    CHECK(CDC_Stream_Dropped - dropped0 == 5);
+    host_drain();
+    CHECK(g_rx == sent);
+
+    CHECK(write(record(999, len)));
+    host_drain();
+    CHECK(g_rx == sent + record(999, len));
+    CHECK(CDC_Stream_Dropped - dropped0 == 5);
+    std::printf("  %u records queued, %u dropped\n", queued, unsigned(CDC_Stream_Dropped - dropped0));
+}
+
+// Closing the port stops the stream; reopening drops what was left
+// queued. Only a packet the endpoint still owns goes out first.
+void test_reopen()
+{
+    uint32_t dropped0 = CDC_Stream_Dropped;
+
+    std::printf("reopen\n");
+    attach();
+    CHECK(write(record(1, 40)));        // in flight
+    CHECK(write(record(2, 40)));
+    CHECK(write(record(3, 40)));
+    set_dtr(false);
+    CHECK(!write(record(4, 40)));       // closed: refused, not counted
+    CHECK(CDC_Stream_Dropped == dropped0);
+    host_drain();
+    CHECK(g_rx == record(1, 40));       // nothing more while closed
+    set_dtr(true);
+    CHECK(write(record(5, 40)));
+    host_drain();
+    CHECK(g_rx == record(1, 40) + record(5, 40));
+
+    // Reopened before the host took the packet in flight
+    attach();
+    CHECK(write(record(6, 40)));
+    CHECK(write(record(7, 40)));
+    set_dtr(false);
+    set_dtr(true);
+    CHECK(write(record(8, 40)));
+    host_drain();
+    CHECK(g_rx == record(6, 40) + record(8, 40));
+
+    // DTR set again while open (line coding change): nothing dropped
+    attach();
+    CHECK(write(record(9, 40)));
+    CHECK(write(record(10, 40)));
+    set_dtr(true);
+    host_drain();
+    CHECK(g_rx == record(9, 40) + record(10, 40));
+}
+
+}  // namespace
+
+int main()
+{
+    CDC_Stream_Buf = g_ring;
+    test_wrap();
+    test_zlp();
+    test_drops();
+    test_reopen();
+    CHECK(g_irq_off == 0);
+    std::printf("%s\n", g_failed ? "FAILED" : "all ok");
+    return g_failed ? 1 : 0;
+}
@@ -0,0 +1,63 @@
+// Host stand-in for the USB device core headers cdc_core.c includes: the
+// types it uses and the DCD / control pipe calls, which cdcstream.cpp
+// implements. usbd_def.h and usbd_conf.h are the firmware's own.
+#ifndef __USBD_IOREQ_H_
+#define __USBD_IOREQ_H_
+
+#include <stdint.h>
+#include "usbd_def.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MIN(a, b)       (((a) < (b)) ? (a) : (b))
+#define USB_OTG_EP_BULK 2
+#define USB_OTG_EP_INT  3
+
+typedef enum { USB_IRQn = 18 } IRQn_Type;
+
+typedef enum {
+    USBD_OK   = 0,
+    USBD_BUSY,
+    USBD_FAIL,
+} USBD_Status;
+
+typedef struct usb_setup_req {
+    uint8_t  bmRequest;
+    uint8_t  bRequest;
+    uint16_t wValue;
+    uint16_t wIndex;
+    uint16_t wLength;
+} USB_SETUP_REQ;
+
+typedef struct _Device_cb {
+    uint8_t  (*Init)(void *pdev, uint8_t cfgidx);
+    uint8_t  (*DeInit)(void *pdev, uint8_t cfgidx);
+    uint8_t  (*Setup)(void *pdev, USB_SETUP_REQ *req);
+    uint8_t  (*EP0_TxSent)(void *pdev);
+    uint8_t  (*EP0_RxReady)(void *pdev);
+    uint8_t  (*DataIn)(void *pdev, uint8_t epnum);
+    uint8_t  (*DataOut)(void *pdev, uint8_t epnum);
+    uint8_t  (*SOF)(void *pdev);
+    uint8_t  (*IsoINIncomplete)(void *pdev);
+    uint8_t  (*IsoOUTIncomplete)(void *pdev);
+    uint8_t  *(*GetConfigDescriptor)(uint8_t speed, uint16_t *length);
+} USBD_Class_cb_TypeDef;
+
+uint32_t DCD_EP_Open(void *pdev, uint8_t ep_addr, uint16_t ep_mps, uint8_t ep_type);
+uint32_t DCD_EP_Close(void *pdev, uint8_t ep_addr);
+uint32_t DCD_EP_PrepareRx(void *pdev, uint8_t ep_addr, uint8_t *pbuf, uint16_t buf_len);
+uint32_t DCD_EP_Tx(void *pdev, uint8_t ep_addr, uint8_t *pbuf, uint32_t buf_len);
+
+USBD_Status USBD_CtlSendData(void *pdev, uint8_t *buf, uint16_t len);
+USBD_Status USBD_CtlPrepareRx(void *pdev, uint8_t *pbuf, uint16_t len);
+
+void NVIC_DisableIRQ(IRQn_Type irq);
+void NVIC_EnableIRQ(IRQn_Type irq);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
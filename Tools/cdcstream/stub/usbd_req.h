@@ -0,0 +1,17 @@
+// Host stand-in, see usbd_ioreq.h
+#ifndef __USB_REQUEST_H_
+#define __USB_REQUEST_H_
+
+#include "usbd_ioreq.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void USBD_CtlError(void *pdev, USB_SETUP_REQ *req);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,136 @@
+// Energy model of one button / sample wake under different clock policies.
+// Each phase (same names as PROFILE.CSV) is split into core cycles, SPI
+// bytes, busy waits, WFI waits (I2C interrupts) and PMU Sleep waits
+// (sensor conversions, erase polls), and tagged with the task it declares
+// to the clock manager (clock.h). Currents are FM33LC0xx typical figures;
+// replace them and the phase table with board measurements and PROFILE.CSV
+// means when those are at hand.
+//
+//   g++ -std=c++11 -O2 -o clockmodel clockmodel.cpp
+//   ./clockmodel
+
+#include <cstdio>
+#include <vector>
+
+namespace {
+
+enum Task { kIo, kCpu };
+
+struct Phase {
+    const char *name;
+    Task        task;
+    double      cycles;     // core work
+    double      spi_bytes;  // polled SPI transfers, time set by SCK
+    double      spin_us;    // busy waits of fixed length (flash busy polls, ADC)
+    double      wfi_us;     // core in WFI, clocks on (I2C interrupt transfers)
+    double      sleep_us;   // PMU Sleep on LPTIM (conversions, erase polls)
+    double      every;      // runs on 1 wake in `every`
+};
+
+// One NST112, burst 1, one-shot; supply measured every 16th sample, the
+// profile snapshot (CRC, then two page programs) every 32nd
+const std::vector<Phase> kPhases = {
+    { "resume",      kIo,   3000,    0,    0,   0,     0,  1 },
+    { "flash_init",  kIo,    600,    8,    0,   0,     0,  1 },
+    { "sensor_init", kIo,   9000,  200,    0, 450,     0,  1 },
+    { "sensor_read", kIo,   1500,    0,    0, 250, 27000,  1 },
+    { "rtc",         kIo,   1200,    0,    0,   0,     0,  1 },
+    { "log_write",   kIo,   3500,   40,  700,   0,     0,  1 },
+    { "supply",      kIo,   2500,   20,  110,   0,     0, 16 },
+    { "ring_write",  kIo,   9000,  564, 1400,   0, 45000,  1 },
+    { "led",         kIo,    300,    0,    0,   0,     0,  1 },
+    { "prof_crc",    kCpu, 25000,    0,    0,   0,     0, 32 },
+    { "prof_flash",  kIo,    500,  520, 1400,   0,     0, 32 },
+};
+
+struct Power {
+    double vdd      = 3.0;      // V
+    double run_ua   = 120.0;    // run from flash: static part
+    double run_ua_mhz = 92.0;   //   and per MHz
+    double wfi_ua   = 120.0;    // WFI with clocks on
+    double wfi_ua_mhz = 35.0;
+    double sleep_ua = 8.0;      // PMU Sleep, RCHF off, LPTIM on
+    double switch_us = 15.0;    // RCHF switch, trim and peripheral retime
+    double sck_max_mhz = 4.0;   // FLASH_SPI_MAX_HZ
+};
+
+struct Policy {
+    const char *name;
+    double      mhz[2];         // [kIo], [kCpu]
+};
+
+const std::vector<Policy> kPolicies = {
+    { "fixed 8",       {  8,  8 } },
+    { "fixed 16",      { 16, 16 } },
+    { "fixed 24",      { 24, 24 } },
+    { "IO 8 / CPU 24", {  8, 24 } },
+};
+
+double sck_mhz(const Power &p, double f)
+{
+    double div = 2;
+    while (f / div > p.sck_max_mhz) div *= 2;
+    return f / div;
+}
+
+// uA * us = pJ per volt
+double phase_uj(const Power &p, const Phase &ph, double f)
+{
+    double run_ua = p.run_ua + p.run_ua_mhz * f;
+    double run_us = ph.cycles / f + ph.spi_bytes * 8.0 / sck_mhz(p, f) + ph.spin_us;
+    double wfi_ua = p.wfi_ua + p.wfi_ua_mhz * f;
+
+    return p.vdd * (run_ua * run_us + wfi_ua * ph.wfi_us + p.sleep_ua * ph.sleep_us) / ph.every * 1e-6;
+}
+
+double switch_uj(const Power &p, double f)
+{
+    return p.vdd * (p.run_ua + p.run_ua_mhz * f) * p.switch_us * 1e-6;
+}
+
+}  // namespace
+
+int main()
+{
+    const Power p;
+    std::vector<double> total(kPolicies.size(), 0.0);
+
+    std::printf("%-12s %4s", "phase", "task");
+    for (const Policy &pol : kPolicies) std::printf(" %14s", pol.name);
+    std::printf("\n");
+
+    for (const Phase &ph : kPhases) {
+        std::printf("%-12s %4s", ph.name, ph.task == kCpu ? "cpu" : "io");
+        for (size_t i = 0; i < kPolicies.size(); i++) {
+            double uj = phase_uj(p, ph, kPolicies[i].mhz[ph.task]);
+            total[i] += uj;
+            std::printf(" %11.2f uJ", uj);
+        }
+        std::printf("\n");
+    }
+
+    // The wake starts at 8 MHz (PMU wake frequency) and moves to the IO
+    // level; a phase at another level switches there and back. A switch
+    // runs at the faster of the two levels.
+    std::printf("%-12s %4s", "switches", "");
+    for (size_t i = 0; i < kPolicies.size(); i++) {
+        double io = kPolicies[i].mhz[kIo];
+        double uj = (io != 8) ? switch_uj(p, io > 8 ? io : 8) : 0;
+        for (const Phase &ph : kPhases) {
+            double g = kPolicies[i].mhz[ph.task];
+            if (g != io) uj += 2 * switch_uj(p, g > io ? g : io) / ph.every;
+        }
+        total[i] += uj;
+        std::printf(" %11.2f uJ", uj);
+    }
+    std::printf("\n%-12s %4s", "wake", "");
+    for (double t : total) std::printf(" %11.2f uJ", t);
+    std::printf("\n");
+
+    // A CPU burst of n cycles gains (run_ua / 8 - run_ua / 24) * n by
+    // running at 24 MHz and pays two switches
+    double gain = p.run_ua * (1.0 / 8 - 1.0 / 24);
+    double cost = 2 * (p.run_ua + p.run_ua_mhz * 24) * p.switch_us;
+    std::printf("\nCPU burst break-even at 24 MHz: %.0f cycles\n", cost / gain);
+    return 0;
+}
@@ -0,0 +1,76 @@
+// Incremental log sync: fetch records newer than the last seq seen and
+// append them as CSV. Keeps the last seq in <out>.seq next to the output.
+// With --set-clock the device clock is set to the host's UTC time after the
+// fetch; the correction shows up as a type 4 record (value = seconds).
+//
+//   g++ -std=c++11 -O2 -pthread -o logsync logsync.cpp ttlog_client.cpp
+//   sudo ./logsync [--set-clock] /dev/sg2 logger01.csv
+
+#include "ttlog_client.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <exception>
+#include <fstream>
+#include <string>
+#include <vector>
+
+int main(int argc, char **argv)
+{
+    const bool set_clock = (argc == 4 && std::string(argv[1]) == "--set-clock");
+    if (argc != 3 && !set_clock) {
+        std::fprintf(stderr, "usage: %s [--set-clock] <sg-device> <out.csv>\n", argv[0]);
+        return 2;
+    }
+    const char *dev_path = argv[argc - 2];
+    const std::string out_path = argv[argc - 1];
+    const std::string seq_path = out_path + ".seq";
+
+    try {
+        ttlog::Client dev(dev_path);
+        ttlog::Info in = dev.info();
+
+        uint32_t from = in.first_seq;
+        std::ifstream seq_in(seq_path);
+        unsigned long last = 0;
+        if (seq_in >> last && last + 1 > from)
+            from = uint32_t(last + 1);
+
+        std::vector<ttlog::Record> recs;
+        if (from < in.next_seq)
+            recs = dev.read_seq(from, in.next_seq - 1);
+
+        std::ofstream csv(out_path, std::ios::app);
+        for (const ttlog::Record &r : recs) {
+            // 946684800 = 2000-01-01 in Unix time
+            csv << r.seq << ',' << (946684800ull + r.time) << ',' << int(r.type) << ',' << int(r.chan) << ',';
+            if (r.type == ttlog::kRecTimeSet)
+                csv << ttlog::time_correction(r);
+            else if (r.type == ttlog::kRecTemp)
+                csv << (r.value / 16.0 + (r.aux & 15) / 256.0);
+            else if (r.type == ttlog::kRecSupply || r.type == ttlog::kRecBrownout)
+                csv << (uint16_t(r.value) / 1000.0);
+            else
+                csv << (r.value / 16.0);
+            csv << ',' << r.aux << '\n';
+        }
+        if (!recs.empty())
+            std::ofstream(seq_path, std::ios::trunc) << recs.back().seq << '\n';
+
+        std::printf("%zu records (seq %u..%u), device clock offset %lld s\n", recs.size(),
+                    from, recs.empty() ? from : recs.back().seq,
+                    (long long)(946684800ll + in.device_time) - (long long)std::time(nullptr));
+
+        // After the fetch, so the correction record is picked up next time
+        if (set_clock) {
+            int32_t trim = 0;
+            int32_t corr = dev.sync_time(&trim);
+            std::printf("clock set, corrected by %d s, drift trim %.3f ppm\n", int(corr), trim / 1000.0);
+        }
+    } catch (const std::exception &e) {
+        std::fprintf(stderr, "logsync: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,196 @@
+#include "ttlog_client.hpp"
+
+#include <fcntl.h>
+#include <scsi/sg.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+
+namespace ttlog {
+
+namespace {
+
+const uint8_t kOpInfo = 0xC0;
+const uint8_t kOpRead = 0xC1;
+const uint8_t kOpTimeSet = 0xC2;
+const int64_t kEpoch2000 = 946684800; // 2000-01-01 in Unix time
+const uint32_t kMagic = 0x474C5454u; // "TTLG"
+const uint32_t kBlock = 512;
+const uint32_t kRecSize = 16;
+const uint32_t kSeqNone = 0xFFFFFFFFu;
+
+uint32_t le32(const uint8_t *p)
+{
+    return uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24);
+}
+
+uint16_t le16(const uint8_t *p)
+{
+    return uint16_t(p[0] | (p[1] << 8));
+}
+
+void put_be32(uint8_t *p, uint32_t v)
+{
+    p[0] = uint8_t(v >> 24);
+    p[1] = uint8_t(v >> 16);
+    p[2] = uint8_t(v >> 8);
+    p[3] = uint8_t(v);
+}
+
+// Same CRC-16/CCITT (init 0xFFFF) as the firmware
+uint16_t crc16(const uint8_t *p, size_t n)
+{
+    uint16_t crc = 0xFFFF;
+    while (n--) {
+        crc ^= uint16_t(*p++) << 8;
+        for (int b = 0; b < 8; b++)
+            crc = (crc & 0x8000) ? uint16_t((crc << 1) ^ 0x1021) : uint16_t(crc << 1);
+    }
+    return crc;
+}
+
+} // namespace
+
+Client::Client(const std::string &path)
+    : fd_(::open(path.c_str(), O_RDWR)), chunk_blocks_(128)
+{
+    if (fd_ < 0)
+        throw std::runtime_error(path + ": " + std::strerror(errno));
+}
+
+Client::~Client()
+{
+    ::close(fd_);
+}
+
+void Client::command(const uint8_t *cdb, uint8_t cdb_len, uint8_t *buf, uint32_t len)
+{
+    uint8_t sense[32] = {};
+    sg_io_hdr_t io;
+    std::memset(&io, 0, sizeof(io));
+
+    io.interface_id = 'S';
+    io.dxfer_direction = SG_DXFER_FROM_DEV;
+    io.cmd_len = cdb_len;
+    io.cmdp = const_cast<uint8_t *>(cdb);
+    io.dxferp = buf;
+    io.dxfer_len = len;
+    io.sbp = sense;
+    io.mx_sb_len = sizeof(sense);
+    io.timeout = 20000;
+
+    if (::ioctl(fd_, SG_IO, &io) < 0)
+        throw std::runtime_error(std::string("SG_IO: ") + std::strerror(errno));
+    if ((io.info & SG_INFO_OK_MASK) != SG_INFO_OK) {
+        char msg[80];
+        std::snprintf(msg, sizeof(msg), "SCSI 0x%02X failed: status 0x%02X sense %02X/%02X",
+                      cdb[0], io.status, sense[2] & 0x0F, sense[12]);
+        throw std::runtime_error(msg);
+    }
+}
+
+Info Client::info()
+{
+    uint8_t cdb[12] = { kOpInfo };
+    uint8_t buf[32] = {};
+    command(cdb, sizeof(cdb), buf, sizeof(buf));
+
+    if (le32(buf) != kMagic || buf[5] != kRecSize)
+        throw std::runtime_error("not a TTLG logger or unsupported record format");
+
+    Info in;
+    in.first_seq   = le32(buf + 8);
+    in.next_seq    = le32(buf + 12);
+    in.capacity    = le32(buf + 16);
+    in.device_time = le32(buf + 20);
+    in.first_time  = le32(buf + 24);
+    in.last_time   = le32(buf + 28);
+    return in;
+}
+
+std::vector<Record> Client::read_range(uint8_t mode, uint32_t start, uint32_t end)
+{
+    std::vector<Record> out;
+    std::vector<uint8_t> buf(size_t(chunk_blocks_) * kBlock);
+    const uint32_t seq_end = (mode == 0) ? end : kSeqNone - 1;
+    uint8_t cmd_mode = mode;
+    uint32_t cursor = start;
+
+    for (;;) {
+        uint8_t cdb[12] = { kOpRead, cmd_mode };
+        put_be32(cdb + 2, cursor);
+        put_be32(cdb + 6, cmd_mode == 1 ? end : seq_end);
+        command(cdb, sizeof(cdb), buf.data(), uint32_t(buf.size()));
+
+        bool padded = false;
+        for (size_t off = 0; off + kRecSize <= buf.size(); off += kRecSize) {
+            const uint8_t *p = &buf[off];
+            if (le32(p) == kSeqNone) {
+                padded = true;
+                break;
+            }
+            if (crc16(p, kRecSize - 2) != le16(p + 14))
+                continue;
+            Record r;
+            r.seq   = le32(p);
+            r.time  = le32(p + 4);
+            r.type  = p[8];
+            r.chan  = p[9];
+            r.value = int16_t(le16(p + 10));
+            r.aux   = le16(p + 12);
+            r.crc   = le16(p + 14);
+            if (mode == 1 && r.time > end)
+                return out;
+            out.push_back(r);
+        }
+
+        // Padding means the device reached the end of the range.
+        if (padded || out.empty())
+            break;
+
+        // Later chunks continue by seq; a time range is still cut on r.time above.
+        cmd_mode = 0;
+        cursor = out.back().seq + 1;
+        if (cursor > seq_end)
+            break;
+    }
+    return out;
+}
+
+std::vector<Record> Client::read_seq(uint32_t first, uint32_t last)
+{
+    return read_range(0, first, last);
+}
+
+std::vector<Record> Client::read_time(uint32_t t0, uint32_t t1)
+{
+    return read_range(1, t0, t1);
+}
+
+int32_t Client::sync_time(int32_t *trim_ppb)
+{
+    using namespace std::chrono;
+
+    // The device restarts its second when set: send the next whole second
+    // as it begins.
+    const system_clock::time_point now = system_clock::now();
+    const seconds next = duration_cast<seconds>(now.time_since_epoch()) + seconds(1);
+    std::this_thread::sleep_until(system_clock::time_point(next));
+
+    uint8_t cdb[12] = { kOpTimeSet };
+    uint8_t buf[12] = {};
+    put_be32(cdb + 2, uint32_t(next.count() - kEpoch2000));
+    command(cdb, sizeof(cdb), buf, sizeof(buf));
+
+    if (trim_ppb)
+        *trim_ppb = int32_t(le32(buf + 8));
+    return int32_t(le32(buf + 4) - le32(buf));
+}
+
+} // namespace ttlog
@@ -0,0 +1,91 @@
+// Host-side client for the logger's vendor SCSI log export (Linux SG_IO).
+//
+// Commands (see Middleware/USB/App/inc/msc_scsi.h):
+//   0xC0 LOG_INFO  -> 32 bytes: magic "TTLG", version, record size,
+//                     first/next seq, capacity, device clock, first/last time
+//   0xC1 LOG_READ  -> CDB[1] = 0 seq range / 1 time range,
+//                     CDB[2..5] start, CDB[6..9] end (inclusive), big-endian;
+//                     data = 16-byte records, padded with 0xFF records.
+//   0xC2 TIME_SET  -> CDB[2..5] new time, big-endian; 12 bytes: old, new
+//                     time, RTC drift trim in ppb. Logs a type 4 record with
+//                     the correction (see below).
+// Times are seconds since 2000-01-01 (device RTC, UTC once set by a host).
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace ttlog {
+
+// Record types (firmware log_store.h)
+enum : uint8_t {
+    kRecTemp      = 1,  // value = degC * 16, aux = 4 more fraction bits (degC * 256 = value * 16 + aux)
+    kRecSensorErr = 2,  // aux = driver return code
+    kRecAlarm     = 3,  // value = degC * 16, aux 1 = high, 2 = low
+    kRecTimeSet   = 4,  // clock set, see time_correction()
+    kRecExcursion = 5,  // value = degC * 16, aux 1 = high, 2 = low, | 0x80 = end
+    kRecSupply    = 6,  // value = VDD mV, aux = MCU degC * 16
+    kRecBrownout  = 7,  // supply warning, value = last VDD mV
+};
+
+struct Record {
+    uint32_t seq;
+    uint32_t time;
+    uint8_t  type;
+    uint8_t  chan;
+    int16_t  value;
+    uint16_t aux;
+    uint16_t crc;
+};
+
+// Seconds the clock was moved by a kRecTimeSet record (negative = it was fast).
+inline int32_t time_correction(const Record &r)
+{
+    return int32_t((uint32_t(uint16_t(r.value)) << 16) | r.aux);
+}
+
+struct Info {
+    uint32_t first_seq;
+    uint32_t next_seq;
+    uint32_t capacity;
+    uint32_t device_time;
+    uint32_t first_time;
+    uint32_t last_time;
+};
+
+class Client {
+public:
+    // path: SCSI generic or block node of the logger, e.g. /dev/sg2 or /dev/sdb
+    explicit Client(const std::string &path);
+    ~Client();
+
+    Client(const Client &) = delete;
+    Client &operator=(const Client &) = delete;
+
+    Info info();
+
+    // Records with seq in [first, last]; stops early when the device runs out.
+    std::vector<Record> read_seq(uint32_t first, uint32_t last);
+
+    // Records with time in [t0, t1].
+    std::vector<Record> read_time(uint32_t t0, uint32_t t1);
+
+    // Set the device clock to the host's UTC time, issued on a second
+    // boundary. Returns the correction applied in seconds; trim_ppb gets
+    // the drift trim the device derived from its sync history.
+    int32_t sync_time(int32_t *trim_ppb = nullptr);
+
+    // Blocks of 512 bytes requested per command (32 records each).
+    void set_chunk_blocks(uint32_t blocks) { chunk_blocks_ = blocks ? blocks : 1; }
+
+private:
+    void command(const uint8_t *cdb, uint8_t cdb_len, uint8_t *buf, uint32_t len);
+    std::vector<Record> read_range(uint8_t mode, uint32_t start, uint32_t end);
+
+    int fd_;
+    uint32_t chunk_blocks_;
+};
+
+} // namespace ttlog
@@ -0,0 +1,276 @@
+// Replays an event trace through the firmware scheduler (Src/sched.c) on
+// a simulated clock, checks that each level comes out in posting order
+// with no event lost, and measures the host cost of a post + dispatch.
+// Without a trace file a built-in one is used: a button wake, a USB
+// session with bursts of USB interrupts, ALERT edges and a brown-out.
+//
+// Trace lines (ms from start; '#' starts a comment):
+//   <ms> post <nmi|irq|thread> <task> [arg]
+//   <ms> signal <task>
+// Tasks: usb button alert supply sample stream, or a number.
+//
+//   gcc -O2 -c -iquote ../../Inc ../../Src/sched.c
+//   g++ -std=c++11 -O2 -pthread -iquote ../../Inc -o schedtrace schedtrace.cpp sched.o
+//   ./schedtrace [trace.txt]
+
+extern "C" {
+#include "sched.h"
+}
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <deque>
+#include <thread>
+#include <vector>
+
+namespace {
+
+const char *const kTaskNames[SCHED_TASKS] = { "usb", "button", "alert", "supply", "sample", "stream", "6", "7" };
+const char *const kLevelNames[SCHED_LEVELS] = { "nmi", "irq", "thread" };
+
+struct TraceEvent {
+    uint32_t ms;
+    bool     signal;
+    uint8_t  level;
+    uint8_t  task;
+    uint8_t  arg;
+};
+
+uint32_t g_now;                         // simulated ms clock
+uint32_t sim_clock() { return g_now; }
+
+// Post time and level of each event not yet run, per task
+struct Posted { uint32_t ms; uint8_t level; };
+std::deque<Posted> g_posted[SCHED_TASKS];
+uint32_t g_lat_sum[SCHED_LEVELS], g_lat_max[SCHED_LEVELS], g_lat_n[SCHED_LEVELS];
+uint32_t g_runs[SCHED_TASKS];
+
+// Handlers: account the run, charge a typical run time, re-arm like main.c
+const uint32_t kCostMs[SCHED_TASKS] = { 0, 40, 30, 5, 40, 1, 0, 0 };
+bool g_usb;
+
+template <uint8_t T>
+void handler(uint8_t arg)
+{
+    g_runs[T]++;
+    if (arg < SCHED_ARG_SIGNAL && !g_posted[T].empty()) {
+        const Posted p = g_posted[T].front();
+        uint32_t lat = g_now - p.ms;
+        g_posted[T].pop_front();
+        g_lat_sum[p.level] += lat;
+        g_lat_n[p.level]++;
+        if (lat > g_lat_max[p.level]) g_lat_max[p.level] = lat;
+    }
+    g_now += kCostMs[T];
+    if (T == SCHED_TASK_USB && arg != SCHED_ARG_SIGNAL) {
+        if (!g_usb) {
+            g_usb = true;
+            Sched_After(SCHED_TASK_SAMPLE, 10000);
+            Sched_After(SCHED_TASK_STREAM, 100);
+        }
+        if (arg == SCHED_ARG_TIMER || arg == 0) Sched_After(SCHED_TASK_USB, 10);
+    }
+    if (T == SCHED_TASK_SAMPLE) Sched_After(SCHED_TASK_SAMPLE, 10000);
+    if (T == SCHED_TASK_STREAM) Sched_After(SCHED_TASK_STREAM, 27);   // one-shot conversions back to back
+}
+
+void install()
+{
+    Sched_Init(sim_clock);
+    Sched_SetTask(0, handler<0>);
+    Sched_SetTask(1, handler<1>);
+    Sched_SetTask(2, handler<2>);
+    Sched_SetTask(3, handler<3>);
+    Sched_SetTask(4, handler<4>);
+    Sched_SetTask(5, handler<5>);
+}
+
+int parse_task(const std::string &s)
+{
+    for (unsigned t = 0; t < SCHED_TASKS; t++)
+        if (s == kTaskNames[t]) return int(t);
+    return std::atoi(s.c_str());
+}
+
+std::vector<TraceEvent> builtin_trace()
+{
+    std::vector<TraceEvent> tr;
+    tr.push_back({ 1000, false, SCHED_LEVEL_NMI, SCHED_TASK_BUTTON, 0 });
+    tr.push_back({ 5000, false, SCHED_LEVEL_NMI, SCHED_TASK_USB, 0 });
+    // enumeration and MSC transfers: interrupt bursts every 2 ms for 20 s
+    for (uint32_t ms = 5002; ms < 25000; ms += 2) {
+        tr.push_back({ ms, true, 0, SCHED_TASK_USB, 0 });
+        if (ms % 500 == 0) tr.push_back({ ms, true, 0, SCHED_TASK_USB, 0 });
+    }
+    tr.push_back({ 12000, false, SCHED_LEVEL_NMI, SCHED_TASK_BUTTON, 0 });
+    tr.push_back({ 15000, false, SCHED_LEVEL_NMI, SCHED_TASK_ALERT, 0 });
+    tr.push_back({ 15000, false, SCHED_LEVEL_IRQ, SCHED_TASK_SUPPLY, 0 });
+    tr.push_back({ 15001, false, SCHED_LEVEL_NMI, SCHED_TASK_ALERT, 1 });
+    return tr;
+}
+
+bool load_trace(const char *path, std::vector<TraceEvent> &tr)
+{
+    std::ifstream in(path);
+    std::string line;
+    if (!in) return false;
+    while (std::getline(in, line)) {
+        line = line.substr(0, line.find('#'));
+        std::istringstream ls(line);
+        TraceEvent e = { 0, false, SCHED_LEVEL_THREAD, 0, 0 };
+        std::string kind, a, b;
+        unsigned arg = 0;
+        if (!(ls >> e.ms >> kind)) continue;
+        if (kind == "signal") {
+            ls >> a;
+            e.signal = true;
+            e.task = uint8_t(parse_task(a));
+        } else {
+            ls >> a >> b >> arg;
+            for (unsigned l = 0; l < SCHED_LEVELS; l++)
+                if (a == kLevelNames[l]) e.level = uint8_t(l);
+            e.task = uint8_t(parse_task(b));
+            e.arg = uint8_t(arg);
+        }
+        tr.push_back(e);
+    }
+    return true;
+}
+
+// Events due while a handler runs are posted together before the next
+// dispatch, as they would be from interrupts; idle gaps are skipped up to
+// the next event or timer, whichever comes first.
+void replay(std::vector<TraceEvent> tr)
+{
+    size_t i = 0;
+
+    std::stable_sort(tr.begin(), tr.end(),
+        [](const TraceEvent &a, const TraceEvent &b) { return a.ms < b.ms; });
+    install();
+    g_now = 0;
+    while (i < tr.size()) {
+        uint32_t wait = Sched_Dispatch();
+        uint32_t next = tr[i].ms;
+        if (wait != SCHED_FOREVER && g_now + wait < next) {
+            g_now += wait;
+            continue;
+        }
+        if (g_now < next) g_now = next;
+        while (i < tr.size() && tr[i].ms <= g_now) {
+            const TraceEvent &e = tr[i++];
+            if (e.signal) {
+                Sched_Signal(e.task);
+            } else if (Sched_Post(e.level, e.task, e.arg)) {
+                g_posted[e.task].push_back({ e.ms, e.level });
+            }
+        }
+    }
+    (void)Sched_Dispatch();
+
+    const SchedStats *st = Sched_Stats();
+    std::printf("replay: %zu trace events, %u dispatches, end at %u ms\n",
+        tr.size(), unsigned(st->dispatched), unsigned(g_now));
+    for (unsigned t = 0; t < SCHED_TASKS; t++)
+        if (g_runs[t]) std::printf("  %-7s %7u runs\n", kTaskNames[t], unsigned(g_runs[t]));
+    for (unsigned l = 0; l < SCHED_LEVELS; l++)
+        std::printf("  %-6s posted %5u dropped %3u high water %u/%u latency mean %.1f max %u ms\n",
+            kLevelNames[l], unsigned(st->posted[l]), unsigned(st->dropped[l]), unsigned(st->high_water[l]),
+            unsigned(SCHED_QUEUE_LEN), g_lat_n[l] ? double(g_lat_sum[l]) / g_lat_n[l] : 0.0,
+            unsigned(g_lat_max[l]));
+}
+
+// Cost per event with empty handlers
+uint32_t g_count;
+void count_handler(uint8_t) { g_count++; }
+
+void overhead()
+{
+    const uint32_t n = 2000000;
+
+    Sched_Init(sim_clock);
+    for (uint8_t t = 0; t < SCHED_TASKS; t++) Sched_SetTask(t, count_handler);
+
+    auto t0 = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < n; i++) {
+        (void)Sched_Post(SCHED_LEVEL_IRQ, uint8_t(i & 7), 0);
+        (void)Sched_Dispatch();
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < n; i++) {
+        Sched_Signal(uint8_t(i & 7));
+        (void)Sched_Dispatch();
+    }
+    auto t2 = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < n; i++) {
+        Sched_After(uint8_t(i & 7), 0);
+        (void)Sched_Dispatch();
+    }
+    auto t3 = std::chrono::steady_clock::now();
+
+    auto ns = [n](std::chrono::steady_clock::duration d) {
+        return double(std::chrono::duration_cast<std::chrono::nanoseconds>(d).count()) / n;
+    };
+    std::printf("overhead (host, per event incl. one empty Sched_Dispatch): post %.1f ns, signal %.1f ns, timer %.1f ns\n",
+        ns(t1 - t0), ns(t2 - t1), ns(t3 - t2));
+    if (g_count != 3 * n) std::printf("  ERROR: %u of %u handlers ran\n", unsigned(g_count), unsigned(3 * n));
+}
+
+// One producer thread on the IRQ ring against the dispatching thread:
+// every sequence number must come out once and in order
+uint8_t g_expect;
+uint32_t g_seen, g_bad;
+void seq_handler(uint8_t arg)
+{
+    if (arg != g_expect) g_bad++;
+    g_expect = uint8_t(arg + 1);
+    g_seen++;
+}
+
+bool stress()
+{
+    const uint32_t n = 1000000;
+
+    Sched_Init(sim_clock);
+    Sched_SetTask(0, seq_handler);
+    g_expect = 0;
+    g_seen = g_bad = 0;
+
+    std::thread producer([n] {
+        for (uint32_t i = 0; i < n; i++)
+            while (!Sched_Post(SCHED_LEVEL_IRQ, 0, uint8_t(i))) std::this_thread::yield();
+    });
+    while (g_seen < n) {
+        (void)Sched_Dispatch();
+        if (!Sched_Pending()) std::this_thread::yield();   // single core hosts
+    }
+    producer.join();
+
+    std::printf("stress: %u events through the IRQ ring from another thread, %u out of order, %u full-ring retries\n",
+        unsigned(g_seen), unsigned(g_bad), unsigned(Sched_Stats()->dropped[SCHED_LEVEL_IRQ]));
+    return g_bad == 0;
+}
+
+}  // namespace
+
+int main(int argc, char **argv)
+{
+    std::vector<TraceEvent> tr;
+
+    if (argc > 1) {
+        if (!load_trace(argv[1], tr)) {
+            std::fprintf(stderr, "cannot read %s\n", argv[1]);
+            return 2;
+        }
+    } else {
+        tr = builtin_trace();
+    }
+    replay(tr);
+    overhead();
+    return stress() ? 0 : 1;
+}